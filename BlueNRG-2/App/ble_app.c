@@ -7,6 +7,10 @@
 
 #include <ble_app_services.h>
 #include "ble_app.h"
+#include "ble_app_events.h"
+#include "ble_app_stats.h"
+#include "ble_app_commands.h"
+#include "ble_app_advertising.h"
 #include "print_utils.h"
 
 #include "FreeRTOS.h"
@@ -21,24 +25,57 @@
 #include "bluenrg_utils.h"
 
 #include <string.h>
+#include <stdbool.h>
+
+// BlueNRG-2 boots in tens of milliseconds, this is only a fallback if its event gets lost
+#define BLE_BOOT_TIMEOUT_MS 2000u
+#define BLE_BOOT_REASON_RESET 0x01
 
 char const DeviceName[] = { AD_TYPE_COMPLETE_LOCAL_NAME, 'B', 'L', 'E', 'W', 'e', 'a', 't', 'h', 'e', 'r', 'S', 't',
 		'a', 't', 'i', 'o', 'n' };
 size_t const DeviceNameLength = 18;
+
 uint16_t ble_discovery_time = 0;
 
+static bool isBlueNRGInitialized = false;
+static uint32_t bleStartTick = 0;
+
 void handle_hci_packet(void* pData);
 tBleStatus get_bluenrg_version(uint8_t* hwVersion, uint8_t* fwVersion);
-void set_discoverable();
+void set_scan_response();
 void setup_device_address();
 
-void ble_init() {
-	// Setup and init BLE
+void aci_blue_initialized_event(uint8_t Reason_Code) {
+	if (Reason_Code == BLE_BOOT_REASON_RESET) {
+		debugPrint("BlueNRG booted %lu ms after reset", HAL_GetTick() - bleStartTick);
+	} else {
+		debugPrint("BlueNRG restarted unexpectedly, reason code: 0x%02X", Reason_Code);
+	}
+	isBlueNRGInitialized = true;
+}
+
+static bool wait_for_bluenrg_boot() {
+	while (!isBlueNRGInitialized) {
+		if (HAL_GetTick() - bleStartTick >= BLE_BOOT_TIMEOUT_MS) {
+			return false;
+		}
+		osDelay(1);
+		hci_user_evt_proc();
+	}
+	return true;
+}
+
+void ble_start() {
+	// hci_init() resets BlueNRG with its reset pin, it will report back with aci_blue_initialized_event
+	isBlueNRGInitialized = false;
+	bleStartTick = HAL_GetTick();
 	hci_init(handle_hci_packet, NULL);
-	hci_reset();
+}
 
-	// Wait for the module to wake up
-	osDelay(2000);
+void ble_init() {
+	if (!wait_for_bluenrg_boot()) {
+		debugPrint("BlueNRG didn't report booting in %lu ms, trying to continue anyway", BLE_BOOT_TIMEOUT_MS);
+	}
 
 	// Check if module is working - read the version
 	uint8_t ble_hw_version = 0;
@@ -76,11 +113,19 @@ void ble_init() {
 	}
 
 	add_app_services();
-	set_discoverable();
+	set_scan_response();
+	ble_advertising_start();
 }
 
 void ble_process() {
+	uint32_t const eventsStart = ble_commands_timestamp();
 	hci_user_evt_proc();
+	ble_commands_record_event_path(ble_commands_elapsed_us(eventsStart));
+
+	ble_commands_process();
+	ble_advertising_process();
+	ble_update_diagnostics();
+	flush_characteristic_values();
 }
 
 tBleStatus get_bluenrg_version(uint8_t* hwVersion, uint8_t* fwVersion) {
@@ -102,17 +147,12 @@ tBleStatus get_bluenrg_version(uint8_t* hwVersion, uint8_t* fwVersion) {
 	return status;
 }
 
-void set_discoverable() {
-
-	hci_le_set_scan_response_data(0, NULL);
-	tBleStatus set_discoverable_status = aci_gap_set_discoverable(ADV_DATA_TYPE, ADV_INTERV_MIN, ADV_INTERV_MAX,
-	PUBLIC_ADDR, NO_WHITE_LIST_USE, DeviceNameLength, (uint8_t*)DeviceName, 0, NULL, 0, 0);
-
-	if (set_discoverable_status == BLE_STATUS_SUCCESS) {
-		debugPrint("Device set as discoverable!");
-	} else {
-		debugPrint("Discoverable setting failed with code 0x%02X", set_discoverable_status);
-	}
+// Scan response is kept by the controller, advertising interval changes don't have to resend it
+void set_scan_response() {
+	uint8_t scanResponse[31] = { 0 };
+	scanResponse[0] = (uint8_t) DeviceNameLength;
+	memcpy(&scanResponse[1], DeviceName, DeviceNameLength);
+	hci_le_set_scan_response_data((uint8_t) DeviceNameLength + 1, scanResponse);
 }
 
 void setup_device_address() {
@@ -148,8 +188,6 @@ void setup_device_address() {
 }
 
 void handle_hci_packet(void* pData) {
-	uint32_t i;
-
 	hci_spi_pckt* hci_pckt = (hci_spi_pckt*) pData;
 
 	if (hci_pckt->type == HCI_EVENT_PKT) {
@@ -157,27 +195,12 @@ void handle_hci_packet(void* pData) {
 
 		if (event_pckt->evt == EVT_LE_META_EVENT) {
 			evt_le_meta_event* evt = (void*) event_pckt->data;
-
-			for (i = 0; i < (sizeof(hci_le_meta_events_table) / sizeof(hci_le_meta_events_table_type)); i++) {
-				if (evt->subevent == hci_le_meta_events_table[i].evt_code) {
-					hci_le_meta_events_table[i].process((void*) evt->data);
-				}
-			}
+			ble_dispatch_le_meta_event(evt->subevent, (void*) evt->data);
 		} else if (event_pckt->evt == EVT_VENDOR) {
 			evt_blue_aci* blue_evt = (void*) event_pckt->data;
-
-			for (i = 0; i < (sizeof(hci_vendor_specific_events_table) / sizeof(hci_vendor_specific_events_table_type));
-					i++) {
-				if (blue_evt->ecode == hci_vendor_specific_events_table[i].evt_code) {
-					hci_vendor_specific_events_table[i].process((void*) blue_evt->data);
-				}
-			}
+			ble_dispatch_vendor_event(blue_evt->ecode, (void*) blue_evt->data);
 		} else {
-			for (i = 0; i < (sizeof(hci_events_table) / sizeof(hci_events_table_type)); i++) {
-				if (event_pckt->evt == hci_events_table[i].evt_code) {
-					hci_events_table[i].process((void*) event_pckt->data);
-				}
-			}
+			ble_dispatch_hci_event(event_pckt->evt, (void*) event_pckt->data);
 		}
 	}
 }
@@ -8,6 +8,9 @@
 #ifndef APP_BLE_APP_H_
 #define APP_BLE_APP_H_
 
+// Resets BlueNRG-2 and returns immediately, so the rest of the system can be initialized while it boots
+void ble_start();
+// Waits for BlueNRG-2 to boot, then sets up GATT/GAP and starts advertising
 void ble_init();
 void ble_process();
 
@@ -0,0 +1,231 @@
+/*
+ * ble_app_advertising.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: steelph0enix
+ */
+
+#include "ble_app_advertising.h"
+#include "ble_app_commands.h"
+#include "ble_app_sessions.h"
+#include "print_utils.h"
+#include "main.h"
+
+#include "bluenrg_conf.h"
+#include "hci_const.h"
+#include "bluenrg1_aci.h"
+#include "bluenrg1_gap.h"
+
+#include <string.h>
+#include <stdbool.h>
+
+#define BROADCAST_DATA_MAX_LENGTH 16
+// Don't hammer the controller if aci_gap_set_discoverable() keeps failing
+#define ADVERTISING_RETRY_MS 1000u
+
+typedef struct AdvertisingInterval_t {
+	uint16_t min; // N x 0.625 ms
+	uint16_t max;
+} AdvertisingInterval;
+
+// Every trigger keeps advertising fast for fastMs, then at medium interval for mediumMs.
+// Windows only get extended, so a short burst doesn't cut a longer one.
+typedef struct AdvertisingBurst_t {
+	uint32_t fastMs;
+	uint32_t mediumMs;
+} AdvertisingBurst;
+
+// @formatter:off
+static AdvertisingInterval const advertisingIntervals[BLE_ADV_PHASES] = {
+	[BLE_ADV_PHASE_FAST]   = { ADV_FAST_INTERV_MIN, ADV_FAST_INTERV_MAX },
+	[BLE_ADV_PHASE_MEDIUM] = { ADV_MEDIUM_INTERV_MIN, ADV_MEDIUM_INTERV_MAX },
+	[BLE_ADV_PHASE_SLOW]   = { ADV_INTERV_MIN, ADV_INTERV_MAX }
+};
+
+// Measurements come often, their burst is only long enough for scanners to catch the new broadcast
+static AdvertisingBurst const advertisingBursts[BLE_ADV_TRIGGERS] = {
+	[BLE_ADV_TRIGGER_BOOT]          = { 30000, 60000 },
+	[BLE_ADV_TRIGGER_DISCONNECTION] = { 30000, 60000 },
+	[BLE_ADV_TRIGGER_MEASUREMENT]   = { 2000, 0 },
+	[BLE_ADV_TRIGGER_BUTTON]        = { 30000, 60000 }
+};
+
+static char const* const phaseNames[BLE_ADV_PHASES] = { "fast", "medium", "slow" };
+// @formatter:on
+
+// Advertising packet holds up to 31 bytes and BlueNRG adds flags and TX power level (6 bytes) by itself,
+// so the advertising data carries shortened name and broadcast data, complete name goes to scan response.
+static uint8_t const AdvertisedName[] = { AD_TYPE_SHORTENED_LOCAL_NAME, 'B', 'L', 'E', 'W', 'S' };
+
+static uint8_t broadcastData[BROADCAST_DATA_MAX_LENGTH];
+static uint8_t broadcastDataLength = 0;
+
+static bool isStarted = false;
+static bool isAdvertising = false;
+static uint8_t connectionsCount = 0;
+static BLEAdvertisingPhase activePhase = BLE_ADV_PHASE_SLOW;
+static uint32_t activePhaseTick = 0;
+static uint32_t fastUntilTick = 0;
+static uint32_t mediumUntilTick = 0;
+static bool isRetryPending = false;
+static uint32_t lastFailureTick = 0;
+
+static BLEAdvertisingStats advertisingStats = { 0 };
+
+// Tick comparison that survives HAL_GetTick() overflow
+static bool is_before(uint32_t tick, uint32_t deadline) {
+	return (int32_t) (deadline - tick) > 0;
+}
+
+static void extend_window(uint32_t* until, uint32_t newUntil) {
+	if (is_before(*until, newUntil)) {
+		*until = newUntil;
+	}
+}
+
+static BLEAdvertisingPhase phase_at(uint32_t tick) {
+	if (is_before(tick, fastUntilTick)) {
+		return BLE_ADV_PHASE_FAST;
+	}
+	if (is_before(tick, mediumUntilTick)) {
+		return BLE_ADV_PHASE_MEDIUM;
+	}
+	return BLE_ADV_PHASE_SLOW;
+}
+
+static void leave_active_phase(uint32_t now) {
+	advertisingStats.phases[activePhase].advertisingMs += now - activePhaseTick;
+	isAdvertising = false;
+}
+
+static void start_advertising(BLEAdvertisingPhase phase) {
+	AdvertisingInterval const* interval = &advertisingIntervals[phase];
+	uint32_t const now = HAL_GetTick();
+	uint32_t const stopTimestamp = ble_commands_timestamp();
+	bool const isReconfiguration = isAdvertising;
+
+	// Interval can't be changed while advertising, so the radio stays quiet only for these two commands
+	if (isReconfiguration) {
+		aci_gap_set_non_discoverable();
+		leave_active_phase(now);
+	}
+
+	tBleStatus const status = aci_gap_set_discoverable(ADV_DATA_TYPE, interval->min, interval->max, PUBLIC_ADDR,
+	NO_WHITE_LIST_USE, sizeof(AdvertisedName), (uint8_t*) AdvertisedName, 0, NULL, 0, 0);
+
+	if (status != BLE_STATUS_SUCCESS) {
+		advertisingStats.failures++;
+		isRetryPending = true;
+		lastFailureTick = now;
+		debugPrint("Discoverable setting failed with code 0x%02X", status);
+		return;
+	}
+
+	if (isReconfiguration) {
+		uint32_t const downtime = ble_commands_elapsed_us(stopTimestamp);
+		advertisingStats.reconfigurations++;
+		advertisingStats.totalDowntimeUs += downtime;
+		if (downtime > advertisingStats.maxDowntimeUs) {
+			advertisingStats.maxDowntimeUs = downtime;
+		}
+	}
+
+	// Advertising data is rebuilt by aci_gap_set_discoverable(), broadcast has to be added again
+	if (broadcastDataLength > 0) {
+		aci_gap_update_adv_data(broadcastDataLength, broadcastData);
+	}
+
+	isRetryPending = false;
+	isAdvertising = true;
+	activePhase = phase;
+	activePhaseTick = now;
+	advertisingStats.phases[phase].entered++;
+	debugPrint("Advertising %s, every %u-%u x 0.625 ms, %lu ms after boot", phaseNames[phase], interval->min,
+			interval->max, now);
+}
+
+void ble_advertising_start() {
+	isStarted = true;
+	ble_advertising_trigger(BLE_ADV_TRIGGER_BOOT);
+	ble_advertising_process();
+}
+
+void ble_advertising_trigger(BLEAdvertisingTrigger trigger) {
+	uint32_t const now = HAL_GetTick();
+	AdvertisingBurst const* burst = &advertisingBursts[trigger];
+
+	advertisingStats.triggers[trigger]++;
+	extend_window(&fastUntilTick, now + burst->fastMs);
+	extend_window(&mediumUntilTick, now + burst->fastMs + burst->mediumMs);
+}
+
+void ble_advertising_process() {
+	// Advertising continues while connected, so more centrals can join
+	if (!isStarted || connectionsCount >= BLE_MAX_CONNECTIONS) {
+		return;
+	}
+
+	uint32_t const now = HAL_GetTick();
+	BLEAdvertisingPhase const phase = phase_at(now);
+	if (isAdvertising && phase == activePhase) {
+		return;
+	}
+	if (isRetryPending && now - lastFailureTick < ADVERTISING_RETRY_MS) {
+		return;
+	}
+
+	start_advertising(phase);
+}
+
+void ble_advertising_connected() {
+	connectionsCount++;
+	if (!isAdvertising) {
+		return;
+	}
+
+	// Controller stops advertising by itself when a central connects
+	uint32_t const now = HAL_GetTick();
+	uint32_t const latency = now - activePhaseTick;
+	BLEAdvertisingPhaseStats* stats = &advertisingStats.phases[activePhase];
+	stats->connections++;
+	stats->totalConnectLatencyMs += latency;
+	if (latency > stats->maxConnectLatencyMs) {
+		stats->maxConnectLatencyMs = latency;
+	}
+	leave_active_phase(now);
+}
+
+void ble_advertising_disconnected() {
+	// Advertising is restarted by ble_advertising_process(), not from the event handler
+	if (connectionsCount > 0) {
+		connectionsCount--;
+	}
+	ble_advertising_trigger(BLE_ADV_TRIGGER_DISCONNECTION);
+}
+
+void ble_update_broadcast_data(uint8_t const ad_structure[], uint8_t length) {
+	if (length > BROADCAST_DATA_MAX_LENGTH) {
+		return;
+	}
+
+	memcpy(broadcastData, ad_structure, length);
+	broadcastDataLength = length;
+
+	// AD structure of the same type is replaced, so the advertising data doesn't grow
+	tBleStatus const status = aci_gap_update_adv_data(length, broadcastData);
+	if (status != BLE_STATUS_SUCCESS) {
+		debugPrint("Couldn't update advertising data, error 0x%02X", status);
+	}
+}
+
+BLEAdvertisingStats get_ble_advertising_stats() {
+	BLEAdvertisingStats stats = advertisingStats;
+	if (isAdvertising) {
+		stats.phases[activePhase].advertisingMs += HAL_GetTick() - activePhaseTick;
+	}
+	return stats;
+}
+
+char const* ble_advertising_phase_name(BLEAdvertisingPhase phase) {
+	return phase < BLE_ADV_PHASES ? phaseNames[phase] : "?";
+}
@@ -0,0 +1,63 @@
+/*
+ * ble_app_advertising.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: steelph0enix
+ */
+
+#ifndef APP_BLE_APP_ADVERTISING_H_
+#define APP_BLE_APP_ADVERTISING_H_
+
+#include <stdint.h>
+
+// Advertising interval steps, fast after a trigger, then backing off to slow
+typedef enum BLEAdvertisingPhase_t {
+	BLE_ADV_PHASE_FAST,
+	BLE_ADV_PHASE_MEDIUM,
+	BLE_ADV_PHASE_SLOW,
+	BLE_ADV_PHASES
+} BLEAdvertisingPhase;
+
+typedef enum BLEAdvertisingTrigger_t {
+	BLE_ADV_TRIGGER_BOOT,
+	BLE_ADV_TRIGGER_DISCONNECTION,
+	BLE_ADV_TRIGGER_MEASUREMENT,
+	BLE_ADV_TRIGGER_BUTTON,
+	BLE_ADV_TRIGGERS
+} BLEAdvertisingTrigger;
+
+typedef struct BLEAdvertisingPhaseStats_t {
+	uint32_t entered;
+	uint32_t advertisingMs;         // total time spent advertising in this phase
+	uint32_t connections;           // connections made while advertising in this phase
+	uint32_t totalConnectLatencyMs; // from entering the phase to the connection
+	uint32_t maxConnectLatencyMs;
+} BLEAdvertisingPhaseStats;
+
+typedef struct BLEAdvertisingStats_t {
+	BLEAdvertisingPhaseStats phases[BLE_ADV_PHASES];
+	uint32_t triggers[BLE_ADV_TRIGGERS];
+	uint32_t reconfigurations; // interval changes while advertising
+	uint32_t maxDowntimeUs;    // advertising stopped for the interval change
+	uint64_t totalDowntimeUs;
+	uint32_t failures;         // aci_gap_set_discoverable() errors
+} BLEAdvertisingStats;
+
+// Starts advertising with boot burst, called once GAP and GATT are set up
+void ble_advertising_start();
+// Advertises fast for a while, then backs off again. Not for interrupts, set a flag there.
+void ble_advertising_trigger(BLEAdvertisingTrigger trigger);
+// Steps the interval down when burst windows expire, called from ble_process()
+void ble_advertising_process();
+
+// Connection state, from HCI event handlers
+void ble_advertising_connected();
+void ble_advertising_disconnected();
+
+// Adds or replaces single AD structure (length, type, data) in advertising data, kept when advertising restarts
+void ble_update_broadcast_data(uint8_t const ad_structure[], uint8_t length);
+
+BLEAdvertisingStats get_ble_advertising_stats();
+char const* ble_advertising_phase_name(BLEAdvertisingPhase phase);
+
+#endif /* APP_BLE_APP_ADVERTISING_H_ */
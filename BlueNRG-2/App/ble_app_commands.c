@@ -0,0 +1,84 @@
+/*
+ * ble_app_commands.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: steelph0enix
+ */
+
+#include "ble_app_commands.h"
+#include "print_utils.h"
+#include "main.h"
+
+// Commands are written and executed by the same task (default task, through ble_process()),
+// so the queue doesn't need any locking.
+static BLEControlCommand commandQueue[BLE_COMMAND_QUEUE_LENGTH];
+static uint8_t commandQueueHead = 0;
+static uint8_t commandQueueCount = 0;
+
+static BLECommandStats commandStats = { 0 };
+
+bool ble_command_enqueue(BLESession const* session, BLEControlCharValue opcode) {
+	if (commandQueueCount == BLE_COMMAND_QUEUE_LENGTH) {
+		commandStats.dropped++;
+		debugPrint("Command queue full, dropping control command 0x%02X", (uint8_t )opcode);
+		return false;
+	}
+
+	uint8_t const tail = (commandQueueHead + commandQueueCount) % BLE_COMMAND_QUEUE_LENGTH;
+	BLEControlCommand* command = &commandQueue[tail];
+	command->opcode = opcode;
+	command->connectionHandle = session->connectionHandle;
+	command->time = session->time;
+	command->date = session->date;
+	command->enqueuedAt = ble_commands_timestamp();
+
+	commandQueueCount++;
+	commandStats.enqueued++;
+	if (commandQueueCount > commandStats.maxDepth) {
+		commandStats.maxDepth = commandQueueCount;
+	}
+	return true;
+}
+
+void ble_commands_process() {
+	while (commandQueueCount > 0) {
+		BLEControlCommand const command = commandQueue[commandQueueHead];
+		commandQueueHead = (commandQueueHead + 1) % BLE_COMMAND_QUEUE_LENGTH;
+		commandQueueCount--;
+
+		ble_control_command_execute(&command);
+
+		uint32_t const latency = ble_commands_elapsed_us(command.enqueuedAt);
+		commandStats.executed++;
+		commandStats.totalLatencyUs += latency;
+		if (latency > commandStats.maxLatencyUs) {
+			commandStats.maxLatencyUs = latency;
+		}
+		debugPrint("Control command 0x%02X executed, %lu us after it was written", (uint8_t )command.opcode, latency);
+	}
+}
+
+void ble_commands_record_event_path(uint32_t blocked_us) {
+	commandStats.eventPathCalls++;
+	commandStats.eventPathTotalUs += blocked_us;
+	if (blocked_us > commandStats.eventPathMaxUs) {
+		commandStats.eventPathMaxUs = blocked_us;
+	}
+}
+
+BLECommandStats get_ble_command_stats() {
+	return commandStats;
+}
+
+// DWT cycle counter is enabled by HCI_TL_SPI_Init()
+__weak uint32_t ble_commands_timestamp() {
+	return DWT->CYCCNT;
+}
+
+__weak uint32_t ble_commands_elapsed_us(uint32_t since) {
+	return (DWT->CYCCNT - since) / (SystemCoreClock / 1000000u);
+}
+
+__weak void ble_control_command_execute(BLEControlCommand const* command) {
+	UNUSED(command);
+}
@@ -0,0 +1,54 @@
+/*
+ * ble_app_commands.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: steelph0enix
+ */
+
+#ifndef APP_BLE_APP_COMMANDS_H_
+#define APP_BLE_APP_COMMANDS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ble_app_interface.h"
+
+#define BLE_COMMAND_QUEUE_LENGTH 8
+
+// Control byte write, with time and date characteristics values written by the same client,
+// from the moment it was written
+typedef struct BLEControlCommand_t {
+	BLEControlCharValue opcode;
+	uint16_t connectionHandle; // client may be gone when the command is executed, look it up with ble_session_find()
+	RTC_TimeTypeDef time;
+	RTC_DateTypeDef date;
+	uint32_t enqueuedAt; // ble_commands_timestamp()
+} BLEControlCommand;
+
+typedef struct BLECommandStats_t {
+	uint32_t enqueued;
+	uint32_t executed;
+	uint32_t dropped;            // queue was full
+	uint32_t maxDepth;
+	uint32_t maxLatencyUs;       // from GATT write to the end of execution
+	uint64_t totalLatencyUs;
+	uint32_t eventPathMaxUs;     // longest single hci_user_evt_proc() call
+	uint64_t eventPathTotalUs;
+	uint32_t eventPathCalls;
+} BLECommandStats;
+
+// Called from GATT event handlers, only stores the command
+bool ble_command_enqueue(BLESession const* session, BLEControlCharValue opcode);
+
+// Executes queued commands, must be called from the same task as hci_user_evt_proc()
+void ble_commands_process();
+
+void ble_commands_record_event_path(uint32_t blocked_us);
+BLECommandStats get_ble_command_stats();
+
+uint32_t ble_commands_timestamp();
+uint32_t ble_commands_elapsed_us(uint32_t since);
+
+// Implemented by the application, runs in ble_commands_process()
+void ble_control_command_execute(BLEControlCommand const* command);
+
+#endif /* APP_BLE_APP_COMMANDS_H_ */
@@ -0,0 +1,80 @@
+/*
+ * ble_app_events.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: steelph0enix
+ */
+
+#include "ble_app_events.h"
+#include "bluenrg1_types.h"
+
+#include <stddef.h>
+
+// Event dispatch tables are generated at compile time from the lists in ble_app_events.h.
+// Each table consists of:
+//	* handlers array - only the registered processing functions, in list order,
+//	* index array - directly indexed by event key, holds (handler position + 1), or 0
+//	  if event is not handled. Sized automatically by designated initializers, so
+//	  it's only as long as the highest registered key.
+// That makes the lookup O(1), with a single byte per possible event key in flash.
+
+// Vendor event codes are grouped by the ACI command group in bits 10-11 (HAL, GAP, L2CAP, GATT),
+// and event number in bits 0-4. Key packs them into 7 bits.
+#define VENDOR_EVENT_GROUP_SHIFT 10u
+#define VENDOR_EVENT_NUMBER_MASK 0x1Fu
+#define VENDOR_EVENT_UNUSED_BITS 0xF3E0u
+#define VENDOR_EVENT_KEY(code) ((((code) >> VENDOR_EVENT_GROUP_SHIFT) << 5u) | ((code) & VENDOR_EVENT_NUMBER_MASK))
+
+#define ARRAY_LENGTH(array) (sizeof(array) / sizeof((array)[0]))
+
+#define DECLARE_EVENT_PROCESS(code, handler) tBleStatus handler(uint8_t *buffer_in);
+#define EVENT_SLOT(code, handler) handler##_slot,
+#define EVENT_HANDLER(code, handler) handler,
+#define EVENT_INDEX(code, handler) [(code)] = handler##_slot + 1,
+#define VENDOR_EVENT_INDEX(code, handler) [VENDOR_EVENT_KEY(code)] = handler##_slot + 1,
+
+BLE_APP_HCI_EVENTS(DECLARE_EVENT_PROCESS)
+BLE_APP_LE_META_EVENTS(DECLARE_EVENT_PROCESS)
+BLE_APP_VENDOR_EVENTS(DECLARE_EVENT_PROCESS)
+
+// @formatter:off
+enum HCIEventSlot_t { BLE_APP_HCI_EVENTS(EVENT_SLOT) HCI_EVENT_SLOTS_COUNT };
+enum LEMetaEventSlot_t { BLE_APP_LE_META_EVENTS(EVENT_SLOT) LE_META_EVENT_SLOTS_COUNT };
+enum VendorEventSlot_t { BLE_APP_VENDOR_EVENTS(EVENT_SLOT) VENDOR_EVENT_SLOTS_COUNT };
+
+static hci_event_process const hciEventHandlers[] = { BLE_APP_HCI_EVENTS(EVENT_HANDLER) };
+static hci_event_process const leMetaEventHandlers[] = { BLE_APP_LE_META_EVENTS(EVENT_HANDLER) };
+static hci_event_process const vendorEventHandlers[] = { BLE_APP_VENDOR_EVENTS(EVENT_HANDLER) };
+
+static uint8_t const hciEventIndex[] = { BLE_APP_HCI_EVENTS(EVENT_INDEX) };
+static uint8_t const leMetaEventIndex[] = { BLE_APP_LE_META_EVENTS(EVENT_INDEX) };
+static uint8_t const vendorEventIndex[] = { BLE_APP_VENDOR_EVENTS(VENDOR_EVENT_INDEX) };
+// @formatter:on
+
+_Static_assert(VENDOR_EVENT_SLOTS_COUNT < UINT8_MAX, "Too many vendor events registered");
+
+static void dispatch_event(uint8_t const index[], size_t index_length, hci_event_process const handlers[],
+		uint16_t key, void* data) {
+	if (key >= index_length || index[key] == 0) {
+		return;
+	}
+
+	handlers[index[key] - 1]((uint8_t*) data);
+}
+
+void ble_dispatch_hci_event(uint8_t event_code, void* data) {
+	dispatch_event(hciEventIndex, ARRAY_LENGTH(hciEventIndex), hciEventHandlers, event_code, data);
+}
+
+void ble_dispatch_le_meta_event(uint8_t subevent_code, void* data) {
+	dispatch_event(leMetaEventIndex, ARRAY_LENGTH(leMetaEventIndex), leMetaEventHandlers, subevent_code, data);
+}
+
+void ble_dispatch_vendor_event(uint16_t event_code, void* data) {
+	if ((event_code & VENDOR_EVENT_UNUSED_BITS) != 0) {
+		return;
+	}
+
+	dispatch_event(vendorEventIndex, ARRAY_LENGTH(vendorEventIndex), vendorEventHandlers,
+			VENDOR_EVENT_KEY(event_code), data);
+}
@@ -0,0 +1,42 @@
+/*
+ * ble_app_events.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: steelph0enix
+ */
+
+#ifndef APP_BLE_APP_EVENTS_H_
+#define APP_BLE_APP_EVENTS_H_
+
+#include <stdint.h>
+
+// Events handled by the application, as X(event code, event processing function).
+// Only the processing functions listed here are referenced by the dispatcher,
+// so the rest of bluenrg1_events.c (and its weak callbacks) is dropped by the linker.
+// To handle a new event, add it to the matching list and implement its callback.
+
+// HCI events - code from hci_event_pckt.evt
+// @formatter:off
+#define BLE_APP_HCI_EVENTS(X) \
+	X(0x0005, hci_disconnection_complete_event_process)
+
+// LE meta events - code from evt_le_meta_event.subevent
+#define BLE_APP_LE_META_EVENTS(X) \
+	X(0x0001, hci_le_connection_complete_event_process)
+
+// Vendor-specific (ACI) events - code from evt_blue_aci.ecode
+#define BLE_APP_VENDOR_EVENTS(X) \
+	X(0x0001, aci_blue_initialized_event_process) \
+	X(0x0002, aci_blue_events_lost_event_process) \
+	X(0x0C01, aci_gatt_attribute_modified_event_process) \
+	X(0x0C03, aci_att_exchange_mtu_resp_event_process) \
+	X(0x0C14, aci_gatt_read_permit_req_event_process) \
+	X(0x0C15, aci_gatt_read_multi_permit_req_event_process) \
+	X(0x0C16, aci_gatt_tx_pool_available_event_process)
+// @formatter:on
+
+void ble_dispatch_hci_event(uint8_t event_code, void* data);
+void ble_dispatch_le_meta_event(uint8_t subevent_code, void* data);
+void ble_dispatch_vendor_event(uint16_t event_code, void* data);
+
+#endif /* APP_BLE_APP_EVENTS_H_ */
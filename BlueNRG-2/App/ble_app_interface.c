@@ -7,119 +7,191 @@
 
 #include <ble_app_interface.h>
 #include <ble_app_services.h>
+#include "ble_app_commands.h"
+#include "ble_app_advertising.h"
+#include "bluenrg1_gap.h"
 #include "print_utils.h"
 #include "bit_helpers.h"
 
-static RTC_TimeTypeDef bleTime = { 0 };
-static RTC_DateTypeDef bleDate = { 0 };
-static BLEControlCharValue bleControlValue = BLE_CTRL_DEFAULT;
+#include <string.h>
 
-void ble_time_changed(uint8_t data[]) {
+static uint8_t broadcastSequence = 0;
+
+// Manufacturer specific data with the latest measurement, readable by passive scanners:
+// length, AD type (0xFF), company ID (0xFFFF - none, little-endian), sequence number (1 byte),
+// temperature (int16, *C * 100), humidity (uint16, % * 100), pressure (uint16, hPa * 10), all little-endian
+#define BROADCAST_AD_LENGTH 11
+#define BROADCAST_COMPANY_ID 0xFFFF
+
+void ble_time_changed(BLESession* session, uint8_t data[]) {
 	// 3 bytes - hour, minute, second
 	uint8_t const hour = data[0];
 	uint8_t const minute = data[1];
 	uint8_t const second = data[2];
 
-	bleTime.Hours = hour;
-	bleTime.Minutes = minute;
-	bleTime.Seconds = second;
+	session->time.Hours = hour;
+	session->time.Minutes = minute;
+	session->time.Seconds = second;
 
 //	setRTCTime(hour, minute, second);
 }
 
-void ble_date_changed(uint8_t data[]) {
+void ble_date_changed(BLESession* session, uint8_t data[]) {
 	// 4 bytes - year (last two digits), month, day, weekday
 	uint8_t year = data[0];
 	uint8_t month = data[1];
 	uint8_t day = data[2];
 	uint8_t weekday = data[3];
 
-	bleDate.Year = year;
-	bleDate.Month = month;
-	bleDate.Date = day;
-	bleDate.WeekDay = weekday;
+	session->date.Year = year;
+	session->date.Month = month;
+	session->date.Date = day;
+	session->date.WeekDay = weekday;
 
 //	setRTCDay(year, month, day, weekday);
 }
 
-__weak void ble_control_value_changed(BLEControlCharValue value) {
-	UNUSED(value);
-}
-
-void ble_control_byte_changed(BLEControlCharValue value) {
-	debugPrint("BLE control byte changed to 0x%02x", value);
-	bleControlValue = value;
-	ble_control_value_changed(value);
-}
-
-RTC_TimeTypeDef get_ble_time() {
-	return bleTime;
-}
-
-RTC_DateTypeDef get_ble_date() {
-	return bleDate;
-}
-
-BLEControlCharValue get_ble_control_value() {
-	return bleControlValue;
+void ble_control_byte_changed(BLESession const* session, BLEControlCharValue value) {
+	debugPrint("BLE control byte of session #%d changed to 0x%02x", session->index, value);
+	// executed later by ble_commands_process(), outside of the event handler
+	ble_command_enqueue(session, value);
 }
 
-void set_ble_control_value(BLEControlCharValue value) {
-	debugPrint("Control byte value set to 0x%02X", value);
-	set_characteristic_value(BLE_CHAR_CONTROL, &value, 1);
+void set_ble_control_value(BLESession const* session, BLEControlCharValue value) {
+	debugPrint("Control byte value of session #%d set to 0x%02X", session->index, value);
+	set_session_characteristic_value(session, BLE_CHAR_CONTROL, &value, 1);
 }
 
-void set_ble_number_of_records(uint16_t number) {
-	debugPrint("Number of records set to %d", number);
+void set_ble_number_of_records(BLESession const* session, uint16_t number) {
+	debugPrint("Number of records of session #%d set to %d", session->index, number);
 	uint8_t val[2] = { 0 };
 	VALUE_TO_16BIT_BYTEARRAY_LE(number, val);
-	set_characteristic_value(BLE_CHAR_NUMBER_OF_RECORDS, val, 2);
+	set_session_characteristic_value(session, BLE_CHAR_NUMBER_OF_RECORDS, val, 2);
 }
 
-void set_ble_time(uint8_t hour, uint8_t minute, uint8_t second) {
+void set_ble_time(BLESession const* session, uint8_t hour, uint8_t minute, uint8_t second) {
 	debugPrint("Time set to %02d:%02d:%02d", hour, minute, second);
 	uint8_t vals[3] = {hour, minute, second};
-	set_characteristic_value(BLE_CHAR_TIME, vals, 3);
+	set_session_characteristic_value(session, BLE_CHAR_TIME, vals, 3);
 }
 
-void set_ble_date(uint8_t year, uint8_t month, uint8_t day, uint8_t weekday) {
+void set_ble_date(BLESession const* session, uint8_t year, uint8_t month, uint8_t day, uint8_t weekday) {
 	debugPrint("Date set to %02d-%02d-20%02d, weekday #%d", day, month, year, weekday);
 	uint8_t vals[4] = {year, month, day, weekday};
-	set_characteristic_value(BLE_CHAR_DATE, vals, 4);
+	set_session_characteristic_value(session, BLE_CHAR_DATE, vals, 4);
 }
 
-void set_ble_temperature(int32_t temperature) {
+void set_ble_temperature(BLESession const* session, int32_t temperature) {
 	debugPrint("Temperature set to %ld", temperature);
 	uint8_t val[4] = {0};
 	VALUE_TO_32BIT_BYTEARRAY_LE(temperature, val);
-	set_characteristic_value(BLE_CHAR_TEMPERATURE, val, 4);
+	set_session_characteristic_value(session, BLE_CHAR_TEMPERATURE, val, 4);
 }
 
-void set_ble_pressure(int32_t pressure) {
+void set_ble_pressure(BLESession const* session, int32_t pressure) {
 	debugPrint("Pressure set to %ld", pressure);
 	uint8_t val[4] = {0};
 	VALUE_TO_32BIT_BYTEARRAY_LE(pressure, val);
-	set_characteristic_value(BLE_CHAR_PRESSURE, val, 4);
+	set_session_characteristic_value(session, BLE_CHAR_PRESSURE, val, 4);
 }
 
-void set_ble_humidity(int32_t humidity) {
+void set_ble_humidity(BLESession const* session, int32_t humidity) {
 	debugPrint("Humidity set to %ld", humidity);
 	uint8_t val[4] = {0};
 	VALUE_TO_32BIT_BYTEARRAY_LE(humidity, val);
-	set_characteristic_value(BLE_CHAR_HUMIDITY, val, 4);
+	set_session_characteristic_value(session, BLE_CHAR_HUMIDITY, val, 4);
+}
+
+void set_ble_live_measurement(int32_t temperature, int32_t pressure, int32_t humidity) {
+	uint8_t vals[12] = { 0 };
+	uint8_t* temperatureBytes = &vals[0];
+	uint8_t* pressureBytes = &vals[4];
+	uint8_t* humidityBytes = &vals[8];
+	VALUE_TO_32BIT_BYTEARRAY_LE(temperature, temperatureBytes);
+	VALUE_TO_32BIT_BYTEARRAY_LE(pressure, pressureBytes);
+	VALUE_TO_32BIT_BYTEARRAY_LE(humidity, humidityBytes);
+	set_characteristic_value(BLE_CHAR_LIVE_MEASUREMENT, vals, 12);
+}
+
+void set_ble_filter_config(uint8_t const config[BLE_FILTER_CONFIG_LENGTH]) {
+	uint8_t vals[BLE_FILTER_CONFIG_LENGTH] = { 0 };
+	memcpy(vals, config, BLE_FILTER_CONFIG_LENGTH);
+	set_characteristic_value(BLE_CHAR_FILTER_CONFIG, vals, BLE_FILTER_CONFIG_LENGTH);
 }
 
-void characteristic_value_changed(BLECharacteristic characteristic,
+void set_ble_station_altitude(int16_t altitude) {
+	uint8_t val[2] = { 0 };
+	VALUE_TO_16BIT_BYTEARRAY_LE((uint16_t) altitude, val);
+	set_characteristic_value(BLE_CHAR_STATION_ALTITUDE, val, 2);
+}
+
+void set_ble_derived_metrics(int32_t dew_point, int32_t absolute_humidity, int32_t heat_index,
+		int32_t sea_level_pressure) {
+	uint8_t vals[16] = { 0 };
+	uint8_t* dewPointBytes = &vals[0];
+	uint8_t* absoluteHumidityBytes = &vals[4];
+	uint8_t* heatIndexBytes = &vals[8];
+	uint8_t* seaLevelPressureBytes = &vals[12];
+	VALUE_TO_32BIT_BYTEARRAY_LE(dew_point, dewPointBytes);
+	VALUE_TO_32BIT_BYTEARRAY_LE(absolute_humidity, absoluteHumidityBytes);
+	VALUE_TO_32BIT_BYTEARRAY_LE(heat_index, heatIndexBytes);
+	VALUE_TO_32BIT_BYTEARRAY_LE(sea_level_pressure, seaLevelPressureBytes);
+	set_characteristic_value(BLE_CHAR_DERIVED_METRICS, vals, 16);
+}
+
+void set_ble_pressure_trend(int16_t change_1h, int16_t change_3h, uint8_t tendency, char forecast) {
+	uint8_t vals[6] = { 0 };
+	uint8_t* change1hBytes = &vals[0];
+	uint8_t* change3hBytes = &vals[2];
+	VALUE_TO_16BIT_BYTEARRAY_LE((uint16_t) change_1h, change1hBytes);
+	VALUE_TO_16BIT_BYTEARRAY_LE((uint16_t) change_3h, change3hBytes);
+	vals[4] = tendency;
+	vals[5] = (uint8_t) forecast;
+	set_characteristic_value(BLE_CHAR_PRESSURE_TREND, vals, 6);
+}
+
+static int16_t clamp_16bit(int32_t value) {
+	return value > INT16_MAX ? INT16_MAX : (value < INT16_MIN ? INT16_MIN : (int16_t) value);
+}
+
+void set_ble_broadcast_measurement(int32_t temperature, int32_t pressure, int32_t humidity) {
+	uint8_t ad[BROADCAST_AD_LENGTH] = { 0 };
+	uint8_t* companyBytes = &ad[2];
+	uint8_t* temperatureBytes = &ad[5];
+	uint8_t* humidityBytes = &ad[7];
+	uint8_t* pressureBytes = &ad[9];
+	uint16_t const temperatureValue = (uint16_t) clamp_16bit(temperature);
+	uint16_t const humidityValue = (uint16_t) humidity;
+	uint16_t const pressureValue = (uint16_t) (pressure / 10);
+
+	ad[0] = BROADCAST_AD_LENGTH - 1;
+	ad[1] = AD_TYPE_MANUFACTURER_SPECIFIC_DATA;
+	VALUE_TO_16BIT_BYTEARRAY_LE(BROADCAST_COMPANY_ID, companyBytes);
+	ad[4] = ++broadcastSequence;
+	VALUE_TO_16BIT_BYTEARRAY_LE(temperatureValue, temperatureBytes);
+	VALUE_TO_16BIT_BYTEARRAY_LE(humidityValue, humidityBytes);
+	VALUE_TO_16BIT_BYTEARRAY_LE(pressureValue, pressureBytes);
+
+	ble_update_broadcast_data(ad, BROADCAST_AD_LENGTH);
+}
+
+void characteristic_value_changed(BLESession* session, BLECharacteristic characteristic,
 		uint8_t data[], uint16_t length) {
 	switch (characteristic) {
 	case BLE_CHAR_TIME:
-		ble_time_changed(data);
+		ble_time_changed(session, data);
 		break;
 	case BLE_CHAR_DATE:
-		ble_date_changed(data);
+		ble_date_changed(session, data);
 		break;
 	case BLE_CHAR_CONTROL:
-		ble_control_byte_changed(data[0]);
+		ble_control_byte_changed(session, data[0]);
+		break;
+	case BLE_CHAR_FILTER_CONFIG:
+		ble_filter_config_written(data, length);
+		break;
+	case BLE_CHAR_STATION_ALTITUDE:
+		ble_station_altitude_written(data, length);
 		break;
 	default:
 		debugPrint("Unexpected characteristic change, char id: %d, length: %d",
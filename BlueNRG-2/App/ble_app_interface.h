@@ -10,6 +10,11 @@
 
 #include <stdint.h>
 #include "rtc_utils.h"
+#include "ble_app_sessions.h"
+
+// Filter type and parameter, for 3 stages of 3 channels
+#define BLE_FILTER_CONFIG_LENGTH 18
+#define BLE_PRESSURE_CHANGE_UNKNOWN INT16_MIN
 
 typedef enum BLEControlCharValue_t {
 	BLE_CTRL_DEFAULT = 0x00,
@@ -21,19 +26,25 @@ typedef enum BLEControlCharValue_t {
 	BLE_CTRL_SET_DATE_AND_TIME = 0x06
 } BLEControlCharValue;
 
-RTC_TimeTypeDef get_ble_time();
-RTC_DateTypeDef get_ble_date();
-BLEControlCharValue get_ble_control_value();
-uint16_t get_ble_number_of_records();
-
-void set_ble_control_value(BLEControlCharValue value);
-void set_ble_number_of_records(uint16_t number);
-void set_ble_time(uint8_t hour, uint8_t minute, uint8_t second);
-void set_ble_date(uint8_t year, uint8_t month, uint8_t day, uint8_t weekday);
-void set_ble_temperature(int32_t temperature);
-void set_ble_pressure(int32_t pressure);
-void set_ble_humidity(int32_t humidity);
+// Record and control characteristics are per session, every client sees only its own transfer
+void set_ble_control_value(BLESession const* session, BLEControlCharValue value);
+void set_ble_number_of_records(BLESession const* session, uint16_t number);
+void set_ble_time(BLESession const* session, uint8_t hour, uint8_t minute, uint8_t second);
+void set_ble_date(BLESession const* session, uint8_t year, uint8_t month, uint8_t day, uint8_t weekday);
+void set_ble_temperature(BLESession const* session, int32_t temperature);
+void set_ble_pressure(BLESession const* session, int32_t pressure);
+void set_ble_humidity(BLESession const* session, int32_t humidity);
+void set_ble_live_measurement(int32_t temperature, int32_t pressure, int32_t humidity);
+void set_ble_broadcast_measurement(int32_t temperature, int32_t pressure, int32_t humidity);
+void set_ble_filter_config(uint8_t const config[BLE_FILTER_CONFIG_LENGTH]);
+void set_ble_station_altitude(int16_t altitude);
+void set_ble_derived_metrics(int32_t dew_point, int32_t absolute_humidity, int32_t heat_index,
+		int32_t sea_level_pressure);
+// Changes are BLE_PRESSURE_CHANGE_UNKNOWN when there's not enough history for them
+void set_ble_pressure_trend(int16_t change_1h, int16_t change_3h, uint8_t tendency, char forecast);
 
-void ble_control_value_changed(BLEControlCharValue value);
+// Implemented by the application, called from the GATT event handler
+void ble_filter_config_written(uint8_t const data[], uint16_t length);
+void ble_station_altitude_written(uint8_t const data[], uint16_t length);
 
 #endif /* APP_BLE_APP_INTERFACE_H_ */
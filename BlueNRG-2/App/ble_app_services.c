@@ -7,29 +7,32 @@
 
 #include <ble_app_interface.h>
 #include <ble_app_services.h>
+#include "ble_app_sessions.h"
 #include "bluenrg1_aci.h"
 #include "bluenrg1_events.h"
 #include "print_utils.h"
 #include "bit_helpers.h"
 #include <string.h>
 
-#define UUID_LENGTH 16
+// 128-bit UUID in BlueNRG (little-endian) byte order, arguments are written MSB first like in the UUID string
+// @formatter:off
+#define UUID_128(b15, b14, b13, b12, b11, b10, b9, b8, b7, b6, b5, b4, b3, b2, b1, b0) \
+	{ b0, b1, b2, b3, b4, b5, b6, b7, b8, b9, b10, b11, b12, b13, b14, b15 }
+// 5558caXX-ab6b-4d0d-95a6-fa45388080c2, where XX is the id
+#define WEATHER_STATION_UUID(id) \
+	UUID_128(0x55, 0x58, 0xCA, (id), 0xAB, 0x6B, 0x4D, 0x0D, 0x95, 0xA6, 0xFA, 0x45, 0x38, 0x80, 0x80, 0xC2)
+// @formatter:on
 
-// 5558ca9b-ab6b-4d0d-95a6-fa45388080c2 - service UUID
-static uint8_t const weatherServiceUUIDBytes[UUID_LENGTH] = { 0x55, 0x58, 0xCA, 0x9B, 0xAB, 0x6B, 0x4D, 0x0D, 0x95,
-		0xA6, 0xFA, 0x45, 0x38, 0x80, 0x80, 0xC2 };
+// Weather station service - 5558ca9b-ab6b-4d0d-95a6-fa45388080c2
+#define WEATHER_SERVICE_UUID_ID 0x9B
 
 // 5558caa0-ab6b-4d0d-95a6-fa45388080c2 - time characteristic
 // Contains 3 bytes, in order from MSB: hour, minute, second.
 // Read/write.
-static uint8_t const timeCharUUIDBytes[UUID_LENGTH] = { 0x55, 0x58, 0xCA, 0xA0, 0xAB, 0x6B, 0x4D, 0x0D, 0x95, 0xA6,
-		0xFA, 0x45, 0x38, 0x80, 0x80, 0xC2 };
 
 // 5558caa1-ab6b-4d0d-95a6-fa45388080c2 - date characteristic
 // Contains 4 bytes, in order from MSB: year (last two digits), month, day and weekday (1-7)
 // Read/write.
-static uint8_t const dateCharUUIDBytes[UUID_LENGTH] = { 0x55, 0x58, 0xCA, 0xA1, 0xAB, 0x6B, 0x4D, 0x0D, 0x95, 0xA6,
-		0xFA, 0x45, 0x38, 0x80, 0x80, 0xC2 };
 
 // 5558caa2-ab6b-4d0d-95a6-fa45388080c2 - temperature characteristic
 // Contains 4-byte temperature value, stored as fixed-point integer
@@ -37,20 +40,14 @@ static uint8_t const dateCharUUIDBytes[UUID_LENGTH] = { 0x55, 0x58, 0xCA, 0xA1,
 // After reading, divide it by 100 to get the correct value.
 // For example, if you read 2034 - that means the temperature is 20.34*C
 // Read-only.
-static uint8_t const temperatureCharUUIDBytes[UUID_LENGTH] = { 0x55, 0x58, 0xCA, 0xA2, 0xAB, 0x6B, 0x4D, 0x0D, 0x95,
-		0xA6, 0xFA, 0x45, 0x38, 0x80, 0x80, 0xC2 };
 
 // 5558caa3-ab6b-4d0d-95a6-fa45388080c2 - pressure characteristic
 // Stored the same way as temperature.
 // Read-only.
-static uint8_t const pressureCharUUIDBytes[UUID_LENGTH] = { 0x55, 0x58, 0xCA, 0xA3, 0xAB, 0x6B, 0x4D, 0x0D, 0x95, 0xA6,
-		0xFA, 0x45, 0x38, 0x80, 0x80, 0xC2 };
 
 // 5558caa4-ab6b-4d0d-95a6-fa45388080c2 - humidity characteristic
 // Stored the same way as temperature.
 // Read-only.
-static uint8_t const humidityCharUUIDBytes[UUID_LENGTH] = { 0x55, 0x58, 0xCA, 0xA4, 0xAB, 0x6B, 0x4D, 0x0D, 0x95, 0xA6,
-		0xFA, 0x45, 0x38, 0x80, 0x80, 0xC2 };
 
 // 5558caa5-ab6b-4d0d-95a6-fa45388080c2 - control characteristic
 // Single-byte value, read/write/notify. Valid values are:
@@ -89,62 +86,194 @@ static uint8_t const humidityCharUUIDBytes[UUID_LENGTH] = { 0x55, 0x58, 0xCA, 0x
 // Value set by weather station:
 //	* DEFAULT
 //	* NEXT_RECORD_AVAILABLE
-static uint8_t const controlCharUUIDBytes[UUID_LENGTH] = { 0x55, 0x58, 0xCA, 0xA5, 0xAB, 0x6B, 0x4D, 0x0D, 0x95, 0xA6,
-		0xFA, 0x45, 0x38, 0x80, 0x80, 0xC2 };
 
 // 5558caa6-ab6b-4d0d-95a6-fa45388080c2 - numberOfRecords characteristic
 // 2-byte integer, read/notify. Is always set to number of available records
 // on the device, that can be fetched with GET_DATA command.
-static uint8_t const numberOfRecordsCharUUIDBytes[UUID_LENGTH] = { 0x55, 0x58, 0xCA, 0xA6, 0xAB, 0x6B, 0x4D, 0x0D, 0x95, 0xA6,
-		0xFA, 0x45, 0x38, 0x80, 0x80, 0xC2 };
-
-static Service_UUID_t weatherServiceUUID;
-static Char_UUID_t timeCharUUID;
-static Char_UUID_t dateCharUUID;
-static Char_UUID_t temperatureCharUUID;
-static Char_UUID_t pressureCharUUID;
-static Char_UUID_t humidityCharUUID;
-static Char_UUID_t controlCharUUID;
-static Char_UUID_t numberOfRecordsCharUUID;
+
+// 5558caa7-ab6b-4d0d-95a6-fa45388080c2 - diagnostics characteristic
+// 18 bytes, read-only, little-endian. HCI packet pool and BlueNRG event loss counters:
+// pool size (1 byte), pool high water mark (1), pool exhausted count (2), events recycled
+// without processing (2), invalid packets (2), events lost reports (2), lost event types bitmap (8).
+
+// 5558caa8-ab6b-4d0d-95a6-fa45388080c2 - live measurement characteristic
+// 12 bytes, read/notify, little-endian. Latest measurement: temperature, pressure
+// and humidity, each stored like in their own characteristics (4 bytes, multiplied by 100).
+// Enable notifications to get every new measurement as soon as it's made.
+
+// 5558caa9-ab6b-4d0d-95a6-fa45388080c2 - filter configuration characteristic
+// 18 bytes, read/write. Filters applied to the samples before they're stored, for temperature,
+// pressure and humidity in that order, 3 stages per channel, run in order. Every stage is
+// 2 bytes: filter type and its parameter.
+// 0x00 - none
+// 0x01 - moving average, parameter: window (1-8 samples)
+// 0x02 - median, parameter: window (1-8 samples)
+// 0x03 - exponential, parameter: k (1-8), output moves by 1/2^k of the difference with every sample
+// 0x04 - spike rejection, parameter: largest step between samples (1-255) in 0.1 units (*C, hPa, %),
+//        sample jumping further is dropped, unless the jump lasts for 3 samples
+// With any filter set, sensors are sampled every minute between the stored measurements. Pressure
+// is averaged over the whole measurement interval, the minute samples see the average so far.
+// Invalid configuration is rejected and the previous one is put back.
+
+// 5558caaa-ab6b-4d0d-95a6-fa45388080c2 - station altitude characteristic
+// 2-byte signed integer, read/write, little-endian. Altitude of the station in meters (-500 to 9000),
+// used for the sea-level pressure. 0 by default, applies from the next measurement.
+
+// 5558caab-ab6b-4d0d-95a6-fa45388080c2 - derived metrics characteristic
+// 16 bytes, read/notify, little-endian. Calculated from the latest measurement: dew point (*C),
+// absolute humidity (g/m3), heat index (*C) and sea-level pressure (hPa), each stored like
+// temperature (4 bytes, multiplied by 100). A metric is 0x80000000 when a sensor it needs failed
+// (all of them need the temperature, sea-level pressure the pressure, the rest the humidity).
+
+// 5558caac-ab6b-4d0d-95a6-fa45388080c2 - pressure trend characteristic
+// 6 bytes, read/notify, little-endian. Updated with every measurement:
+// pressure change in the last hour (2 bytes, signed, 0.01 hPa per hour),
+// pressure change in the last 3 hours (2 bytes, signed, 0.01 hPa), both 0x8000 until there's
+// enough history, tendency (1 byte: 0 - unknown, 1 - falling, 2 - steady, 3 - rising)
+// and Zambretti forecast letter (1 byte, ASCII 'A' settled fine to 'Z' stormy, 0 - unknown).
+
+// Weather station service characteristics, as
+// X(characteristic ID, UUID id, value length (bytes), properties, event mask, value scope)
+// Characteristics are added to the service in this order.
+// Characteristics with LAZY_VALUE event mask are not sent to BlueNRG when their value is set.
+// Value is sent when a client reads it (BlueNRG holds the read until aci_gatt_allow_read()),
+// or when it subscribes to notifications - from then on, it's sent like any other value.
+// SESSION_VALUE characteristics have separate value for every connected client (see BLESession),
+// so a client fetching records doesn't see the records of another one. They have to be lazy,
+// GATT database has a single value slot, it's filled with reader's value when the read is held.
+// @formatter:off
+#define WEATHER_SERVICE_CHARACTERISTICS(X) \
+	X(BLE_CHAR_TIME,              0xA0, 3,  CHAR_PROP_READ | CHAR_PROP_WRITE,                    GATT_NOTIFY_ATTRIBUTE_WRITE | LAZY_VALUE, SESSION_VALUE) \
+	X(BLE_CHAR_DATE,              0xA1, 4,  CHAR_PROP_READ | CHAR_PROP_WRITE,                    GATT_NOTIFY_ATTRIBUTE_WRITE | LAZY_VALUE, SESSION_VALUE) \
+	X(BLE_CHAR_TEMPERATURE,       0xA2, 4,  CHAR_PROP_READ,                                      LAZY_VALUE,                               SESSION_VALUE) \
+	X(BLE_CHAR_PRESSURE,          0xA3, 4,  CHAR_PROP_READ,                                      LAZY_VALUE,                               SESSION_VALUE) \
+	X(BLE_CHAR_HUMIDITY,          0xA4, 4,  CHAR_PROP_READ,                                      LAZY_VALUE,                               SESSION_VALUE) \
+	X(BLE_CHAR_CONTROL,           0xA5, 1,  CHAR_PROP_READ | CHAR_PROP_WRITE | CHAR_PROP_NOTIFY, GATT_NOTIFY_ATTRIBUTE_WRITE | LAZY_VALUE, SESSION_VALUE) \
+	X(BLE_CHAR_NUMBER_OF_RECORDS, 0xA6, 2,  CHAR_PROP_READ | CHAR_PROP_NOTIFY,                   LAZY_VALUE,                               SESSION_VALUE) \
+	X(BLE_CHAR_DIAGNOSTICS,       0xA7, 18, CHAR_PROP_READ,                                      LAZY_VALUE,                               SHARED_VALUE) \
+	X(BLE_CHAR_LIVE_MEASUREMENT,  0xA8, 12, CHAR_PROP_READ | CHAR_PROP_NOTIFY,                   LAZY_VALUE,                               SHARED_VALUE) \
+	X(BLE_CHAR_FILTER_CONFIG,     0xA9, BLE_FILTER_CONFIG_LENGTH, CHAR_PROP_READ | CHAR_PROP_WRITE, GATT_NOTIFY_ATTRIBUTE_WRITE | LAZY_VALUE, SHARED_VALUE) \
+	X(BLE_CHAR_STATION_ALTITUDE,  0xAA, 2,  CHAR_PROP_READ | CHAR_PROP_WRITE,                    GATT_NOTIFY_ATTRIBUTE_WRITE | LAZY_VALUE, SHARED_VALUE) \
+	X(BLE_CHAR_DERIVED_METRICS,   0xAB, 16, CHAR_PROP_READ | CHAR_PROP_NOTIFY,                   LAZY_VALUE,                               SHARED_VALUE) \
+	X(BLE_CHAR_PRESSURE_TREND,    0xAC, 6,  CHAR_PROP_READ | CHAR_PROP_NOTIFY,                   LAZY_VALUE,                               SHARED_VALUE)
+// @formatter:on
+
+#define LAZY_VALUE GATT_NOTIFY_READ_REQ_AND_WAIT_FOR_APPL_RESP
+#define SHARED_VALUE false
+#define SESSION_VALUE true
+
+// Attribute records used by a characteristic: declaration and value,
+// plus client configuration descriptor if it can notify or indicate.
+#define CHAR_ATTRIBUTE_RECORDS(properties) (2 + (((properties) & (CHAR_PROP_NOTIFY | CHAR_PROP_INDICATE)) ? 1 : 0))
+#define CHAR_RECORDS_SUM(id, uuid, length, properties, events, scope) + CHAR_ATTRIBUTE_RECORDS(properties)
+// Service declaration + all characteristics records
+#define WEATHER_SERVICE_RECORDS (1 WEATHER_SERVICE_CHARACTERISTICS(CHAR_RECORDS_SUM))
+
+typedef struct BLECharDescriptor_t {
+	Char_UUID_t uuid;
+	uint8_t valueLength;
+	uint8_t properties;
+	uint8_t eventMask;
+	bool isPerSession;
+} BLECharDescriptor;
+
+#define CHAR_DESCRIPTOR(id, uuid_id, length, char_properties, events, scope) \
+	[id] = { .uuid = { .Char_UUID_128 = WEATHER_STATION_UUID(uuid_id) }, .valueLength = (length), \
+			.properties = (char_properties), .eventMask = (events), .isPerSession = (scope) },
+
+static Service_UUID_t const weatherServiceUUID = { .Service_UUID_128 = WEATHER_STATION_UUID(WEATHER_SERVICE_UUID_ID) };
+static BLECharDescriptor const weatherServiceCharacteristics[] = { WEATHER_SERVICE_CHARACTERISTICS(CHAR_DESCRIPTOR) };
+
+_Static_assert(sizeof(weatherServiceCharacteristics) / sizeof(weatherServiceCharacteristics[0]) == BLE_CHAR_INVALID,
+		"Every BLECharacteristic must be described in WEATHER_SERVICE_CHARACTERISTICS");
 
 static uint16_t weatherServiceHandle;
-static uint16_t timeCharHandle;
-static uint16_t dateCharHandle;
-static uint16_t temperatureCharHandle;
-static uint16_t pressureCharHandle;
-static uint16_t humidityCharHandle;
-static uint16_t controlCharHandle;
-static uint16_t numberOfRecordsCharHandle;
+static uint16_t charHandles[BLE_CHAR_INVALID];
 
-static uint16_t* const charIDBindTable[] = { &timeCharHandle, &dateCharHandle, &temperatureCharHandle,
-		&pressureCharHandle, &humidityCharHandle, &controlCharHandle, &numberOfRecordsCharHandle };
+// Attribute handle offset from the service handle -> characteristic which value (or CCCD,
+// with ATTRIBUTE_CCCD_FLAG set) is stored there.
+// Filled while characteristics are added, BLE_CHAR_INVALID for other attributes.
+static uint8_t attributeOffsetToChar[WEATHER_SERVICE_RECORDS];
 
 #define CHAR_VALUE_OFFSET 1
+#define CHAR_CCCD_OFFSET 2
+#define ATTRIBUTE_CCCD_FLAG 0x80
+#define CCCD_NOTIFY_OR_INDICATE 0x03
+
+// aci_gatt_update_char_value_ext() Update_Type
+#define GATT_LOCAL_UPDATE 0x00
+#define GATT_NOTIFICATION 0x01
+
+// Values are sent to BlueNRG once per ble_process() pass, and only when they differ
+// from what's already in its GATT database.
+#define CHAR_VALUE_MAX_LENGTH 20
+
+typedef struct CharValueShadow_t {
+	uint8_t pushed[CHAR_VALUE_MAX_LENGTH];
+	uint8_t pending[CHAR_VALUE_MAX_LENGTH];
+	uint16_t pushedLength;
+	uint16_t pendingLength;
+	bool isPushed;
+	bool isPending;
+	bool isDeferred;   // lazy value in pending buffer, waiting for a read or subscription
+} CharValueShadow;
+
+// Values of SESSION_VALUE characteristics are kept per session, in the slot with session's index.
+// The last slot keeps values that are the same for everyone.
+#define SHARED_VALUE_SLOT BLE_MAX_CONNECTIONS
+#define VALUE_SLOTS (BLE_MAX_CONNECTIONS + 1)
+#define NO_VALUE_SLOT 0xFF
+
+typedef struct PendingCharValue_t {
+	uint8_t slot;
+	BLECharacteristic characteristic;
+} PendingCharValue;
+
+static CharValueShadow charValueShadows[VALUE_SLOTS][BLE_CHAR_INVALID];
+static PendingCharValue pendingCharValues[VALUE_SLOTS * BLE_CHAR_INVALID];
+static uint8_t pendingCharValuesCount = 0;
+// Slot which value of SESSION_VALUE characteristic is in GATT database now
+static uint8_t databaseValueSlots[BLE_CHAR_INVALID];
+// BlueNRG refused a notification, nothing is sent until it reports free TX buffers
+static bool isWaitingForTxPool = false;
+static BLEValueCacheStats valueCacheStats = { 0 };
+
+static void update_pushed_value(CharValueShadow* shadow, uint8_t const data[], uint16_t length);
+static void subscription_changed(BLESession* session, BLECharacteristic characteristic, uint8_t const cccd[],
+		uint16_t length);
+
+static bool is_lazy(BLECharacteristic characteristic) {
+	return (weatherServiceCharacteristics[characteristic].eventMask & LAZY_VALUE) != 0;
+}
 
-void copy_reversed_uuid(uint8_t const* const source, uint8_t* destination);
+static bool is_per_session(BLECharacteristic characteristic) {
+	return weatherServiceCharacteristics[characteristic].isPerSession;
+}
+
+// Shared values are notified to everyone who subscribed, session values only to their own client
+static bool is_subscribed(uint8_t slot, BLECharacteristic characteristic) {
+	for (uint8_t index = 0; index < BLE_MAX_CONNECTIONS; index++) {
+		BLESession const* session = ble_session_at(index);
+		if (session != NULL && (slot == SHARED_VALUE_SLOT || slot == index)
+				&& ble_session_is_subscribed(session, characteristic)) {
+			return true;
+		}
+	}
+	return false;
+}
 
 void add_app_services() {
 	tBleStatus status = BLE_STATUS_SUCCESS;
 
-	copy_reversed_uuid(weatherServiceUUIDBytes, weatherServiceUUID.Service_UUID_128);
-	copy_reversed_uuid(timeCharUUIDBytes, timeCharUUID.Char_UUID_128);
-	copy_reversed_uuid(dateCharUUIDBytes, dateCharUUID.Char_UUID_128);
-	copy_reversed_uuid(temperatureCharUUIDBytes, temperatureCharUUID.Char_UUID_128);
-	copy_reversed_uuid(pressureCharUUIDBytes, pressureCharUUID.Char_UUID_128);
-	copy_reversed_uuid(humidityCharUUIDBytes, humidityCharUUID.Char_UUID_128);
-	copy_reversed_uuid(controlCharUUIDBytes, controlCharUUID.Char_UUID_128);
-	copy_reversed_uuid(numberOfRecordsCharUUIDBytes, numberOfRecordsCharUUID.Char_UUID_128);
-
-	// CALCULATING MAX ATTRIBUTE RECORDS:
-	// At least 1 byte is required for service itself.
-	// On top of that, add 3 bytes per characteristic. Characteristic value length doesn't matter.
+	memset(attributeOffsetToChar, BLE_CHAR_INVALID, sizeof(attributeOffsetToChar));
+	memset(databaseValueSlots, NO_VALUE_SLOT, sizeof(databaseValueSlots));
 
 	// @formatter:off
 	status = aci_gatt_add_service(
 			UUID_TYPE_128, // UUID type
-			&weatherServiceUUID, // service UUID
+			(Service_UUID_t*) &weatherServiceUUID, // service UUID
 			PRIMARY_SERVICE, // service type
-			1+(7*3), // max attribute records, 1 + (numOfChars*3)
+			WEATHER_SERVICE_RECORDS, // max attribute records
 			&weatherServiceHandle // service handle
 	);
 						// @formatter:on
@@ -152,240 +281,349 @@ void add_app_services() {
 		debugPrint("Couldn't add weather station service!");
 		return;
 	} else {
-		debugPrint("Added weather station service, handle: 0x%04X", weatherServiceHandle);
+		debugPrint("Added weather station service, handle: 0x%04X, %d attribute records", weatherServiceHandle,
+				WEATHER_SERVICE_RECORDS);
 	}
 
-	// @formatter:off
-	status = aci_gatt_add_char(
-			 weatherServiceHandle, // service handle
-			 UUID_TYPE_128, // UUID type
-			 &timeCharUUID, // UUID
-			 3, // value length (bytes)
-			 CHAR_PROP_READ | CHAR_PROP_WRITE, // properties
-			 ATTR_PERMISSION_NONE, // permissions
-			 GATT_NOTIFY_ATTRIBUTE_WRITE, // event mask
-			 16, // enc key size
-			 0, // is available
-			 &timeCharHandle // handle
-	);
-						// @formatter:on
-	if (status != BLE_STATUS_SUCCESS) {
-		debugPrint("Couldn't add time characteristic!");
-		return;
-	} else {
-		debugPrint("Added time characteristic, handle: 0x%04X", timeCharHandle);
+	for (uint8_t id = 0; id < BLE_CHAR_INVALID; id++) {
+		BLECharDescriptor const* descriptor = &weatherServiceCharacteristics[id];
+
+		// @formatter:off
+		status = aci_gatt_add_char(
+				 weatherServiceHandle, // service handle
+				 UUID_TYPE_128, // UUID type
+				 (Char_UUID_t*) &descriptor->uuid, // UUID
+				 descriptor->valueLength, // value length (bytes)
+				 descriptor->properties, // properties
+				 ATTR_PERMISSION_NONE, // permissions
+				 descriptor->eventMask, // event mask
+				 16, // enc key size
+				 0, // is available
+				 &charHandles[id] // handle
+		);
+							// @formatter:on
+		if (status != BLE_STATUS_SUCCESS) {
+			debugPrint("Couldn't add characteristic #%d!", id);
+			return;
+		}
+
+		uint16_t const valueOffset = charHandles[id] + CHAR_VALUE_OFFSET - weatherServiceHandle;
+		if (valueOffset < WEATHER_SERVICE_RECORDS) {
+			attributeOffsetToChar[valueOffset] = id;
+		}
+		if (CHAR_ATTRIBUTE_RECORDS(descriptor->properties) > CHAR_CCCD_OFFSET
+				&& valueOffset + 1 < WEATHER_SERVICE_RECORDS) {
+			attributeOffsetToChar[valueOffset + 1] = id | ATTRIBUTE_CCCD_FLAG;
+		}
+		debugPrint("Added characteristic #%d, handle: 0x%04X", id, charHandles[id]);
 	}
+}
 
-	// @formatter:off
-	status = aci_gatt_add_char(
-			 weatherServiceHandle, // service handle
-			 UUID_TYPE_128, // UUID type
-			 &dateCharUUID, // UUID
-			 4, // value length (bytes)
-			 CHAR_PROP_READ | CHAR_PROP_WRITE, // properties
-			 ATTR_PERMISSION_NONE, // permissions
-			 GATT_NOTIFY_ATTRIBUTE_WRITE, // event mask
-			 16, // enc key size
-			 0, // is available
-			 &dateCharHandle // handle
-	);
-						// @formatter:on
-	if (status != BLE_STATUS_SUCCESS) {
-		debugPrint("Couldn't add date characteristic!");
-		return;
-	} else {
-		debugPrint("Added date characteristic, handle: 0x%04X", dateCharHandle);
+void invert_byte_order(uint8_t data[], size_t length) {
+	uint8_t* startPtr = data;
+	uint8_t* endPtr = data + length - 1;
+	while (startPtr < endPtr) {
+		uint8_t tempValue = *startPtr;
+		*startPtr = *endPtr;
+		*endPtr = tempValue;
+		startPtr++;
+		endPtr--;
 	}
+}
 
-	// @formatter:off
-	status = aci_gatt_add_char(
-			 weatherServiceHandle, // service handle
-			 UUID_TYPE_128, // UUID type
-			 &temperatureCharUUID, // UUID
-			 4, // value length (bytes)
-			 CHAR_PROP_READ, // properties
-			 ATTR_PERMISSION_NONE, // permissions
-			 GATT_DONT_NOTIFY_EVENTS, // event mask
-			 16, // enc key size
-			 0, // is available
-			 &temperatureCharHandle // handle
-	);
-						// @formatter:on
-	if (status != BLE_STATUS_SUCCESS) {
-		debugPrint("Couldn't add temperature characteristic!");
+static uint8_t find_attribute(uint16_t attribute_handle) {
+	uint16_t const offset = attribute_handle - weatherServiceHandle;
+	if (attribute_handle > weatherServiceHandle && offset < WEATHER_SERVICE_RECORDS) {
+		return attributeOffsetToChar[offset];
+	}
+	return BLE_CHAR_INVALID;
+}
+
+void aci_gatt_attribute_modified_event(uint16_t Connection_Handle, uint16_t Attr_Handle, uint16_t Offset,
+		uint16_t Attr_Data_Length, uint8_t Attr_Data[]) {
+	debugPrint("Device 0x%04X modified GATT attribute 0x%04X (offset 0x%04X), data length: %d bytes", Connection_Handle,
+			Attr_Handle, Offset, Attr_Data_Length);
+
+	BLESession* session = ble_session_find(Connection_Handle);
+	if (session == NULL) {
 		return;
-	} else {
-		debugPrint("Added temperature characteristic, handle: 0x%04X", temperatureCharHandle);
 	}
 
-	// @formatter:off
-	status = aci_gatt_add_char(
-			 weatherServiceHandle, // service handle
-			 UUID_TYPE_128, // UUID type
-			 &pressureCharUUID, // UUID
-			 4, // value length (bytes)
-			 CHAR_PROP_READ, // properties
-			 ATTR_PERMISSION_NONE, // permissions
-			 GATT_DONT_NOTIFY_EVENTS, // event mask
-			 16, // enc key size
-			 0, // is available
-			 &pressureCharHandle // handle
-	);
-						// @formatter:on
-	if (status != BLE_STATUS_SUCCESS) {
-		debugPrint("Couldn't add pressure characteristic!");
+	// Attribute handles are mapped directly by their offset from the service handle
+	uint8_t const attribute = find_attribute(Attr_Handle);
+	if (attribute != BLE_CHAR_INVALID && (attribute & ATTRIBUTE_CCCD_FLAG)) {
+		subscription_changed(session, (BLECharacteristic) (attribute & ~ATTRIBUTE_CCCD_FLAG), Attr_Data,
+				Attr_Data_Length);
 		return;
-	} else {
-		debugPrint("Added pressure characteristic, handle: 0x%04X", pressureCharHandle);
 	}
+	BLECharacteristic const charID = (BLECharacteristic) attribute;
 
-	// @formatter:off
-	status = aci_gatt_add_char(
-			 weatherServiceHandle, // service handle
-			 UUID_TYPE_128, // UUID type
-			 &humidityCharUUID, // UUID
-			 4, // value length (bytes)
-			 CHAR_PROP_READ, // properties
-			 ATTR_PERMISSION_NONE, // permissions
-			 GATT_DONT_NOTIFY_EVENTS, // event mask
-			 16, // enc key size
-			 0, // is available
-			 &humidityCharHandle // handle
-	);
-						// @formatter:on
-	if (status != BLE_STATUS_SUCCESS) {
-		debugPrint("Couldn't add humidity characteristic!");
+	// GATT database contains the value written by client now
+	if (charID != BLE_CHAR_INVALID && Offset == 0) {
+		uint8_t const slot = is_per_session(charID) ? session->index : SHARED_VALUE_SLOT;
+		update_pushed_value(&charValueShadows[slot][charID], Attr_Data, Attr_Data_Length);
+		databaseValueSlots[charID] = slot;
+	}
+
+//	invert_byte_order(Attr_Data, Attr_Data_Length);
+	characteristic_value_changed(session, charID, Attr_Data, Attr_Data_Length);
+}
+
+__weak void characteristic_value_changed(BLESession* session, BLECharacteristic characteristic, uint8_t data[],
+		uint16_t length) {
+	UNUSED(session);
+	UNUSED(characteristic);
+	UNUSED(data);
+	UNUSED(length);
+}
+
+static bool is_same_value(uint8_t const a[], uint16_t a_length, uint8_t const b[], uint16_t b_length) {
+	return a_length == b_length && memcmp(a, b, a_length) == 0;
+}
+
+static void update_pushed_value(CharValueShadow* shadow, uint8_t const data[], uint16_t length) {
+	if (length > CHAR_VALUE_MAX_LENGTH) {
+		shadow->isPushed = false;
 		return;
-	} else {
-		debugPrint("Added humidity characteristic, handle: 0x%04X", humidityCharHandle);
 	}
 
-	// @formatter:off
-	status = aci_gatt_add_char(
-			 weatherServiceHandle, // service handle
-			 UUID_TYPE_128, // UUID type
-			 &controlCharUUID, // UUID
-			 1, // value length (bytes)
-			 CHAR_PROP_READ | CHAR_PROP_WRITE | CHAR_PROP_NOTIFY, // properties
-			 ATTR_PERMISSION_NONE, // permissions
-			 GATT_NOTIFY_ATTRIBUTE_WRITE, // event mask
-			 16, // enc key size
-			 0, // is available
-			 &controlCharHandle // handle
-	);
-						// @formatter:on
-	if (status != BLE_STATUS_SUCCESS) {
-		debugPrint("Couldn't add control characteristic!");
+	memcpy(shadow->pushed, data, length);
+	shadow->pushedLength = length;
+	shadow->isPushed = true;
+}
+
+static void queue_pending_value(uint8_t slot, BLECharacteristic characteristic) {
+	charValueShadows[slot][characteristic].isPending = true;
+	pendingCharValues[pendingCharValuesCount++] = (PendingCharValue ) { .slot = slot, .characteristic = characteristic };
+}
+
+static void store_value(uint8_t slot, BLECharacteristic characteristic, uint8_t const data[], uint16_t length) {
+	CharValueShadow* shadow = &charValueShadows[slot][characteristic];
+	valueCacheStats.requested++;
+
+	if (shadow->isPending) {
+		// Last write wins, update keeps its place in the queue
+		valueCacheStats.coalesced++;
+	} else if (shadow->isPushed && is_same_value(shadow->pushed, shadow->pushedLength, data, length)) {
+		valueCacheStats.skipped++;
+		shadow->isDeferred = false;
 		return;
+	} else if (is_lazy(characteristic) && !is_subscribed(slot, characteristic)) {
+		if (shadow->isDeferred) {
+			valueCacheStats.coalesced++;
+		} else {
+			valueCacheStats.deferred++;
+			shadow->isDeferred = true;
+		}
 	} else {
-		debugPrint("Added control characteristic, handle: 0x%04X", controlCharHandle);
+		queue_pending_value(slot, characteristic);
 	}
 
-	// @formatter:off
-	status = aci_gatt_add_char(
-			 weatherServiceHandle, // service handle
-			 UUID_TYPE_128, // UUID type
-			 &numberOfRecordsCharUUID, // UUID
-			 2, // value length (bytes)
-			 CHAR_PROP_READ | CHAR_PROP_NOTIFY, // properties
-			 ATTR_PERMISSION_NONE, // permissions
-			 GATT_DONT_NOTIFY_EVENTS, // event mask
-			 16, // enc key size
-			 0, // is available
-			 &numberOfRecordsCharHandle // handle
-	);
-						// @formatter:on
-	if (status != BLE_STATUS_SUCCESS) {
-		debugPrint("Couldn't add numberOfRecords characteristic!");
-		return;
+	memcpy(shadow->pending, data, length);
+	shadow->pendingLength = length;
+}
+
+uint8_t set_characteristic_value(BLECharacteristic characteristic, uint8_t data[], uint16_t length) {
+	if (characteristic >= BLE_CHAR_INVALID || length > CHAR_VALUE_MAX_LENGTH) {
+		return 0xFF;
+	}
+
+	if (!is_per_session(characteristic)) {
+		store_value(SHARED_VALUE_SLOT, characteristic, data, length);
+		return BLE_STATUS_SUCCESS;
+	}
+
+	// Same value for every connected client
+	for (uint8_t index = 0; index < BLE_MAX_CONNECTIONS; index++) {
+		if (ble_session_at(index) != NULL) {
+			store_value(index, characteristic, data, length);
+		}
+	}
+	return BLE_STATUS_SUCCESS;
+}
+
+uint8_t set_session_characteristic_value(BLESession const* session, BLECharacteristic characteristic, uint8_t data[],
+		uint16_t length) {
+	if (characteristic >= BLE_CHAR_INVALID || length > CHAR_VALUE_MAX_LENGTH) {
+		return 0xFF;
+	}
+	if (!is_per_session(characteristic)) {
+		return set_characteristic_value(characteristic, data, length);
+	}
+
+	store_value(session->index, characteristic, data, length);
+	return BLE_STATUS_SUCCESS;
+}
+
+static tBleStatus push_pending_value(uint8_t slot, BLECharacteristic characteristic, uint8_t update_type) {
+	CharValueShadow* shadow = &charValueShadows[slot][characteristic];
+	tBleStatus status = BLE_STATUS_SUCCESS;
+
+	if (slot == SHARED_VALUE_SLOT) {
+		status = aci_gatt_update_char_value(weatherServiceHandle, charHandles[characteristic], 0,
+				(uint8_t) shadow->pendingLength, shadow->pending);
 	} else {
-		debugPrint("Added numberOfRecords characteristic, handle: 0x%04X", numberOfRecordsCharHandle);
+		// Only session's own client is notified
+		uint16_t const connectionHandle = ble_session_at(slot)->connectionHandle;
+		status = aci_gatt_update_char_value_ext(connectionHandle, weatherServiceHandle, charHandles[characteristic],
+				update_type, shadow->pendingLength, 0, (uint8_t) shadow->pendingLength, shadow->pending);
+		if (status == BLE_STATUS_SUCCESS) {
+			databaseValueSlots[characteristic] = slot;
+		}
 	}
+	valueCacheStats.sent++;
 
+	if (status == BLE_STATUS_SUCCESS) {
+		update_pushed_value(shadow, shadow->pending, shadow->pendingLength);
+	} else {
+		valueCacheStats.failed++;
+	}
+	return status;
 }
 
-void invert_byte_order(uint8_t data[], size_t length) {
-	uint8_t* startPtr = data;
-	uint8_t* endPtr = data + length - 1;
-	while (startPtr < endPtr) {
-		uint8_t tempValue = *startPtr;
-		*startPtr = *endPtr;
-		*endPtr = tempValue;
-		startPtr++;
-		endPtr--;
+// Sends pending values in the order they were first set. When BlueNRG runs out of
+// TX buffers, the rest stays pending until aci_gatt_tx_pool_available_event.
+void flush_characteristic_values() {
+	uint8_t flushed = 0;
+
+	if (isWaitingForTxPool) {
+		return;
 	}
+
+	for (; flushed < pendingCharValuesCount; flushed++) {
+		PendingCharValue const pending = pendingCharValues[flushed];
+		CharValueShadow* shadow = &charValueShadows[pending.slot][pending.characteristic];
+
+		if (shadow->isPushed && is_same_value(shadow->pushed, shadow->pushedLength, shadow->pending, shadow->pendingLength)) {
+			valueCacheStats.skipped++;
+			shadow->isPending = false;
+			continue;
+		}
+
+		tBleStatus const status = push_pending_value(pending.slot, pending.characteristic, GATT_NOTIFICATION);
+		if (status == BLE_STATUS_INSUFFICIENT_RESOURCES) {
+			isWaitingForTxPool = true;
+			valueCacheStats.txPoolWaits++;
+			break;
+		}
+
+		if (status != BLE_STATUS_SUCCESS) {
+			debugPrint("Couldn't update characteristic #%d value, error 0x%02X", pending.characteristic, status);
+		}
+		shadow->isPending = false;
+	}
+
+	pendingCharValuesCount -= flushed;
+	memmove(pendingCharValues, &pendingCharValues[flushed], pendingCharValuesCount * sizeof(PendingCharValue));
 }
 
-void hci_le_connection_complete_event(uint8_t Status, uint16_t Connection_Handle, uint8_t Role,
-		uint8_t Peer_Address_Type, uint8_t Peer_Address[6], uint16_t Conn_Interval, uint16_t Conn_Latency,
-		uint16_t Supervision_Timeout, uint8_t Master_Clock_Accuracy) {
-	debugPrint(
-			"Device connected! Status: 0x%02X, connection handle: 0x%04X, role: %s, address type: %s, address: %02X:%02X:%02X:%02X:%02X:%02X",
-			Status, Connection_Handle, (Role == 0x00 ? "Master" : "Slave"),
-			(Peer_Address_Type == 0x00 ? "Public" : "Random"), Peer_Address[0], Peer_Address[1], Peer_Address[2],
-			Peer_Address[3], Peer_Address[4], Peer_Address[5]);
+void aci_gatt_tx_pool_available_event(uint16_t Connection_Handle, uint16_t Available_Buffers) {
+	UNUSED(Connection_Handle);
+	UNUSED(Available_Buffers);
+	isWaitingForTxPool = false;
 }
 
-void hci_disconnection_complete_event(uint8_t Status, uint16_t Connection_Handle, uint8_t Reason) {
-	debugPrint("Device 0x%04X disconnected, reason code: 0x%02X, status: 0x%02X", Connection_Handle, Reason, Status);
+// Puts the value the client should read into GATT database
+static void prepare_read(uint8_t slot, BLECharacteristic characteristic) {
+	CharValueShadow* shadow = &charValueShadows[slot][characteristic];
+	bool const isStale = shadow->isDeferred || shadow->isPending;
+	// Database may hold the value of the client that used it before
+	bool const isOtherClientValue = slot != SHARED_VALUE_SLOT && databaseValueSlots[characteristic] != slot;
+
+	if (!isStale && !isOtherClientValue) {
+		return;
+	}
+	if (!isStale) {
+		// Nothing set for this client yet reads as zeros
+		shadow->pendingLength = weatherServiceCharacteristics[characteristic].valueLength;
+		memset(shadow->pending, 0, shadow->pendingLength);
+		if (shadow->isPushed) {
+			memcpy(shadow->pending, shadow->pushed, shadow->pushedLength);
+			shadow->pendingLength = shadow->pushedLength;
+		}
+	}
+
+	// Value has to be in GATT database before the read is allowed, so it can't wait for the flush.
+	// If it was queued too, flush will skip it as unchanged.
+	shadow->isDeferred = false;
+	tBleStatus const status = push_pending_value(slot, characteristic, GATT_LOCAL_UPDATE);
+	if (status != BLE_STATUS_SUCCESS) {
+		debugPrint("Couldn't update lazy characteristic #%d value, error 0x%02X", characteristic, status);
+	}
 }
 
-void aci_gatt_attribute_modified_event(uint16_t Connection_Handle, uint16_t Attr_Handle, uint16_t Offset,
-		uint16_t Attr_Data_Length, uint8_t Attr_Data[]) {
-	debugPrint("Device 0x%04X modified GATT attribute 0x%04X (offset 0x%04X), data length: %d bytes", Connection_Handle,
-			Attr_Handle, Offset, Attr_Data_Length);
+static void prepare_attribute_read(BLESession const* session, uint16_t attribute_handle) {
+	uint8_t const attribute = find_attribute(attribute_handle);
+	if (attribute < BLE_CHAR_INVALID && session != NULL) {
+		valueCacheStats.lazyReads++;
+		prepare_read(is_per_session(attribute) ? session->index : SHARED_VALUE_SLOT, (BLECharacteristic) attribute);
+	}
+}
 
-	uint16_t const char_handle = Attr_Handle - CHAR_VALUE_OFFSET;
-
-//	if (char_handle == testCharHandle) {
-//		uint32_t const char_value = BYTEARRAY_TO_32BIT_VALUE_BE(Attr_Data);
-//		setTestValue(char_value);
-//		debugPrint("Set the char value to %lud (0x%08lX)", testValue(), testValue());
-//	}
-
-	BLECharacteristic charID = BLE_CHAR_INVALID;
-	if (char_handle == timeCharHandle) {
-		charID = BLE_CHAR_TIME;
-	} else if (char_handle == dateCharHandle) {
-		charID = BLE_CHAR_DATE;
-	} else if (char_handle == temperatureCharHandle) {
-		charID = BLE_CHAR_TEMPERATURE;
-	} else if (char_handle == pressureCharHandle) {
-		charID = BLE_CHAR_PRESSURE;
-	} else if (char_handle == humidityCharHandle) {
-		charID = BLE_CHAR_HUMIDITY;
-	} else if (char_handle == controlCharHandle) {
-		charID = BLE_CHAR_CONTROL;
-	} else if (char_handle == numberOfRecordsCharHandle) {
-		charID = BLE_CHAR_NUMBER_OF_RECORDS;
+static void allow_read(uint16_t connection_handle) {
+	tBleStatus const status = aci_gatt_allow_read(connection_handle);
+	if (status != BLE_STATUS_SUCCESS) {
+		debugPrint("Couldn't allow reading for device 0x%04X, error 0x%02X", connection_handle, status);
 	}
+}
 
-//	invert_byte_order(Attr_Data, Attr_Data_Length);
-	characteristic_value_changed(charID, Attr_Data, Attr_Data_Length);
+// Client wants to read a lazy characteristic, BlueNRG waits with the response until aci_gatt_allow_read()
+void aci_gatt_read_permit_req_event(uint16_t Connection_Handle, uint16_t Attribute_Handle, uint16_t Offset) {
+	UNUSED(Offset);
+	prepare_attribute_read(ble_session_find(Connection_Handle), Attribute_Handle);
+	allow_read(Connection_Handle);
 }
 
-void copy_reversed_uuid(uint8_t const* const source, uint8_t* destination) {
-	uint8_t const* source_ptr = source + UUID_LENGTH - 1;
-	for (uint8_t i = 0; i < UUID_LENGTH; i++) {
-		*destination = *source_ptr;
-		destination++;
-		source_ptr--;
+// Read Multiple and Read By Type requests come here instead, one allow covers every handle in them
+void aci_gatt_read_multi_permit_req_event(uint16_t Connection_Handle, uint8_t Number_of_Handles,
+		Handle_Item_t Handle_Item[]) {
+	BLESession const* session = ble_session_find(Connection_Handle);
+	for (uint8_t i = 0; i < Number_of_Handles; i++) {
+		prepare_attribute_read(session, Handle_Item[i].Handle);
 	}
+	allow_read(Connection_Handle);
 }
 
-__weak void characteristic_value_changed(BLECharacteristic characteristic, uint8_t data[], uint16_t length) {
-	UNUSED(characteristic);
-	UNUSED(data);
-	UNUSED(length);
+static void subscription_changed(BLESession* session, BLECharacteristic characteristic, uint8_t const cccd[],
+		uint16_t length) {
+	bool const isSubscribed = length > 0 && (cccd[0] & CCCD_NOTIFY_OR_INDICATE) != 0;
+	if (isSubscribed) {
+		session->subscriptions |= 1u << characteristic;
+	} else {
+		session->subscriptions &= ~(1u << characteristic);
+	}
+	debugPrint("Device 0x%04X %s notifications for characteristic #%d", session->connectionHandle,
+			isSubscribed ? "enabled" : "disabled", characteristic);
+
+	// Client expects notifications from now on, send the value it hasn't seen yet
+	uint8_t const slot = is_per_session(characteristic) ? session->index : SHARED_VALUE_SLOT;
+	CharValueShadow* shadow = &charValueShadows[slot][characteristic];
+	if (isSubscribed && shadow->isDeferred) {
+		shadow->isDeferred = false;
+		queue_pending_value(slot, characteristic);
+	}
 }
 
-uint8_t set_characteristic_value(BLECharacteristic characteristic, uint8_t data[], uint16_t length) {
-	if (characteristic >= BLE_CHAR_INVALID) {
-		return 0xFF;
+void reset_session_values(BLESession const* session) {
+	uint8_t kept = 0;
+	for (uint8_t i = 0; i < pendingCharValuesCount; i++) {
+		if (pendingCharValues[i].slot != session->index) {
+			pendingCharValues[kept++] = pendingCharValues[i];
+		}
 	}
+	pendingCharValuesCount = kept;
+
+	memset(charValueShadows[session->index], 0, sizeof(charValueShadows[session->index]));
+	for (uint8_t id = 0; id < BLE_CHAR_INVALID; id++) {
+		if (databaseValueSlots[id] == session->index) {
+			databaseValueSlots[id] = NO_VALUE_SLOT;
+		}
+	}
+
+	// Link opened or closed, BlueNRG may have TX buffers again
+	isWaitingForTxPool = false;
+}
 
-	uint16_t const charHandle = *(charIDBindTable[(size_t) characteristic]);
-	// BLE byte order is reversed - sike
-//	invert_byte_order(data, length);
-	return aci_gatt_update_char_value(weatherServiceHandle, charHandle, 0, length, data);
+BLEValueCacheStats get_value_cache_stats() {
+	return valueCacheStats;
 }
@@ -10,6 +10,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "ble_app_sessions.h"
 
 typedef enum BLECharacteristic_t {
 	BLE_CHAR_TIME = 0,
@@ -19,12 +20,38 @@ typedef enum BLECharacteristic_t {
 	BLE_CHAR_HUMIDITY,
 	BLE_CHAR_CONTROL,
 	BLE_CHAR_NUMBER_OF_RECORDS,
+	BLE_CHAR_DIAGNOSTICS,
+	BLE_CHAR_LIVE_MEASUREMENT,
+	BLE_CHAR_FILTER_CONFIG,
+	BLE_CHAR_STATION_ALTITUDE,
+	BLE_CHAR_DERIVED_METRICS,
+	BLE_CHAR_PRESSURE_TREND,
 	BLE_CHAR_INVALID
 } BLECharacteristic;
 
+// SPI transactions saved = skipped + coalesced
+typedef struct BLEValueCacheStats_t {
+	uint32_t requested;   // set_characteristic_value() calls
+	uint32_t skipped;     // value was already in GATT database
+	uint32_t coalesced;   // value was overwritten before it was sent
+	uint32_t sent;        // aci_gatt_update_char_value() calls
+	uint32_t failed;      // sent, but rejected by BlueNRG
+	uint32_t deferred;    // lazy value stored until a client reads it
+	uint32_t lazyReads;   // client reads of lazy characteristics
+	uint32_t txPoolWaits; // flush stopped until BlueNRG had free TX buffers
+} BLEValueCacheStats;
+
 void add_app_services();
 
-void characteristic_value_changed(BLECharacteristic characteristic, uint8_t data[], uint16_t length);
+void characteristic_value_changed(BLESession* session, BLECharacteristic characteristic, uint8_t data[],
+		uint16_t length);
+// Sets the value for every client, per-session characteristics get it in every active session
 uint8_t set_characteristic_value(BLECharacteristic characteristic, uint8_t data[], uint16_t length);
+uint8_t set_session_characteristic_value(BLESession const* session, BLECharacteristic characteristic, uint8_t data[],
+		uint16_t length);
+// Forgets values and queued updates of the session, on connection and disconnection
+void reset_session_values(BLESession const* session);
+void flush_characteristic_values();
+BLEValueCacheStats get_value_cache_stats();
 
 #endif /* APP_BLE_APP_SERVICES_H_ */
@@ -0,0 +1,135 @@
+/*
+ * ble_app_sessions.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: steelph0enix
+ */
+
+#include "ble_app_sessions.h"
+#include "ble_app_services.h"
+#include "ble_app_advertising.h"
+#include "bluenrg1_aci.h"
+#include "bluenrg1_events.h"
+#include "print_utils.h"
+#include "main.h"
+
+#include <string.h>
+
+// HCI "Remote Device Terminated Connection due to Low Resources"
+#define DISCONNECT_REASON_LOW_RESOURCES 0x14
+
+static BLESession sessions[BLE_MAX_CONNECTIONS] = { 0 };
+static BLESessionStats sessionStats = { 0 };
+
+static BLESession* open_session(uint16_t connection_handle) {
+	for (uint8_t i = 0; i < BLE_MAX_CONNECTIONS; i++) {
+		if (!sessions[i].isActive) {
+			BLESession* session = &sessions[i];
+			memset(session, 0, sizeof(BLESession));
+			session->isActive = true;
+			session->index = i;
+			session->connectionHandle = connection_handle;
+			session->attMtu = BLE_DEFAULT_ATT_MTU;
+			return session;
+		}
+	}
+	return NULL;
+}
+
+BLESession* ble_session_find(uint16_t connection_handle) {
+	for (uint8_t i = 0; i < BLE_MAX_CONNECTIONS; i++) {
+		if (sessions[i].isActive && sessions[i].connectionHandle == connection_handle) {
+			return &sessions[i];
+		}
+	}
+	return NULL;
+}
+
+BLESession* ble_session_at(uint8_t index) {
+	if (index < BLE_MAX_CONNECTIONS && sessions[index].isActive) {
+		return &sessions[index];
+	}
+	return NULL;
+}
+
+uint8_t ble_sessions_count() {
+	uint8_t count = 0;
+	for (uint8_t i = 0; i < BLE_MAX_CONNECTIONS; i++) {
+		count += sessions[i].isActive;
+	}
+	return count;
+}
+
+bool ble_session_is_subscribed(BLESession const* session, uint8_t characteristic) {
+	return (session->subscriptions & (1u << characteristic)) != 0;
+}
+
+BLESessionStats get_ble_session_stats() {
+	return sessionStats;
+}
+
+void hci_le_connection_complete_event(uint8_t Status, uint16_t Connection_Handle, uint8_t Role,
+		uint8_t Peer_Address_Type, uint8_t Peer_Address[6], uint16_t Conn_Interval, uint16_t Conn_Latency,
+		uint16_t Supervision_Timeout, uint8_t Master_Clock_Accuracy) {
+	debugPrint(
+			"Device connected! Status: 0x%02X, connection handle: 0x%04X, role: %s, address type: %s, address: %02X:%02X:%02X:%02X:%02X:%02X",
+			Status, Connection_Handle, (Role == 0x00 ? "Master" : "Slave"),
+			(Peer_Address_Type == 0x00 ? "Public" : "Random"), Peer_Address[0], Peer_Address[1], Peer_Address[2],
+			Peer_Address[3], Peer_Address[4], Peer_Address[5]);
+
+	if (Status != BLE_STATUS_SUCCESS) {
+		return;
+	}
+
+	// Controller stopped advertising for this connection, it's restarted if there's room for another one
+	ble_advertising_connected();
+
+	BLESession* session = open_session(Connection_Handle);
+	if (session == NULL) {
+		sessionStats.rejected++;
+		debugPrint("No free session for device 0x%04X, disconnecting", Connection_Handle);
+		aci_gap_terminate(Connection_Handle, DISCONNECT_REASON_LOW_RESOURCES);
+		return;
+	}
+
+	uint8_t const count = ble_sessions_count();
+	sessionStats.opened++;
+	if (count > sessionStats.maxConcurrent) {
+		sessionStats.maxConcurrent = count;
+	}
+
+	reset_session_values(session);
+	ble_session_opened(session);
+	debugPrint("Session #%d opened, %d devices connected", session->index, count);
+}
+
+void hci_disconnection_complete_event(uint8_t Status, uint16_t Connection_Handle, uint8_t Reason) {
+	debugPrint("Device 0x%04X disconnected, reason code: 0x%02X, status: 0x%02X", Connection_Handle, Reason, Status);
+
+	// CCCDs of a non-bonded client are reset on disconnection, they're kept in the session
+	BLESession* session = ble_session_find(Connection_Handle);
+	if (session != NULL) {
+		ble_session_closed(session);
+		reset_session_values(session);
+		session->isActive = false;
+		debugPrint("Session #%d closed, %d devices connected", session->index, ble_sessions_count());
+	}
+
+	ble_advertising_disconnected();
+}
+
+void aci_att_exchange_mtu_resp_event(uint16_t Connection_Handle, uint16_t Server_RX_MTU) {
+	BLESession* session = ble_session_find(Connection_Handle);
+	if (session != NULL) {
+		session->attMtu = Server_RX_MTU;
+	}
+	debugPrint("Device 0x%04X negotiated ATT MTU of %d bytes", Connection_Handle, Server_RX_MTU);
+}
+
+__weak void ble_session_opened(BLESession* session) {
+	UNUSED(session);
+}
+
+__weak void ble_session_closed(BLESession* session) {
+	UNUSED(session);
+}
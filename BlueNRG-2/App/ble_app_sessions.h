@@ -0,0 +1,55 @@
+/*
+ * ble_app_sessions.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: steelph0enix
+ */
+
+#ifndef APP_BLE_APP_SESSIONS_H_
+#define APP_BLE_APP_SESSIONS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "rtc_utils.h"
+
+// Simultaneous centrals, BlueNRG-2 stack supports up to 8 links
+#define BLE_MAX_CONNECTIONS 4
+#define BLE_DEFAULT_ATT_MTU 23
+
+// State of a single connected central. Opened on connection, closed on disconnection,
+// so nothing a client did is visible to the clients connected after it.
+typedef struct BLESession_t {
+	bool isActive;
+	uint8_t index;
+	uint16_t connectionHandle;
+	uint16_t attMtu;
+	uint32_t subscriptions; // bit per BLECharacteristic, client enabled notifications or indications
+
+	// Written by this client, used by its control commands
+	RTC_TimeTypeDef time;
+	RTC_DateTypeDef date;
+
+	// Record fetching
+	bool isFetching;
+	uint32_t fetchCursor;   // sequence number of the next record for this client
+} BLESession;
+
+typedef struct BLESessionStats_t {
+	uint32_t opened;
+	uint32_t rejected;      // connected when all sessions were taken
+	uint32_t maxConcurrent;
+} BLESessionStats;
+
+BLESession* ble_session_find(uint16_t connection_handle);
+// Active session in given slot, or NULL
+BLESession* ble_session_at(uint8_t index);
+uint8_t ble_sessions_count();
+
+bool ble_session_is_subscribed(BLESession const* session, uint8_t characteristic);
+BLESessionStats get_ble_session_stats();
+
+// Implemented by the application, called from HCI event handlers
+void ble_session_opened(BLESession* session);
+void ble_session_closed(BLESession* session);
+
+#endif /* APP_BLE_APP_SESSIONS_H_ */
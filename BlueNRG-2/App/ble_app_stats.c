@@ -0,0 +1,122 @@
+/*
+ * ble_app_stats.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: steelph0enix
+ */
+
+#include "ble_app_stats.h"
+#include "ble_app_services.h"
+#include "ble_app_commands.h"
+#include "ble_app_advertising.h"
+#include "ble_app_sessions.h"
+#include "hci_tl.h"
+#include "hci_tl_interface.h"
+#include "print_utils.h"
+#include "bit_helpers.h"
+
+#include <string.h>
+
+// Diagnostics characteristic value, little-endian:
+// [0] pool size, [1] pool high water mark, [2-3] pool exhausted, [4-5] events recycled,
+// [6-7] invalid packets, [8-9] events lost reports, [10-17] lost event types bitmap
+#define DIAGNOSTICS_LENGTH 18
+
+static BLEEventsLostStats eventsLostStats = { 0 };
+static uint8_t lastDiagnostics[DIAGNOSTICS_LENGTH] = { 0 };
+
+void aci_blue_events_lost_event(uint8_t Lost_Events[8]) {
+	eventsLostStats.reports++;
+	for (uint8_t i = 0; i < 8; i++) {
+		eventsLostStats.eventMask |= ((uint64_t) Lost_Events[i]) << (i * 8u);
+	}
+
+	debugPrint("BlueNRG lost events! Lost event types: %02X%02X%02X%02X%02X%02X%02X%02X", Lost_Events[7],
+			Lost_Events[6], Lost_Events[5], Lost_Events[4], Lost_Events[3], Lost_Events[2], Lost_Events[1],
+			Lost_Events[0]);
+}
+
+BLEEventsLostStats get_events_lost_stats() {
+	return eventsLostStats;
+}
+
+void ble_print_stats() {
+	tHciPoolStats pool = { 0 };
+	tHciSpiStats spi = { 0 };
+	hci_get_pool_stats(&pool);
+	HCI_TL_SPI_GetStats(&spi);
+	BLEValueCacheStats const cache = get_value_cache_stats();
+	BLECommandStats const commands = get_ble_command_stats();
+	uint32_t const averageLatency = commands.executed > 0 ? (uint32_t) (commands.totalLatencyUs / commands.executed) : 0;
+	uint32_t const averageEventPath =
+			commands.eventPathCalls > 0 ? (uint32_t) (commands.eventPathTotalUs / commands.eventPathCalls) : 0;
+	BLEAdvertisingStats const advertising = get_ble_advertising_stats();
+	uint32_t const averageDowntime =
+			advertising.reconfigurations > 0 ? (uint32_t) (advertising.totalDowntimeUs / advertising.reconfigurations) : 0;
+	BLESessionStats const sessions = get_ble_session_stats();
+
+	// @formatter:off
+	printf("HCI pool: %lu/%lu packets in use, high water mark %lu, exhausted %lu times, %lu events recycled, %lu invalid packets\n",
+			pool.in_use, pool.pool_size, pool.high_water_mark, pool.exhausted, pool.recycled, pool.invalid);
+	printf("BlueNRG lost events: %lu reports, event types 0x%08lX%08lX\n",
+			eventsLostStats.reports, (uint32_t) (eventsLostStats.eventMask >> 32), (uint32_t) eventsLostStats.eventMask);
+	printf("SPI writes: %lu, %lu waited for BlueNRG, %lu retries, %lu timeouts, %lu us spent waiting\n",
+			spi.writes, spi.ready_waits, spi.retries, spi.timeouts, spi.wait_time_us);
+	printf("Char value cache: %lu requested, %lu sent, %lu unchanged, %lu coalesced, %lu failed, %lu deferred, %lu lazy reads, %lu TX pool waits\n",
+			cache.requested, cache.sent, cache.skipped, cache.coalesced, cache.failed, cache.deferred, cache.lazyReads,
+			cache.txPoolWaits);
+	printf("Control commands: %lu executed, %lu dropped, max queue depth %lu, latency %lu us avg, %lu us max\n",
+			commands.executed, commands.dropped, commands.maxDepth, averageLatency, commands.maxLatencyUs);
+	printf("Event processing: %lu calls, %lu us avg, %lu us max\n",
+			commands.eventPathCalls, averageEventPath, commands.eventPathMaxUs);
+	printf("Advertising: %lu reconfigurations, downtime %lu us avg, %lu us max, %lu failures, triggers: %lu boot, %lu disconnection, %lu measurement, %lu button\n",
+			advertising.reconfigurations, averageDowntime, advertising.maxDowntimeUs, advertising.failures,
+			advertising.triggers[BLE_ADV_TRIGGER_BOOT], advertising.triggers[BLE_ADV_TRIGGER_DISCONNECTION],
+			advertising.triggers[BLE_ADV_TRIGGER_MEASUREMENT], advertising.triggers[BLE_ADV_TRIGGER_BUTTON]);
+	for (uint8_t phase = 0; phase < BLE_ADV_PHASES; phase++) {
+		BLEAdvertisingPhaseStats const* stats = &advertising.phases[phase];
+		uint32_t const averageConnectLatency = stats->connections > 0 ? stats->totalConnectLatencyMs / stats->connections : 0;
+		printf("Advertising %s: entered %lu times, %lu ms advertising, %lu connections, connect latency %lu ms avg, %lu ms max\n",
+				ble_advertising_phase_name(phase), stats->entered, stats->advertisingMs, stats->connections,
+				averageConnectLatency, stats->maxConnectLatencyMs);
+	}
+	printf("Sessions: %u active, %lu opened, %lu rejected, %lu max concurrent\n",
+			ble_sessions_count(), sessions.opened, sessions.rejected, sessions.maxConcurrent);
+	for (uint8_t index = 0; index < BLE_MAX_CONNECTIONS; index++) {
+		BLESession const* session = ble_session_at(index);
+		if (session != NULL) {
+			printf("Session #%u: connection 0x%04X, ATT MTU %u, subscriptions 0x%08lX, %s\n",
+					index, session->connectionHandle, session->attMtu, session->subscriptions,
+					session->isFetching ? "fetching" : "idle");
+		}
+	}
+	// @formatter:on
+}
+
+static uint16_t saturate_16bit(uint32_t value) {
+	return value > UINT16_MAX ? UINT16_MAX : (uint16_t) value;
+}
+
+void ble_update_diagnostics() {
+	tHciPoolStats pool = { 0 };
+	hci_get_pool_stats(&pool);
+
+	uint8_t diagnostics[DIAGNOSTICS_LENGTH] = { 0 };
+	uint16_t const counters[] = { saturate_16bit(pool.exhausted), saturate_16bit(pool.recycled), saturate_16bit(
+			pool.invalid), saturate_16bit(eventsLostStats.reports) };
+
+	diagnostics[0] = (uint8_t) pool.pool_size;
+	diagnostics[1] = (uint8_t) pool.high_water_mark;
+	for (uint8_t i = 0; i < 4; i++) {
+		uint8_t* counter = &diagnostics[2 + i * 2];
+		VALUE_TO_16BIT_BYTEARRAY_LE(counters[i], counter);
+	}
+	for (uint8_t i = 0; i < 8; i++) {
+		diagnostics[10 + i] = (uint8_t) (eventsLostStats.eventMask >> (i * 8u));
+	}
+
+	if (memcmp(diagnostics, lastDiagnostics, DIAGNOSTICS_LENGTH) != 0) {
+		memcpy(lastDiagnostics, diagnostics, DIAGNOSTICS_LENGTH);
+		set_characteristic_value(BLE_CHAR_DIAGNOSTICS, diagnostics, DIAGNOSTICS_LENGTH);
+	}
+}
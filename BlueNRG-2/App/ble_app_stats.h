@@ -0,0 +1,26 @@
+/*
+ * ble_app_stats.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: steelph0enix
+ */
+
+#ifndef APP_BLE_APP_STATS_H_
+#define APP_BLE_APP_STATS_H_
+
+#include <stdint.h>
+
+typedef struct BLEEventsLostStats_t {
+	uint32_t reports;   // aci_blue_events_lost_event count
+	uint64_t eventMask; // every event type that has been lost at least once
+} BLEEventsLostStats;
+
+BLEEventsLostStats get_events_lost_stats();
+
+// Prints HCI pool, SPI and characteristic value cache statistics over debug UART
+void ble_print_stats();
+
+// Refreshes diagnostics characteristic, if any of the counters has changed
+void ble_update_diagnostics();
+
+#endif /* APP_BLE_APP_STATS_H_ */
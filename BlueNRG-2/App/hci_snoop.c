@@ -0,0 +1,131 @@
+/*
+ * hci_snoop.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: steelph0enix
+ */
+
+#include "hci_snoop.h"
+#include "usart.h"
+#include "print_utils.h"
+#include "bit_helpers.h"
+
+#include <string.h>
+#include <stdatomic.h>
+
+// HCI packets are captured into RAM with DWT cycle counter timestamp, and then
+// dumped on demand over LPUART as btsnoop file (H4 datalink). Save the raw UART output
+// to a file and open it in Wireshark. Debug prints share the LPUART, so the capture has
+// to be cut at the "btsnoop\0" magic - everything before it is debug text. Nothing is
+// printed after the last record, the file ends with it.
+
+#define BTSNOOP_VERSION 1u
+#define BTSNOOP_DATALINK_H4 1002u
+#define BTSNOOP_FLAG_RECEIVED 0x01u
+#define BTSNOOP_FLAG_COMMAND_OR_EVENT 0x02u
+// Microseconds between 0 AD and 1970-01-01, timestamps are relative to boot
+#define BTSNOOP_EPOCH_DELTA_US 0x00DCDDB30F2F8000ull
+
+// CYCCNT overflows every ~25s @ 170MHz, for longer gaps between packets the tick is used
+#define MAX_CYCLES_DELTA_MS 10000u
+
+typedef struct HCISnoopRecord_t {
+	uint32_t cycles;
+	uint32_t tick;
+	uint16_t length;
+	uint8_t flags;
+	uint8_t data[HCI_SNOOP_SNAPLEN];
+} HCISnoopRecord;
+
+static HCISnoopRecord records[HCI_SNOOP_RECORDS];
+static atomic_uint recordsCaptured = 0;
+static atomic_bool isCapturing = false;
+
+void hci_snoop_init() {
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+	atomic_store(&recordsCaptured, 0);
+	atomic_store(&isCapturing, true);
+}
+
+// Called from both the task (commands) and EXTI ISR (events), slot is reserved atomically.
+// Timestamp is taken after the reservation, so it follows the order of the slots, unless
+// the ISR comes in between - then the dump clamps the difference.
+void hci_snoop_capture(uint8_t const* packet, uint16_t length, bool received) {
+	if (!atomic_load_explicit(&isCapturing, memory_order_relaxed)) {
+		return;
+	}
+
+	uint32_t const slot = atomic_fetch_add_explicit(&recordsCaptured, 1, memory_order_relaxed);
+	HCISnoopRecord* record = &records[slot % HCI_SNOOP_RECORDS];
+
+	record->cycles = DWT->CYCCNT;
+	record->tick = HAL_GetTick();
+	record->length = length;
+	record->flags = BTSNOOP_FLAG_COMMAND_OR_EVENT | (received ? BTSNOOP_FLAG_RECEIVED : 0);
+	memcpy(record->data, packet, length < HCI_SNOOP_SNAPLEN ? length : HCI_SNOOP_SNAPLEN);
+}
+
+static void transmit(uint8_t const* data, uint16_t length) {
+	HAL_UART_Transmit(&hlpuart1, (uint8_t*) data, length, HAL_MAX_DELAY);
+}
+
+static void transmit_u32_be(uint32_t value) {
+	uint8_t bytes[4];
+	VALUE_TO_32BIT_BYTEARRAY_BE(value, bytes);
+	transmit(bytes, 4);
+}
+
+// Record that was captured by the ISR while the task was reserving the previous slot
+// can be a few cycles older than it, it gets the same timestamp instead of a wrapped one
+static uint64_t record_delta_us(HCISnoopRecord const* previous, HCISnoopRecord const* current) {
+	int32_t const deltaMs = (int32_t) (current->tick - previous->tick);
+	if (deltaMs >= (int32_t) MAX_CYCLES_DELTA_MS) {
+		return (uint64_t) deltaMs * 1000u;
+	}
+	int32_t const deltaCycles = (int32_t) (current->cycles - previous->cycles);
+	if (deltaMs < 0 || deltaCycles < 0) {
+		return 0;
+	}
+	return (uint32_t) deltaCycles / (SystemCoreClock / 1000000u);
+}
+
+void hci_snoop_dump() {
+	atomic_store(&isCapturing, false);
+
+	uint32_t const captured = atomic_load(&recordsCaptured);
+	uint32_t const dropped = captured > HCI_SNOOP_RECORDS ? captured - HCI_SNOOP_RECORDS : 0;
+	debugPrint("Dumping HCI log, %lu packets captured, %lu overwritten", captured, dropped);
+
+	uint8_t const magic[8] = { 'b', 't', 's', 'n', 'o', 'o', 'p', '\0' };
+	transmit(magic, sizeof(magic));
+	transmit_u32_be(BTSNOOP_VERSION);
+	transmit_u32_be(BTSNOOP_DATALINK_H4);
+
+	HCISnoopRecord const* previous = NULL;
+	uint64_t timestamp = 0;
+	for (uint32_t i = dropped; i < captured; i++) {
+		HCISnoopRecord const* record = &records[i % HCI_SNOOP_RECORDS];
+		uint16_t const includedLength = record->length < HCI_SNOOP_SNAPLEN ? record->length : HCI_SNOOP_SNAPLEN;
+
+		if (previous == NULL) {
+			timestamp = BTSNOOP_EPOCH_DELTA_US + (uint64_t) record->tick * 1000u;
+		} else {
+			timestamp += record_delta_us(previous, record);
+		}
+		previous = record;
+
+		transmit_u32_be(record->length);
+		transmit_u32_be(includedLength);
+		transmit_u32_be(record->flags);
+		transmit_u32_be(dropped);
+		transmit_u32_be((uint32_t) (timestamp >> 32));
+		transmit_u32_be((uint32_t) timestamp);
+		transmit(record->data, includedLength);
+	}
+
+	atomic_store(&recordsCaptured, 0);
+	atomic_store(&isCapturing, true);
+}
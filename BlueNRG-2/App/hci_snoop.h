@@ -0,0 +1,29 @@
+/*
+ * hci_snoop.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: steelph0enix
+ */
+
+#ifndef APP_HCI_SNOOP_H_
+#define APP_HCI_SNOOP_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Number of packets kept in RAM. Oldest packets are overwritten when it's full.
+#ifndef HCI_SNOOP_RECORDS
+#define HCI_SNOOP_RECORDS 64
+#endif
+
+// Maximum number of bytes stored per packet, longer packets are truncated
+// (btsnoop keeps the original length, so Wireshark shows them as such).
+#ifndef HCI_SNOOP_SNAPLEN
+#define HCI_SNOOP_SNAPLEN 64
+#endif
+
+void hci_snoop_init();
+void hci_snoop_capture(uint8_t const* packet, uint16_t length, bool received);
+void hci_snoop_dump();
+
+#endif /* APP_HCI_SNOOP_H_ */
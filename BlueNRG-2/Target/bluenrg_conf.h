@@ -40,7 +40,16 @@ extern "C" {
 /*---------- Number of Bytes reserved for HCI Max Payload -----------*/
 #define HCI_MAX_PAYLOAD_SIZE      128
 /*---------- Number of incoming packets added to the list of packets to read -----------*/
-#define HCI_READ_PACKET_NUM_MAX      10
+/* Define HCI_POOL_OBSERVED_PEAK as the high water mark reported by the HCI pool statistics
+   under the heaviest expected load, to size the pool from it with HCI_POOL_HEADROOM spare packets */
+#ifdef HCI_POOL_OBSERVED_PEAK
+  #ifndef HCI_POOL_HEADROOM
+    #define HCI_POOL_HEADROOM         2
+  #endif
+  #define HCI_READ_PACKET_NUM_MAX      (HCI_POOL_OBSERVED_PEAK + HCI_POOL_HEADROOM)
+#else
+  #define HCI_READ_PACKET_NUM_MAX      10
+#endif
 /*---------- Scan Interval: time interval from when the Controller started its last scan until it begins the subsequent scan (for a number N, Time = N x 0.625 msec) -----------*/
 #define SCAN_P      16384
 /*---------- Scan Window: amount of time for the duration of the LE scan (for a number N, Time = N x 0.625 msec) -----------*/
@@ -61,6 +70,12 @@ extern "C" {
 #define ADV_INTERV_MIN      2048
 /*---------- Maximum Advertising Interval (for a number N, Time = N x 0.625 msec) -----------*/
 #define ADV_INTERV_MAX      4096
+/*---------- Advertising interval after boot, disconnection, new measurement or user button, before backing off to ADV_INTERV_MIN/MAX (for a number N, Time = N x 0.625 msec) -----------*/
+#define ADV_FAST_INTERV_MIN      32
+#define ADV_FAST_INTERV_MAX      48
+/*---------- Advertising interval when fast advertising window ends, before backing off to ADV_INTERV_MIN/MAX (for a number N, Time = N x 0.625 msec) -----------*/
+#define ADV_MEDIUM_INTERV_MIN      244
+#define ADV_MEDIUM_INTERV_MAX      338
 /*---------- Minimum Connection Event Interval (for a number N, Time = N x 1.25 msec) -----------*/
 #define L2CAP_INTERV_MIN      9
 /*---------- Maximum Connection Event Interval (for a number N, Time = N x 1.25 msec) -----------*/
@@ -69,6 +84,14 @@ extern "C" {
 #define L2CAP_TIMEOUT_MULTIPLIER      600
 /*---------- HCI Default Timeout -----------*/
 #define HCI_DEFAULT_TIMEOUT_MS        1000
+/*---------- Capture HCI packets in RAM, to be dumped in btsnoop format over LPUART -----------*/
+#ifndef HCI_LOG_ON
+#ifdef DEBUG
+  #define HCI_LOG_ON                  1
+#else
+  #define HCI_LOG_ON                  0
+#endif
+#endif
 
 #define BLUENRG_memcpy                memcpy
 #define BLUENRG_memset                memset
@@ -21,6 +21,10 @@
 #include "RTE_Components.h"
 
 #include "hci_tl.h"
+#include "cmsis_os.h"
+#include "thread_flags.h"
+
+#include <string.h>
 
 /* Defines -------------------------------------------------------------------*/
 
@@ -29,13 +33,25 @@
 #define TIMEOUT_DURATION  15U
 #define TIMEOUT_IRQ_HIGH  1000U
 
+/* Thread flag set from the EXTI edge when BlueNRG-2 is ready for a write */
+#define WRITE_READY_FLAG          THREAD_FLAG_HCI_WRITE_READY
+/* Delay between write attempts when BlueNRG-2 write buffer is full, doubled up to the max */
+#define WRITE_BACKOFF_MAX_MS      4U
+
 /* Private variables ---------------------------------------------------------*/
 EXTI_HandleTypeDef hexti0;
 
+static volatile uint8_t is_writing = 0;
+static osThreadId_t volatile write_waiter = NULL;
+static tHciSpiStats spi_stats;
+
 /* Private function prototypes -----------------------------------------------*/
 static void HCI_TL_SPI_Enable_IRQ(void);
 static void HCI_TL_SPI_Disable_IRQ(void);
 static int32_t IsDataAvailable(void);
+static int32_t WaitUntilReady(uint32_t tickstart);
+static void WriteBackoff(uint32_t* backoff_ms);
+static uint32_t ElapsedUs(uint32_t cycles_start);
 
 /******************** IO Operation and BUS services ***************************/
 /**
@@ -93,6 +109,10 @@ int32_t HCI_TL_SPI_Init(void* pConf)
   /* Deselect CS PIN for BlueNRG at startup to avoid spurious commands */
   HAL_GPIO_WritePin(HCI_TL_SPI_CS_PORT, HCI_TL_SPI_CS_PIN, GPIO_PIN_SET);
 
+  /* Cycle counter is used for the wait time statistics */
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
   return BSP_SPI1_Init();
 }
 
@@ -123,9 +143,9 @@ int32_t HCI_TL_SPI_Reset(void)
   HAL_GPIO_WritePin(HCI_TL_SPI_CS_PORT, HCI_TL_SPI_CS_PIN, GPIO_PIN_SET);
 
   HAL_GPIO_WritePin(HCI_TL_RST_PORT, HCI_TL_RST_PIN, GPIO_PIN_RESET);
-  HAL_Delay(5);
+  HAL_Delay(1);
   HAL_GPIO_WritePin(HCI_TL_RST_PORT, HCI_TL_RST_PIN, GPIO_PIN_SET);
-  HAL_Delay(5);
+  // No need to wait here, BlueNRG-2 sends aci_blue_initialized_event when it's ready
   return 0;
 }
 
@@ -194,6 +214,9 @@ int32_t HCI_TL_SPI_Receive(uint8_t* buffer, uint16_t size)
 
 /**
  * @brief  Writes data from local buffer to SPI.
+ *         The EXTI line stays enabled during the write. Its rising edge wakes
+ *         up the calling task instead of reading events, so waiting for the
+ *         BlueNRG-2 doesn't burn CPU time.
  *
  * @param  buffer : data buffer to be written
  * @param  size   : size of first data buffer to be written
@@ -203,6 +226,7 @@ int32_t HCI_TL_SPI_Send(uint8_t* buffer, uint16_t size)
 {
   int32_t result;
   uint16_t rx_bytes;
+  uint32_t backoff_ms = 0;
 
   uint8_t header_master[HEADER_SIZE] = {0x0a, 0x00, 0x00, 0x00, 0x00};
   uint8_t header_slave[HEADER_SIZE];
@@ -210,12 +234,16 @@ int32_t HCI_TL_SPI_Send(uint8_t* buffer, uint16_t size)
   static uint8_t read_char_buf[MAX_BUFFER_SIZE];
   uint32_t tickstart = HAL_GetTick();
 
-  HCI_TL_SPI_Disable_IRQ();
+  if (osKernelGetState() == osKernelRunning)
+  {
+    osThreadFlagsClear(WRITE_READY_FLAG);
+    write_waiter = osThreadGetId();
+  }
+  is_writing = 1;
+  spi_stats.writes++;
 
   do
   {
-    uint32_t tickstart_data_available = HAL_GetTick();
-
     result = 0;
 
     /* CS reset */
@@ -225,18 +253,11 @@ int32_t HCI_TL_SPI_Send(uint8_t* buffer, uint16_t size)
      * Wait until BlueNRG-2 is ready.
      * When ready it will raise the IRQ pin.
      */
-    while(!IsDataAvailable())
-    {
-      if((HAL_GetTick() - tickstart_data_available) > TIMEOUT_DURATION)
-      {
-        result = -3;
-        break;
-      }
-    }
-    if(result == -3)
+    if (!WaitUntilReady(HAL_GetTick()))
     {
-      /* The break causes the exiting from the "while", so the CS line must be released */
+      /* CS line must be released before giving up */
       HAL_GPIO_WritePin(HCI_TL_SPI_CS_PORT, HCI_TL_SPI_CS_PIN, GPIO_PIN_SET);
+      result = -3;
       break;
     }
 
@@ -264,8 +285,19 @@ int32_t HCI_TL_SPI_Send(uint8_t* buffer, uint16_t size)
       result = -3;
       break;
     }
+
+    if (result == -2)
+    {
+      spi_stats.retries++;
+      WriteBackoff(&backoff_ms);
+    }
   } while(result < 0);
 
+  if (result == -3)
+  {
+    spi_stats.timeouts++;
+  }
+
   /**
    * To be aligned to the SPI protocol.
    * Can bring to a delay inside the frame, due to the BlueNRG-2 that needs
@@ -277,11 +309,135 @@ int32_t HCI_TL_SPI_Send(uint8_t* buffer, uint16_t size)
       break;
     }
   }
-  HCI_TL_SPI_Enable_IRQ();
+
+  is_writing = 0;
+  /* WaitUntilReady() returns as soon as the pin is high, the edge may still set the flag,
+   * it must not be left for the next wait of the task */
+  if (write_waiter != NULL)
+  {
+    write_waiter = NULL;
+    osThreadFlagsClear(WRITE_READY_FLAG);
+  }
+
+  /* Edges seen during the write were consumed by the handshake, so if BlueNRG-2
+   * has an event ready now, the ISR has to be triggered by software */
+  if (IsDataAvailable())
+  {
+    HAL_EXTI_GenerateSWI(&hexti0);
+  }
 
   return result;
 }
 
+/**
+ * @brief  Get the SPI write statistics.
+ *
+ * @param  stats : Destination of the statistics
+ * @retval None
+ */
+void HCI_TL_SPI_GetStats(tHciSpiStats* stats)
+{
+  *stats = spi_stats;
+}
+
+/**
+ * @brief  Clear the SPI write statistics.
+ *
+ * @param  None
+ * @retval None
+ */
+void HCI_TL_SPI_ResetStats(void)
+{
+  memset(&spi_stats, 0, sizeof(spi_stats));
+}
+
+/**
+ * @brief  Waits until BlueNRG-2 raises the IRQ pin after CS was asserted.
+ *         The calling task sleeps until the EXTI edge sets its thread flag.
+ *         Before the scheduler is started the pin is polled.
+ *
+ * @param  tickstart : Tick at which the wait has started
+ * @retval int32_t: 1 if BlueNRG-2 is ready, 0 on timeout
+ */
+static int32_t WaitUntilReady(uint32_t tickstart)
+{
+  uint32_t cycles_start;
+  uint32_t elapsed;
+  int32_t ready = 1;
+
+  if (IsDataAvailable())
+  {
+    return 1;
+  }
+
+  spi_stats.ready_waits++;
+  cycles_start = DWT->CYCCNT;
+
+  while (!IsDataAvailable())
+  {
+    elapsed = HAL_GetTick() - tickstart;
+    if (elapsed > TIMEOUT_DURATION)
+    {
+      ready = 0;
+      break;
+    }
+
+    if (write_waiter != NULL)
+    {
+      osThreadFlagsWait(WRITE_READY_FLAG, osFlagsWaitAny, TIMEOUT_DURATION - elapsed + 1U);
+    }
+  }
+
+  spi_stats.wait_time_us += ElapsedUs(cycles_start);
+  return ready;
+}
+
+/**
+ * @brief  Waits before the next write attempt when BlueNRG-2 write buffer is full.
+ *         First retry is immediate, next ones sleep 1, 2, ... up to WRITE_BACKOFF_MAX_MS.
+ *
+ * @param  backoff_ms : Current backoff, updated for the next attempt
+ * @retval None
+ */
+static void WriteBackoff(uint32_t* backoff_ms)
+{
+  uint32_t cycles_start;
+
+  if (*backoff_ms > 0U)
+  {
+    cycles_start = DWT->CYCCNT;
+    if (write_waiter != NULL)
+    {
+      osDelay(*backoff_ms);
+    }
+    else
+    {
+      HAL_Delay(*backoff_ms);
+    }
+    spi_stats.wait_time_us += ElapsedUs(cycles_start);
+  }
+
+  if (*backoff_ms == 0U)
+  {
+    *backoff_ms = 1U;
+  }
+  else if (*backoff_ms < WRITE_BACKOFF_MAX_MS)
+  {
+    *backoff_ms *= 2U;
+  }
+}
+
+/**
+ * @brief  Converts cycles elapsed since cycles_start to microseconds.
+ *
+ * @param  cycles_start : DWT cycle counter value at the start
+ * @retval uint32_t: Elapsed time in microseconds
+ */
+static uint32_t ElapsedUs(uint32_t cycles_start)
+{
+  return (DWT->CYCCNT - cycles_start) / (SystemCoreClock / 1000000U);
+}
+
 /**
  * @brief  Reports if the BlueNRG has data for the host micro.
  *
@@ -324,7 +480,8 @@ void hci_tl_lowlevel_init(void)
   /* Register event irq handler */
   HAL_EXTI_GetHandle(&hexti0, EXTI_LINE_0);
   HAL_EXTI_RegisterCallback(&hexti0, HAL_EXTI_COMMON_CB_ID, hci_tl_lowlevel_isr);
-  HAL_NVIC_SetPriority(EXTI0_IRQn, 0, 0);
+  /* The ISR wakes up the writing task, so it must be allowed to call RTOS API */
+  HAL_NVIC_SetPriority(EXTI0_IRQn, configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY, 0);
   HAL_NVIC_EnableIRQ(EXTI0_IRQn);
 
   /* USER CODE BEGIN hci_tl_lowlevel_init 3 */
@@ -341,6 +498,17 @@ void hci_tl_lowlevel_init(void)
   */
 void hci_tl_lowlevel_isr(void)
 {
+  /* During a write the edge means that BlueNRG-2 is ready to receive,
+   * SPI is owned by HCI_TL_SPI_Send() and events are read after it ends */
+  if (is_writing)
+  {
+    if (write_waiter != NULL)
+    {
+      osThreadFlagsSet(write_waiter, WRITE_READY_FLAG);
+    }
+    return;
+  }
+
   /* Call hci_notify_asynch_evt() */
   while(IsDataAvailable())
   {
@@ -42,6 +42,16 @@
 #define HCI_TL_RST_PORT       GPIOA
 #define HCI_TL_RST_PIN        GPIO_PIN_8
 
+/* Exported types ------------------------------------------------------------*/
+typedef struct
+{
+  uint32_t writes;        /**< Number of HCI_TL_SPI_Send() calls */
+  uint32_t ready_waits;   /**< Writes where BlueNRG-2 wasn't ready right after CS assertion */
+  uint32_t retries;       /**< Write attempts repeated because BlueNRG-2 write buffer was full */
+  uint32_t timeouts;      /**< Writes dropped after TIMEOUT_DURATION */
+  uint32_t wait_time_us;  /**< Time spent waiting for BlueNRG-2 readiness and in backoff */
+} tHciSpiStats;
+
 /* Exported variables --------------------------------------------------------*/
 extern EXTI_HandleTypeDef     hexti0;
 #define H_EXTI_0 hexti0
@@ -52,6 +62,8 @@ int32_t HCI_TL_SPI_DeInit  (void);
 int32_t HCI_TL_SPI_Receive (uint8_t* buffer, uint16_t size);
 int32_t HCI_TL_SPI_Send    (uint8_t* buffer, uint16_t size);
 int32_t HCI_TL_SPI_Reset   (void);
+void    HCI_TL_SPI_GetStats   (tHciSpiStats* stats);
+void    HCI_TL_SPI_ResetStats (void);
 
 /**
  * @brief  Register hci_tl_interface IO bus services
@@ -23,5 +23,7 @@ AppState get_app_state();
 
 void app_set_measurement_interval(uint8_t hours, uint8_t minutes, uint8_t seconds);
 void app_rtc_alarm_handler();
+// Filter sampling between the measurements, called from the main loop
+void app_process();
 
 #endif /* INC_APP_STATES_H_ */
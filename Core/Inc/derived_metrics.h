@@ -0,0 +1,38 @@
+/*
+ * derived_metrics.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: steelph0enix
+ */
+
+#ifndef INC_DERIVED_METRICS_H_
+#define INC_DERIVED_METRICS_H_
+
+#include <stdint.h>
+
+// Input of a failed channel, and a metric calculated from one
+#define DERIVED_METRIC_UNKNOWN INT32_MIN
+
+// Values calculated from a measurement, so every client gets the same ones
+typedef struct DerivedMetrics_t {
+	int32_t dewPoint;         // 0.01 *C
+	int32_t absoluteHumidity; // 0.01 g/m3
+	int32_t heatIndex;        // 0.01 *C
+	int32_t seaLevelPressure; // 0.01 hPa
+} DerivedMetrics;
+
+// Inputs are in centi-units like the measurements (0.01 *C, 0.01 %, 0.01 hPa) and altitude is in meters.
+// Fixed-point only, logarithms and exponents come from lookup tables, there are no libm calls.
+int32_t dew_point_centi_celsius(int32_t temperature, int32_t humidity);
+int32_t absolute_humidity_centi_gpm3(int32_t temperature, int32_t humidity);
+// NWS heat index (Rothfusz regression with its adjustments), simple formula for mild conditions
+int32_t heat_index_centi_celsius(int32_t temperature, int32_t humidity);
+// Station pressure reduced to sea level with the hypsometric equation, standard lapse rate for the air column
+int32_t sea_level_pressure_centi_hpa(int32_t pressure, int32_t temperature, int16_t altitude);
+
+// Metrics need temperature and humidity, sea-level pressure needs pressure and temperature.
+// Those with an unknown input are DERIVED_METRIC_UNKNOWN.
+void derive_metrics(int32_t temperature, int32_t pressure, int32_t humidity, int16_t altitude,
+		DerivedMetrics* metrics);
+
+#endif /* INC_DERIVED_METRICS_H_ */
@@ -0,0 +1,47 @@
+/*
+ * i2c_bus.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: steelph0enix
+ */
+
+#ifndef INC_I2C_BUS_H_
+#define INC_I2C_BUS_H_
+
+#include <stdint.h>
+
+#define I2C_BUS_QUEUE_LENGTH 8
+// Transfer timeout is the time it takes on the bus plus this margin, for clock stretching and the
+// scheduling of the bus task. I2C1 runs at 100 kHz (Timing 0x30A0A7FB), a byte with its ACK takes 90 us,
+// so a FIFO drain of 160 bytes is about 15 ms on the bus alone.
+#define I2C_BUS_TIMEOUT_MARGIN_MS 20u
+#define I2C_BUS_BYTE_US 90u
+
+typedef struct I2CBusStats_t {
+	uint32_t transfers;
+	uint32_t bytes;
+	uint32_t ackFailures;      // device didn't respond
+	uint32_t errors;           // other bus errors
+	uint32_t timeouts;         // transfer didn't finish in its timeout, peripheral was reinitialized
+	uint32_t recoveryFailures; // peripheral couldn't be reinitialized after a timeout
+	uint32_t polledTransfers;  // made before the bus task was started
+	uint32_t maxDepth;
+	uint64_t transferUs;       // start of the transfer to its completion interrupt
+	uint32_t maxTransferUs;
+	uint64_t waitUs;           // time spent in the queue
+	uint32_t maxWaitUs;
+} I2CBusStats;
+
+// Creates the request queue and the task that owns I2C1, must be called before the scheduler starts
+void i2c_bus_init();
+
+// Blocking adapters with the signature of *_IO_t ReadReg/WriteReg. Transfers from all tasks are
+// queued and done one by one with interrupts, the calling task sleeps until its transfer is done.
+// Return BSP_ERROR_* codes, like BSP_I2C1_ReadReg()/BSP_I2C1_WriteReg().
+int32_t i2c_bus_read_reg(uint16_t address, uint16_t reg, uint8_t* data, uint16_t length);
+int32_t i2c_bus_write_reg(uint16_t address, uint16_t reg, uint8_t* data, uint16_t length);
+
+I2CBusStats get_i2c_bus_stats();
+void i2c_bus_print_stats();
+
+#endif /* INC_I2C_BUS_H_ */
@@ -0,0 +1,38 @@
+/*
+ * mems_conversion.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: steelph0enix
+ */
+
+#ifndef INC_MEMS_CONVERSION_H_
+#define INC_MEMS_CONVERSION_H_
+
+#include <stdint.h>
+
+// HTS221 factory calibration, two points of the humidity and temperature transfer lines
+typedef struct HTS221Calibration_t {
+	uint8_t h0RhX2;    // H0_rH_x2, % x 2
+	uint8_t h1RhX2;    // H1_rH_x2
+	int16_t h0T0Out;   // ADC output at H0
+	int16_t h1T0Out;   // ADC output at H1
+	uint16_t t0DegCX8; // T0_degC_x8 with its 2 MSBs from T1/T0 msb, *C x 8
+	uint16_t t1DegCX8; // T1_degC_x8
+	int16_t t0Out;     // ADC output at T0
+	int16_t t1Out;     // ADC output at T1
+} HTS221Calibration;
+
+// Raw register values to centi-units (0.01 *C, 0.01 hPa, 0.01 %), rounded to the nearest value.
+// Integer only, so the results don't depend on FPU rounding.
+int32_t stts751_raw_to_centi_celsius(int16_t raw);
+int32_t lps22hb_raw_to_centi_hpa(int32_t raw);
+// Average of several samples, rounded once
+int32_t lps22hb_raw_sum_to_centi_hpa(int64_t raw_sum, uint32_t samples);
+// LPS22HB TEMP_OUT is already in 0.01 *C, only the average needs converting
+int32_t lps22hb_raw_sum_to_centi_celsius(int64_t raw_sum, uint32_t samples);
+// Clamped to 0-100 %, like the ST driver does. Returns 0 for an invalid calibration.
+int32_t hts221_raw_to_centi_percent(HTS221Calibration const* calibration, int16_t raw);
+// Returns 0 for an invalid calibration
+int32_t hts221_raw_to_centi_celsius(HTS221Calibration const* calibration, int16_t raw);
+
+#endif /* INC_MEMS_CONVERSION_H_ */
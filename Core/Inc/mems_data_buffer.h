@@ -35,4 +35,12 @@ void clear_stored_measurements();
 bool append_measurement(WeatherStationMeasurement* measurement);
 bool fetch_measurement(WeatherStationMeasurement* output_measurement);
 
+// Every appended measurement gets next sequence number, stored ones are [first, end)
+uint32_t measurements_first_sequence();
+uint32_t measurements_end_sequence();
+// Reads stored measurement without removing it, so more clients can fetch the same records
+bool peek_measurement(uint32_t sequence, WeatherStationMeasurement* output_measurement);
+// Removes measurements with sequence numbers lower than end_sequence
+void release_measurements(uint32_t end_sequence);
+
 #endif /* INC_MEMS_DATA_BUFFER_H_ */
@@ -0,0 +1,64 @@
+/*
+ * mems_filters.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: steelph0enix
+ */
+
+#ifndef INC_MEMS_FILTERS_H_
+#define INC_MEMS_FILTERS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "mems_sensors.h"
+
+#define MEMS_FILTER_STAGES 3
+#define MEMS_FILTER_MAX_WINDOW 8
+// Spike rejection gives up after this many outliers in a row, it's a real step then
+#define MEMS_FILTER_SPIKE_PERSISTENCE 3
+// Channel configuration: type and parameter byte of every stage
+#define MEMS_FILTER_CONFIG_LENGTH (MEMS_CHANNELS * MEMS_FILTER_STAGES * 2)
+
+// Filters work on centi-units, with integer math only
+typedef enum MemsFilterType_t {
+	MEMS_FILTER_NONE = 0x00,
+	MEMS_FILTER_MOVING_AVERAGE = 0x01, // parameter: window, 1-MEMS_FILTER_MAX_WINDOW samples
+	MEMS_FILTER_MEDIAN = 0x02,         // parameter: window, 1-MEMS_FILTER_MAX_WINDOW samples
+	MEMS_FILTER_EXPONENTIAL = 0x03,    // parameter: k, 1-8, y += (x - y) / 2^k
+	MEMS_FILTER_SPIKE_REJECTION = 0x04 // parameter: largest step between samples, 1-255, in 0.1 units (*C, hPa, %)
+} MemsFilterType;
+
+typedef struct MemsFilterStage_t {
+	uint8_t type;
+	uint8_t parameter;
+} MemsFilterStage;
+
+// Stages run in order, unused ones are MEMS_FILTER_NONE
+typedef struct MemsFilterConfig_t {
+	MemsFilterStage stages[MEMS_FILTER_STAGES];
+} MemsFilterConfig;
+
+typedef struct MemsFilterState_t {
+	int32_t history[MEMS_FILTER_MAX_WINDOW];
+	uint8_t count;
+	uint8_t next;
+	int32_t accumulator; // exponential: output with 8 fractional bits, spike rejection: last accepted sample
+	uint8_t rejected;
+} MemsFilterState;
+
+typedef struct MemsFilterChain_t {
+	MemsFilterConfig config;
+	MemsFilterState states[MEMS_FILTER_STAGES];
+} MemsFilterChain;
+
+bool mems_filter_config_is_valid(MemsFilterConfig const* config);
+// Applies the configuration and forgets the history
+void mems_filter_chain_init(MemsFilterChain* chain, MemsFilterConfig const* config);
+int32_t mems_filter_chain_apply(MemsFilterChain* chain, int32_t sample);
+bool mems_filter_chain_is_active(MemsFilterChain const* chain);
+
+// Configuration of all channels in MemsChannel order, as the filter configuration characteristic holds it
+bool mems_filter_config_decode(uint8_t const data[], uint16_t length, MemsFilterConfig configs[MEMS_CHANNELS]);
+void mems_filter_config_encode(MemsFilterConfig const configs[MEMS_CHANNELS], uint8_t data[MEMS_FILTER_CONFIG_LENGTH]);
+
+#endif /* INC_MEMS_FILTERS_H_ */
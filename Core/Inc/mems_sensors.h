@@ -8,10 +8,80 @@
 #ifndef INC_MEMS_SENSORS_H_
 #define INC_MEMS_SENSORS_H_
 
+#include <stdint.h>
+
+typedef enum MemsChannel_t {
+	MEMS_CHANNEL_TEMPERATURE, // STTS751
+	MEMS_CHANNEL_PRESSURE,    // LPS22HB
+	MEMS_CHANNEL_HUMIDITY,    // HTS221
+	MEMS_CHANNELS
+} MemsChannel;
+
+// Single sample of every channel, all conversions are started at once.
+// Every sensor measures temperature too, with fusion enabled the temperature channel is a weighted
+// average of all three and the other readings are only used to check it.
+typedef struct MemsMeasurement_t {
+	int32_t values[MEMS_CHANNELS];       // 0.01 *C, 0.01 hPa, 0.01 %
+	uint8_t validChannels;               // bit per MemsChannel, channel was read correctly
+	uint32_t latencyUs;                  // first trigger to the last result
+	uint32_t skewUs;                     // first to last trigger, channels are sampled this close to each other
+	int32_t temperatures[MEMS_CHANNELS]; // 0.01 *C, temperature measured by the sensor of given channel
+	uint8_t validTemperatures;           // bit per MemsChannel
+	uint8_t rejectedTemperatures;        // bit per MemsChannel, too far from the others, not used for fusion
+	int32_t temperatureSpread;           // 0.01 *C, highest minus lowest valid temperature
+} MemsMeasurement;
+
+typedef struct MemsChannelStats_t {
+	uint32_t acquisitions;
+	uint32_t drdyPolls;
+	uint32_t timeouts;     // DRDY wasn't set in MEMS_DRDY_TIMEOUT_MS
+	uint64_t latencyUs;    // trigger to data read
+	uint32_t maxLatencyUs;
+} MemsChannelStats;
+
+typedef struct MemsMeasurementStats_t {
+	uint32_t measurements;
+	uint32_t i2cTransactions; // triggers, DRDY polls and data reads
+	uint64_t busUs;           // time spent in I2C transfers, including the wait for the bus
+	uint32_t maxBusUs;
+	uint64_t busyUs;          // CPU time of the measurement, without the time the task was blocked
+	uint64_t latencyUs;
+	uint32_t maxLatencyUs;
+	uint32_t maxSkewUs;
+} MemsMeasurementStats;
+
+// LPS22HB FIFO oversampling
+typedef struct MemsFifoStats_t {
+	uint32_t drains;      // FIFO_STATUS reads, each followed by one burst when there's data
+	uint32_t samples;
+	uint32_t decimations; // averages stored as a measurement
+	uint32_t maxLevel;
+	uint32_t overruns;    // FIFO was full and samples were lost
+	uint32_t empty;       // measurements without a sample since the previous one, pressure was left invalid
+} MemsFifoStats;
+
+typedef struct MemsTemperatureStats_t {
+	uint32_t fusions;
+	uint32_t sources[MEMS_CHANNELS];   // measurements in which the sensor's temperature was valid
+	uint32_t rejections[MEMS_CHANNELS];
+	uint64_t spreadSum;                // 0.01 *C
+	uint32_t maxSpread;
+} MemsTemperatureStats;
+
 void mems_init();
+// Background acquisition, called from the main loop
+void mems_process();
+
+// Blocks the calling task until all conversions are done, can't be used from interrupts.
+// Oversampled pressure is the average since the last mems_measure(), which starts a new one.
+void mems_measure(MemsMeasurement* measurement);
+// Same as mems_measure(), for samples between the stored measurements, the pressure average is kept going
+void mems_sample(MemsMeasurement* measurement);
 
-float mems_get_temperature();
-float mems_get_pressure();
-float mems_get_humidity();
+MemsChannelStats get_mems_channel_stats(MemsChannel channel);
+MemsMeasurementStats get_mems_measurement_stats();
+MemsFifoStats get_mems_fifo_stats();
+MemsTemperatureStats get_mems_temperature_stats();
+void mems_print_stats();
 
 #endif /* INC_MEMS_SENSORS_H_ */
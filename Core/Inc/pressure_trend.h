@@ -0,0 +1,40 @@
+/*
+ * pressure_trend.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: steelph0enix
+ */
+
+#ifndef INC_PRESSURE_TREND_H_
+#define INC_PRESSURE_TREND_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Zambretti forecast is a letter, from 'A' (settled fine) to 'Z' (stormy, much rain)
+#define PRESSURE_FORECAST_UNKNOWN 0
+
+typedef enum PressureTendency_t {
+	PRESSURE_TENDENCY_UNKNOWN,
+	PRESSURE_TENDENCY_FALLING,
+	PRESSURE_TENDENCY_STEADY,
+	PRESSURE_TENDENCY_RISING
+} PressureTendency;
+
+typedef struct PressureTrend_t {
+	int16_t change1h;   // 0.01 hPa per hour, from the last hour
+	int16_t change3h;   // 0.01 hPa in 3 hours, from the last 3 hours
+	bool isValid1h;     // not enough history yet, or too many gaps in it
+	bool isValid3h;
+	PressureTendency tendency;
+	char forecast;      // Zambretti letter, PRESSURE_FORECAST_UNKNOWN without the tendency
+} PressureTrend;
+
+void pressure_trend_reset();
+// Station pressure (0.01 hPa) of a measurement made at given HAL tick, every sample costs the same
+// no matter how long the history is
+void pressure_trend_add(int32_t pressure, uint32_t tick);
+// Forecast is made for the sea-level pressure (0.01 hPa), like the Zambretti tables expect
+PressureTrend pressure_trend_get(int32_t sea_level_pressure);
+
+#endif /* INC_PRESSURE_TREND_H_ */
@@ -0,0 +1,22 @@
+/*
+ * thread_flags.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: steelph0enix
+ */
+
+#ifndef INC_THREAD_FLAGS_H_
+#define INC_THREAD_FLAGS_H_
+
+// Thread flags belong to the task, not to the module that waits on them, and the default task
+// waits on flags of more than one module. Every module gets its own bits, all of them are
+// reserved here, so a flag set by one module can't wake up or satisfy the wait of another.
+
+// hci_tl_interface.c - BlueNRG-2 raised IRQ during a write, set for the writing task
+#define THREAD_FLAG_HCI_WRITE_READY   0x00000001u
+// i2c_bus.c - interrupt ended the transfer, set for the bus task
+#define THREAD_FLAG_I2C_TRANSFER_DONE 0x00000002u
+// i2c_bus.c - bus task is done with the request, set for the requesting task
+#define THREAD_FLAG_I2C_REQUEST_DONE  0x00000004u
+
+#endif /* INC_THREAD_FLAGS_H_ */
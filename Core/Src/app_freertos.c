@@ -41,6 +41,12 @@
 #include "print_utils.h"
 #include "mems_sensors.h"
 #include "app_states.h"
+#include "usart.h"
+#include "bluenrg_conf.h"
+#include "hci_snoop.h"
+#include "ble_app_stats.h"
+#include "ble_app_advertising.h"
+#include "i2c_bus.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -61,6 +67,7 @@
 /* Private variables ---------------------------------------------------------*/
 /* USER CODE BEGIN Variables */
 bool isTimeForUpdate = false;
+bool isButtonPressed = false;
 /* USER CODE END Variables */
 /* Definitions for defaultTask */
 osThreadId_t defaultTaskHandle;
@@ -73,6 +80,7 @@ const osThreadAttr_t defaultTask_attributes = {
 /* Private function prototypes -----------------------------------------------*/
 /* USER CODE BEGIN FunctionPrototypes */
 void scanI2CDevices(I2C_HandleTypeDef* i2c);
+uint8_t getDebugCommand();
 /* USER CODE END FunctionPrototypes */
 
 void StartDefaultTask(void *argument);
@@ -111,6 +119,7 @@ void MX_FREERTOS_Init(void) {
 
   /* USER CODE BEGIN RTOS_THREADS */
 	/* add threads, ... */
+	i2c_bus_init();
   /* USER CODE END RTOS_THREADS */
 
   /* USER CODE BEGIN RTOS_EVENTS */
@@ -130,6 +139,8 @@ void StartDefaultTask(void *argument)
 {
   /* USER CODE BEGIN StartDefaultTask */
 	debugPrint("Hello, world!");
+	// sensors are initialized while BlueNRG boots
+	ble_start();
 	mems_init();
 	ble_init();
 	app_set_measurement_interval(0, 0, 15);
@@ -144,6 +155,8 @@ void StartDefaultTask(void *argument)
 	for (;;) {
 		osDelay(1);
 		ble_process();
+		mems_process();
+		app_process();
 
 		if (isTimeForUpdate) {
 			HAL_RTC_GetTime(&hrtc, &currentTime, RTC_FORMAT_BIN);
@@ -153,6 +166,27 @@ void StartDefaultTask(void *argument)
 			app_rtc_alarm_handler();
 			isTimeForUpdate = false;
 		}
+
+		if (isButtonPressed) {
+			debugPrint("User button pressed, advertising fast");
+			ble_advertising_trigger(BLE_ADV_TRIGGER_BUTTON);
+			isButtonPressed = false;
+		}
+
+		switch (getDebugCommand()) {
+		case 's':
+			ble_print_stats();
+			mems_print_stats();
+			i2c_bus_print_stats();
+			break;
+#if HCI_LOG_ON
+		case 'h':
+			hci_snoop_dump();
+			break;
+#endif
+		default:
+			break;
+		}
 	}
   /* USER CODE END StartDefaultTask */
 }
@@ -163,6 +197,24 @@ void HAL_RTC_AlarmAEventCallback(RTC_HandleTypeDef* hrtc) {
 	isTimeForUpdate = true;
 }
 
+// Nucleo user button (B1), wakes the advertising up so a phone can connect quickly
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin) {
+	if (GPIO_Pin == BOARD_BUTTON_Pin) {
+		isButtonPressed = true;
+	}
+}
+
+// Commands sent over the debug UART:
+// 'h' - dump the HCI log (debug builds only)
+// 's' - print BLE statistics
+uint8_t getDebugCommand() {
+	__HAL_UART_CLEAR_OREFLAG(&hlpuart1);
+	if (__HAL_UART_GET_FLAG(&hlpuart1, UART_FLAG_RXNE)) {
+		return (uint8_t) hlpuart1.Instance->RDR;
+	}
+	return 0;
+}
+
 void scanI2CDevices(I2C_HandleTypeDef* i2c) {
 	unsigned found_devices = 0;
 
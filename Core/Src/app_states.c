@@ -7,52 +7,149 @@
 
 #include "app_states.h"
 #include "ble_app_interface.h"
+#include "ble_app_commands.h"
+#include "ble_app_advertising.h"
 #include "print_utils.h"
+#include "bit_helpers.h"
 #include "rtc_utils.h"
 #include "mems_data_buffer.h"
 #include "mems_sensors.h"
+#include "mems_filters.h"
+#include "derived_metrics.h"
+#include "pressure_trend.h"
+#include "main.h"
 
 #include <stdbool.h>
 
+// With filters set, sensors are sampled this often between the stored measurements too,
+// so the filters see more than one sample per record
+#define FILTER_SAMPLE_INTERVAL_MS 60000u
+
+// Dead Sea shore to the highest mountains
+#define STATION_ALTITUDE_MIN -500
+#define STATION_ALTITUDE_MAX 9000
+
+_Static_assert(MEMS_FILTER_CONFIG_LENGTH == BLE_FILTER_CONFIG_LENGTH,
+		"Filter configuration characteristic must hold configuration of all channels");
+
 static void set_app_state(AppState new_state);
-static void app_set_date_and_time();
-static void app_start_fetching();
-static void app_fetch_next();
-static void app_finish_fetching();
+static void app_set_date_and_time(RTC_TimeTypeDef time, RTC_DateTypeDef date);
+static void app_start_fetching(BLESession* session);
+static void app_fetch_next(BLESession* session);
+static void app_finish_fetching(BLESession* session, uint32_t confirmed_end);
+static uint32_t confirmed_records_end(BLESession const* session);
 static void update_alarm_time(RTC_TimeTypeDef *interval);
 
 static uint8_t const alarmSecondsGracePeriod = 3;
 
 static AppState currentAppState = APP_STATE_IDLE;
-static bool isFetchingData = false;
 static RTC_TimeTypeDef alarmInterval = { 0 };
 
-void ble_control_value_changed(BLEControlCharValue value) {
-	switch (value) {
+static MemsFilterConfig filterConfigs[MEMS_CHANNELS] = { 0 };
+static MemsFilterChain filterChains[MEMS_CHANNELS] = { 0 };
+static uint32_t lastSampleTick = 0;
+static int16_t stationAltitude = 0; // meters
+
+static void publish_filter_config() {
+	uint8_t config[MEMS_FILTER_CONFIG_LENGTH] = { 0 };
+	mems_filter_config_encode(filterConfigs, config);
+	set_ble_filter_config(config);
+}
+
+void ble_session_opened(BLESession *session) {
+	set_ble_control_value(session, BLE_CTRL_DEFAULT);
+	set_ble_number_of_records(session, measurements_stored_count());
+	publish_filter_config();
+	set_ble_station_altitude(stationAltitude);
+}
+
+void ble_station_altitude_written(uint8_t const data[], uint16_t length) {
+	int16_t const altitude = length == 2 ? (int16_t) BYTEARRAY_TO_16BIT_VALUE_LE(data) : INT16_MIN;
+	if (altitude < STATION_ALTITUDE_MIN || altitude > STATION_ALTITUDE_MAX) {
+		debugPrint("Invalid station altitude, keeping %d m", stationAltitude);
+	} else {
+		stationAltitude = altitude;
+		debugPrint("Station altitude set to %d m", stationAltitude);
+	}
+	set_ble_station_altitude(stationAltitude);
+}
+
+void ble_filter_config_written(uint8_t const data[], uint16_t length) {
+	if (!mems_filter_config_decode(data, length, filterConfigs)) {
+		debugPrint("Invalid filter configuration (%d bytes), keeping the previous one", length);
+		// GATT database holds the rejected value now
+		publish_filter_config();
+		return;
+	}
+
+	for (uint8_t channel = 0; channel < MEMS_CHANNELS; channel++) {
+		mems_filter_chain_init(&filterChains[channel], &filterConfigs[channel]);
+	}
+	publish_filter_config();
+	debugPrint("Filter configuration changed, filter history cleared");
+}
+
+void ble_session_closed(BLESession *session) {
+	// Records this client confirmed may be released now, if no one else is fetching them
+	if (session->isFetching) {
+		app_finish_fetching(session, confirmed_records_end(session));
+	}
+}
+
+void ble_control_command_execute(BLEControlCommand const *command) {
+	// Client that wrote the command may have disconnected in the meantime
+	BLESession *session = ble_session_find(command->connectionHandle);
+
+	switch (command->opcode) {
 	case BLE_CTRL_GET_DATA:
-		app_start_fetching();
+		if (session != NULL) {
+			app_start_fetching(session);
+		}
 		break;
 	case BLE_CTRL_FETCH_NEXT_RECORD:
-		app_fetch_next();
+		if (session != NULL && session->isFetching) {
+			app_fetch_next(session);
+		}
 		break;
 	case BLE_CTRL_ABORT_FETCHING:
-		app_finish_fetching();
+		if (session != NULL && session->isFetching) {
+			app_finish_fetching(session, confirmed_records_end(session));
+		}
 		break;
 	case BLE_CTRL_SET_MEASUREMENT_INTERVAL: {
-		RTC_TimeTypeDef const newInterval = get_ble_time();
-		app_set_measurement_interval(newInterval.Hours, newInterval.Minutes,
-				newInterval.Seconds);
+		app_set_measurement_interval(command->time.Hours, command->time.Minutes,
+				command->time.Seconds);
 		break;
 	}
 	case BLE_CTRL_SET_DATE_AND_TIME:
-		app_set_date_and_time();
+		app_set_date_and_time(command->time, command->date);
 		break;
 	default:
 		debugPrint(
 				"Control byte changed to unexpected value 0x%02X, not handling that.",
-				(uint8_t )value);
+				(uint8_t )command->opcode);
 		break;
 	}
+
+	// do not change the value of control char when it's set to NEXT_RECORD_AVAILABLE
+	// to prevent sync issues on the device side
+	if (session != NULL && !session->isFetching) {
+		set_ble_control_value(session, BLE_CTRL_DEFAULT);
+	}
+}
+
+static void update_sessions_number_of_records() {
+	for (uint8_t index = 0; index < BLE_MAX_CONNECTIONS; index++) {
+		BLESession const *session = ble_session_at(index);
+		if (session == NULL) {
+			continue;
+		}
+
+		// Fetching client counts the records after the one it's reading
+		uint32_t const remaining = session->isFetching ?
+				measurements_end_sequence() - session->fetchCursor : measurements_stored_count();
+		set_ble_number_of_records(session, remaining);
+	}
 }
 
 static void update_alarm_time(RTC_TimeTypeDef *interval) {
@@ -70,6 +167,62 @@ static void print_measurement(WeatherStationMeasurement const *measurement) {
 						// @formatter:on
 }
 
+static bool are_filters_active() {
+	for (uint8_t channel = 0; channel < MEMS_CHANNELS; channel++) {
+		if (mems_filter_chain_is_active(&filterChains[channel])) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Channels that couldn't be read don't go through the filters, their history stays clean
+static void filter_sample(MemsMeasurement* sample) {
+	lastSampleTick = HAL_GetTick();
+
+	for (uint8_t channel = 0; channel < MEMS_CHANNELS; channel++) {
+		if (sample->validChannels & (1u << channel)) {
+			sample->values[channel] = mems_filter_chain_apply(&filterChains[channel], sample->values[channel]);
+		}
+	}
+}
+
+void app_process() {
+	if (are_filters_active() && HAL_GetTick() - lastSampleTick >= FILTER_SAMPLE_INTERVAL_MS) {
+		// Intermediate samples only feed the filters, they must not restart the pressure average
+		MemsMeasurement sample = { 0 };
+		mems_sample(&sample);
+		filter_sample(&sample);
+	}
+}
+
+static int32_t valid_value_or_unknown(MemsMeasurement const* sample, MemsChannel channel) {
+	return sample->validChannels & (1u << channel) ? sample->values[channel] : DERIVED_METRIC_UNKNOWN;
+}
+
+static void update_pressure_trend(MemsMeasurement const* sample, int32_t sea_level_pressure) {
+	// Forecast needs the current pressure, the history is kept for the next measurement
+	if (!(sample->validChannels & (1u << MEMS_CHANNEL_PRESSURE))) {
+		set_ble_pressure_trend(BLE_PRESSURE_CHANGE_UNKNOWN, BLE_PRESSURE_CHANGE_UNKNOWN, PRESSURE_TENDENCY_UNKNOWN,
+				PRESSURE_FORECAST_UNKNOWN);
+		debugPrint("No pressure, pressure trend unknown");
+		return;
+	}
+
+	pressure_trend_add(sample->values[MEMS_CHANNEL_PRESSURE], HAL_GetTick());
+	PressureTrend trend = pressure_trend_get(sea_level_pressure);
+	// Sea-level pressure is unknown without the temperature, the changes are still valid
+	if (sea_level_pressure == DERIVED_METRIC_UNKNOWN) {
+		trend.forecast = PRESSURE_FORECAST_UNKNOWN;
+	}
+	set_ble_pressure_trend(trend.isValid1h ? trend.change1h : BLE_PRESSURE_CHANGE_UNKNOWN,
+			trend.isValid3h ? trend.change3h : BLE_PRESSURE_CHANGE_UNKNOWN, trend.tendency, trend.forecast);
+	if (trend.tendency != PRESSURE_TENDENCY_UNKNOWN) {
+		debugPrint("Pressure change %d/h, %d/3h, tendency %d, forecast %c", trend.change1h, trend.change3h,
+				trend.tendency, trend.forecast);
+	}
+}
+
 static void make_new_measurement() {
 	set_app_state(APP_STATE_MEASURING);
 
@@ -80,9 +233,13 @@ static void make_new_measurement() {
 	HAL_RTC_GetTime(&hrtc, &currentTime, RTC_FORMAT_BIN);
 	HAL_RTC_GetDate(&hrtc, &currentDate, RTC_FORMAT_BIN);
 
-	measurement.temperature = (int32_t) (mems_get_temperature() * 100.f);
-	measurement.pressure = (int32_t) (mems_get_pressure() * 100.f);
-	measurement.humidity = (int32_t) (mems_get_humidity() * 100.f);
+	MemsMeasurement sample = { 0 };
+	mems_measure(&sample);
+	filter_sample(&sample);
+
+	measurement.temperature = sample.values[MEMS_CHANNEL_TEMPERATURE];
+	measurement.pressure = sample.values[MEMS_CHANNEL_PRESSURE];
+	measurement.humidity = sample.values[MEMS_CHANNEL_HUMIDITY];
 
 	measurement.hour = currentTime.Hours;
 	measurement.minute = currentTime.Minutes;
@@ -92,7 +249,19 @@ static void make_new_measurement() {
 	measurement.month = currentDate.Month;
 	measurement.day = currentDate.Date;
 
+	DerivedMetrics derived = { 0 };
+	derive_metrics(valid_value_or_unknown(&sample, MEMS_CHANNEL_TEMPERATURE),
+			valid_value_or_unknown(&sample, MEMS_CHANNEL_PRESSURE), valid_value_or_unknown(&sample, MEMS_CHANNEL_HUMIDITY),
+			stationAltitude, &derived);
+
 	print_measurement(&measurement);
+	debugPrint("Dew point %ld, absolute humidity %ld, heat index %ld, sea-level pressure %ld (at %d m)",
+			derived.dewPoint, derived.absoluteHumidity, derived.heatIndex, derived.seaLevelPressure, stationAltitude);
+	set_ble_live_measurement(measurement.temperature, measurement.pressure, measurement.humidity);
+	set_ble_derived_metrics(derived.dewPoint, derived.absoluteHumidity, derived.heatIndex, derived.seaLevelPressure);
+	update_pressure_trend(&sample, derived.seaLevelPressure);
+	set_ble_broadcast_measurement(measurement.temperature, measurement.pressure, measurement.humidity);
+	ble_advertising_trigger(BLE_ADV_TRIGGER_MEASUREMENT);
 
 	if (append_measurement(&measurement)) {
 		debugPrint(
@@ -104,7 +273,7 @@ static void make_new_measurement() {
 				measurements_stored_count(), measurements_slots_left());
 	}
 
-	set_ble_number_of_records(measurements_stored_count());
+	update_sessions_number_of_records();
 
 	set_app_state(APP_STATE_IDLE);
 }
@@ -141,14 +310,11 @@ void app_set_measurement_interval(uint8_t hours, uint8_t minutes,
 	set_app_state(APP_STATE_IDLE);
 }
 
-static void app_set_date_and_time() {
+static void app_set_date_and_time(RTC_TimeTypeDef time, RTC_DateTypeDef date) {
 	set_app_state(APP_STATE_SETTING_DATE_AND_TIME);
 
 	debugPrint("Updating date and time...");
 
-	RTC_TimeTypeDef const time = get_ble_time();
-	RTC_DateTypeDef const date = get_ble_date();
-
 	setRTCDateS(date);
 	setRTCTimeS(time);
 
@@ -157,34 +323,63 @@ static void app_set_date_and_time() {
 	set_app_state(APP_STATE_IDLE);
 }
 
-static void app_start_fetching() {
-	isFetchingData = true;
-	app_fetch_next();
+// Client confirms the record it was presented by asking for the next one,
+// so everything before the presented one (fetchCursor - 1) is confirmed
+static uint32_t confirmed_records_end(BLESession const *session) {
+	return session->fetchCursor - 1;
 }
 
-static void app_fetch_next() {
+static void app_start_fetching(BLESession *session) {
+	// Every client gets all stored records, from its own cursor
+	session->isFetching = true;
+	session->fetchCursor = measurements_first_sequence();
+	app_fetch_next(session);
+}
+
+// Records are removed from the buffer only when every fetching client confirmed them, end is
+// the limit of the client that triggered the release. Nothing past it is released, even when
+// no one else is fetching, so an aborted fetch doesn't take the records no one was shown.
+static void release_confirmed_records(uint32_t end) {
+	for (uint8_t index = 0; index < BLE_MAX_CONNECTIONS; index++) {
+		BLESession const *session = ble_session_at(index);
+		if (session != NULL && session->isFetching && (int32_t) (confirmed_records_end(session) - end) < 0) {
+			end = confirmed_records_end(session);
+		}
+	}
+	release_measurements(end);
+}
+
+static void app_fetch_next(BLESession *session) {
 	set_app_state(APP_STATE_FETCHING_RECORDS);
 
 	WeatherStationMeasurement measurement = { 0 };
-	if (!fetch_measurement(&measurement)) {
-		app_finish_fetching();
+	if (!peek_measurement(session->fetchCursor, &measurement)) {
+		// Asking for the next record confirmed the last one, so the client has all of them
+		app_finish_fetching(session, session->fetchCursor);
 		return;
 	}
 
-	uint16_t const number_of_records = measurements_stored_count();
+	session->fetchCursor++;
+	uint16_t const number_of_records = measurements_end_sequence() - session->fetchCursor;
+	release_confirmed_records(confirmed_records_end(session));
 
-	set_ble_time(measurement.hour, measurement.minute, measurement.second);
-	set_ble_date(measurement.year, measurement.month, measurement.day, 0);
-	set_ble_temperature(measurement.temperature);
-	set_ble_pressure(measurement.pressure);
-	set_ble_humidity(measurement.humidity);
-	set_ble_number_of_records(number_of_records);
+	set_ble_time(session, measurement.hour, measurement.minute, measurement.second);
+	set_ble_date(session, measurement.year, measurement.month, measurement.day, 0);
+	set_ble_temperature(session, measurement.temperature);
+	set_ble_pressure(session, measurement.pressure);
+	set_ble_humidity(session, measurement.humidity);
+	set_ble_number_of_records(session, number_of_records);
+	set_ble_control_value(session, BLE_CTRL_NEXT_RECORD_AVAILABLE);
 
 	set_app_state(APP_STATE_RECORD_READY);
+	set_app_state(APP_STATE_IDLE);
 }
 
-static void app_finish_fetching() {
-	isFetchingData = false;
+static void app_finish_fetching(BLESession *session, uint32_t confirmed_end) {
+	session->isFetching = false;
+	// Aborted fetch may have been the last one holding the records
+	release_confirmed_records(confirmed_end);
+	set_ble_number_of_records(session, measurements_stored_count());
 	set_app_state(APP_STATE_IDLE);
 }
 
@@ -192,27 +387,7 @@ static void set_app_state(AppState new_state) {
 	debugPrint("App state change from 0x%02X to 0x%02X", currentAppState,
 			new_state);
 
-// Value set by weather station:
-//	* DEFAULT
-//	* NEXT_RECORD_AVAILABLE
-
-	switch (new_state) {
-	case APP_STATE_IDLE:
-		if (isFetchingData) {
-			// do not change the value of control char when it's set to NEXT_RECORD_AVAILABLE
-			// to prevent sync issues on the device side
-			return;
-//			set_app_state(APP_STATE_RECORD_READY);
-		} else {
-			set_ble_control_value(BLE_CTRL_DEFAULT);
-		}
-		break;
-	case APP_STATE_RECORD_READY:
-		set_ble_control_value(BLE_CTRL_NEXT_RECORD_AVAILABLE);
-	default:
-		break;
-	}
-
+	// Control characteristic is per client now, it's set by the command handlers
 	currentAppState = new_state;
 }
 
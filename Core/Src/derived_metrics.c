@@ -0,0 +1,238 @@
+/*
+ * derived_metrics.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: steelph0enix
+ */
+
+#include "derived_metrics.h"
+
+#include <stdbool.h>
+
+// Logarithms and exponents are Q24, table values Q30
+#define FIXED_SHIFT 24
+#define TABLE_SHIFT 30
+#define TABLE_SEGMENTS_LOG2 7
+#define TABLE_SEGMENTS (1 << TABLE_SEGMENTS_LOG2)
+
+#define LN2_Q24 11629080LL
+#define LOG2E_Q24 24204406LL
+// (ln 2 / TABLE_SEGMENTS)^2 / 2 in Q32, how far 2^x bends below the chord between two table entries
+#define EXP2_BEND_Q32 62974LL
+
+// Magnus formula, b = 17.62, c = 243.12 *C (WMO, -45 to 60 *C over water)
+#define MAGNUS_B_Q24 295614546LL
+#define MAGNUS_B_CENTI 1762LL
+#define MAGNUS_C_CENTI 24312LL
+#define MAGNUS_E0_MICRO_HPA 6112000LL // saturation vapour pressure at 0 *C
+// Water vapour: 1 / Rv = 216.68 g K / J, times 100 hPa to Pa
+#define WATER_VAPOUR_FACTOR_CENTI 21668LL
+
+#define ZERO_CELSIUS_CENTI_KELVIN 27315
+// R / g of dry air, 29.27 m/K, and half of the standard lapse rate, 0.325 cK/m
+#define AIR_SCALE_HEIGHT_CENTI 2927LL
+#define HALF_LAPSE_RATE_MILLI_CK 325
+
+// Heat index takes temperature in 0.002 *F, exact conversion of 0.01 *C, and humidity in 0.01 %.
+// Regression coefficients are scaled by 10^8, the result is in 10^-9 *F.
+#define FAHRENHEIT_STEPS 500LL // temperature steps per 1 *F
+#define HEAT_INDEX_SCALE 1000000000LL
+
+// @formatter:off
+// 2^(i/128) in Q30
+static uint32_t const exp2Table[TABLE_SEGMENTS + 1] = {
+	1073741824, 1079572136, 1085434106, 1091327906, 1097253708, 1103211687, 1109202018, 1115224875,
+	1121280436, 1127368878, 1133490379, 1139645120, 1145833280, 1152055042, 1158310587, 1164600099,
+	1170923762, 1177281762, 1183674286, 1190101520, 1196563654, 1203060876, 1209593378, 1216161350,
+	1222764986, 1229404479, 1236080024, 1242791816, 1249540052, 1256324931, 1263146652, 1270005413,
+	1276901417, 1283834865, 1290805962, 1297814910, 1304861917, 1311947188, 1319070932, 1326233356,
+	1333434672, 1340675091, 1347954824, 1355274085, 1362633090, 1370032052, 1377471191, 1384950723,
+	1392470869, 1400031848, 1407633882, 1415277195, 1422962010, 1430688553, 1438457051, 1446267730,
+	1454120821, 1462016553, 1469955159, 1477936870, 1485961921, 1494030547, 1502142985, 1510299473,
+	1518500250, 1526745556, 1535035634, 1543370725, 1551751076, 1560176931, 1568648537, 1577166143,
+	1585730000, 1594340357, 1602997467, 1611701585, 1620452965, 1629251865, 1638098541, 1646993254,
+	1655936265, 1664927835, 1673968228, 1683057710, 1692196547, 1701385007, 1710623359, 1719911875,
+	1729250827, 1738640488, 1748081133, 1757573041, 1767116489, 1776711757, 1786359126, 1796058879,
+	1805811301, 1815616678, 1825475297, 1835387448, 1845353420, 1855373507, 1865448001, 1875577199,
+	1885761398, 1896000896, 1906295993, 1916646992, 1927054196, 1937517909, 1948038440, 1958616096,
+	1969251188, 1979944027, 1990694927, 2001504204, 2012372174, 2023299156, 2034285470, 2045331439,
+	2056437387, 2067603638, 2078830522, 2090118366, 2101467502, 2112878262, 2124350982, 2135885998,
+	2147483648
+};
+// log2(1 + i/128) in Q30
+static uint32_t const log2Table[TABLE_SEGMENTS + 1] = {
+	0, 12055174, 24017256, 35887675, 47667823, 59359063, 70962728, 82480119,
+	93912511, 105261148, 116527248, 127712004, 138816582, 149842124, 160789745, 171660541,
+	182455581, 193175914, 203822568, 214396548, 224898839, 235330407, 245692198, 255985140,
+	266210141, 276368092, 286459867, 296486323, 306448299, 316346620, 326182095, 335955515,
+	345667660, 355319292, 364911162, 374444004, 383918542, 393335482, 402695523, 411999347,
+	421247625, 430441017, 439580170, 448665721, 457698295, 466678506, 475606957, 484484242,
+	493310944, 502087636, 510814882, 519493235, 528123241, 536705435, 545240343, 553728485,
+	562170370, 570566499, 578917365, 587223455, 595485245, 603703206, 611877800, 620009483,
+	628098702, 636145900, 644151509, 652115959, 660039669, 667923055, 675766525, 683570481,
+	691335320, 699061430, 706749198, 714399001, 722011213, 729586201, 737124328, 744625951,
+	752091421, 759521085, 766915285, 774274358, 781598637, 788888448, 796144114, 803365955,
+	810554283, 817709409, 824831638, 831921271, 838978604, 846003931, 852997541, 859959719,
+	866890747, 873790901, 880660455, 887499680, 894308843, 901088206, 907838029, 914558569,
+	921250079, 927912807, 934547002, 941152905, 947730758, 954280797, 960803257, 967298370,
+	973766362, 980207461, 986621888, 993009864, 999371606, 1005707329, 1012017244, 1018301561,
+	1024560487, 1030794226, 1037002979, 1043186948, 1049346328, 1055481314, 1061592099, 1067678873,
+	1073741824
+};
+
+
+static int64_t const heatIndexCoefficients[] = {
+	-4237900000LL, 204901523LL, 1014333127LL, -22475541LL, -683783LL, -5481717LL, 122874LL, 85282LL, -199LL
+};
+// @formatter:on
+
+static int64_t divide_rounded(int64_t numerator, int64_t denominator) {
+	if (denominator < 0) {
+		numerator = -numerator;
+		denominator = -denominator;
+	}
+	int64_t const half = denominator / 2;
+	return (numerator >= 0 ? numerator + half : numerator - half) / denominator;
+}
+
+// Linear interpolation between table entries, fraction is Q(TABLE_SEGMENTS_LOG2 + bits)
+static int64_t interpolate(uint32_t const table[], uint32_t fraction, uint8_t bits) {
+	uint32_t const index = fraction >> bits;
+	uint32_t const remainder = fraction & ((1u << bits) - 1);
+	int64_t const step = (int64_t) table[index + 1] - table[index];
+	return table[index] + ((step * remainder) >> bits);
+}
+
+// log2(x) in Q24, x > 0
+static int32_t log2_q24(uint32_t x) {
+	uint8_t const exponent = 31 - __builtin_clz(x);
+	// Mantissa without the leading one, Q32
+	uint32_t const mantissa = (uint32_t) (((uint64_t) x << 32) >> exponent);
+	int64_t const fraction = interpolate(log2Table, mantissa, 32 - TABLE_SEGMENTS_LOG2);
+	return ((int32_t) exponent << FIXED_SHIFT) + (int32_t) divide_rounded(fraction, 1 << (TABLE_SHIFT - FIXED_SHIFT));
+}
+
+// 2^y in Q30, y in Q24 between -30 and 33
+static uint64_t exp2_q30(int32_t y) {
+	int32_t const exponent = y >> FIXED_SHIFT; // floor, also for negative y
+	uint32_t const fraction = (uint32_t) y & ((1u << FIXED_SHIFT) - 1);
+	uint8_t const bits = FIXED_SHIFT - TABLE_SEGMENTS_LOG2;
+	// Chord is up to 3.7e-6 too high in the middle of a segment, 0.4 of 0.01 hPa in the sea-level pressure.
+	// It's over by entry * bend * r * (1 - r) at the position r in the segment, that's taken off.
+	uint32_t const remainder = fraction & ((1u << bits) - 1);
+	uint64_t const position = ((uint64_t) remainder * ((1u << bits) - remainder)) >> bits; // r * (1 - r)
+	uint64_t const bend = ((((uint64_t) exp2Table[fraction >> bits] * position) >> bits) * EXP2_BEND_Q32) >> 32;
+	uint64_t const mantissa = (uint64_t) interpolate(exp2Table, fraction, bits) - bend;
+	if (exponent >= 0) {
+		return mantissa << exponent;
+	}
+	return (mantissa + (1ull << (-exponent - 1))) >> -exponent;
+}
+
+// ln(e_s(T) / e_s(0)) = b * T / (c + T), Q24
+static int64_t magnus_exponent_q24(int32_t temperature) {
+	return divide_rounded(MAGNUS_B_CENTI * temperature * (1 << FIXED_SHIFT), 100 * (MAGNUS_C_CENTI + temperature));
+}
+
+static int32_t clamp_humidity(int32_t humidity) {
+	// Logarithm of 0 % doesn't exist, the lowest value the sensor reports is used instead
+	return humidity < 1 ? 1 : (humidity > 10000 ? 10000 : humidity);
+}
+
+// Td = c * gamma / (b - gamma), gamma = ln(RH) + b * T / (c + T)
+int32_t dew_point_centi_celsius(int32_t temperature, int32_t humidity) {
+	int32_t const log2Humidity = log2_q24(clamp_humidity(humidity)) - log2_q24(10000);
+	int64_t const gamma = divide_rounded((int64_t) log2Humidity * LN2_Q24, 1 << FIXED_SHIFT)
+			+ magnus_exponent_q24(temperature);
+	return (int32_t) divide_rounded(MAGNUS_C_CENTI * gamma, MAGNUS_B_Q24 - gamma);
+}
+
+// AH = 216.68 * e / T, e = RH * e_s(T) in hPa, T in K
+int32_t absolute_humidity_centi_gpm3(int32_t temperature, int32_t humidity) {
+	int64_t const exponent = divide_rounded(magnus_exponent_q24(temperature) * LOG2E_Q24, 1 << FIXED_SHIFT);
+	int64_t const saturation = (int64_t) ((MAGNUS_E0_MICRO_HPA * exp2_q30((int32_t) exponent)) >> TABLE_SHIFT);
+	return (int32_t) divide_rounded(WATER_VAPOUR_FACTOR_CENTI * clamp_humidity(humidity) * saturation,
+			100000000LL * (temperature + ZERO_CELSIUS_CENTI_KELVIN));
+}
+
+static uint32_t square_root(uint64_t value) {
+	uint64_t root = 0;
+	uint64_t bit = 1ull << 62;
+	while (bit > value) {
+		bit >>= 2;
+	}
+	while (bit != 0) {
+		if (value >= root + bit) {
+			value -= root + bit;
+			root = (root >> 1) + bit;
+		} else {
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+	return (uint32_t) root;
+}
+
+static int64_t absolute64(int64_t value) {
+	return value < 0 ? -value : value;
+}
+
+// Rothfusz regression in 1e-9 *F, T in 0.002 *F and RH in 0.01 %.
+// Grouped by the powers of RH, polynomials of T are scaled by 10^8 * 500^2 and fit in 64 bits up to 125 *C.
+static int64_t rothfusz(int64_t t, int64_t rh) {
+	int64_t const* c = heatIndexCoefficients;
+	int64_t const steps2 = FAHRENHEIT_STEPS * FAHRENHEIT_STEPS;
+	int64_t const a = c[0] * steps2 + c[1] * FAHRENHEIT_STEPS * t + c[4] * t * t;
+	int64_t const b = c[2] * steps2 + c[3] * FAHRENHEIT_STEPS * t + c[6] * t * t;
+	int64_t const q = c[5] * steps2 + c[7] * FAHRENHEIT_STEPS * t + c[8] * t * t;
+	// a / 25000 is in 1e-9 *F, b and q are cut to 1e-10 *F per RH unit before they're multiplied by RH
+	int64_t value = divide_rounded(a, 25000) + divide_rounded(divide_rounded(b, 2500) * rh, 1000)
+			+ divide_rounded(divide_rounded(q, 2500) * rh * rh, 100000);
+
+	if (rh < 1300 && t >= 80 * FAHRENHEIT_STEPS && t <= 112 * FAHRENHEIT_STEPS) {
+		// Dry air: - (13 - RH) / 4 * sqrt((17 - |T - 95|) / 17), root in Q24
+		int64_t const root = square_root(((uint64_t) (8500 - absolute64(t - 95 * FAHRENHEIT_STEPS)) << 48) / 8500);
+		value -= ((1300 - rh) * (HEAT_INDEX_SCALE / 400) * root) >> 24;
+	} else if (rh > 8500 && t >= 80 * FAHRENHEIT_STEPS && t <= 87 * FAHRENHEIT_STEPS) {
+		// Humid air: + (RH - 85) / 10 * (87 - T) / 5
+		value += (rh - 8500) * (87 * FAHRENHEIT_STEPS - t) * (HEAT_INDEX_SCALE / 2500000);
+	}
+	return value;
+}
+
+int32_t heat_index_centi_celsius(int32_t temperature, int32_t humidity) {
+	int64_t const t = (int64_t) temperature * 9 + 32 * FAHRENHEIT_STEPS;
+	int64_t const rh = clamp_humidity(humidity);
+
+	// 0.5 * (T + 61 + (T - 68) * 1.2 + RH * 0.094), in 1e-5 *F, exact so the formula switch at 80 *F isn't moved
+	int64_t const simple = 220 * t - 1030000 + 47 * rh;
+	if (simple + 200 * t < 16000000) {
+		return (int32_t) divide_rounded(simple - 3200000, 1800);
+	}
+	return (int32_t) divide_rounded(rothfusz(t, rh) - 32 * HEAT_INDEX_SCALE, HEAT_INDEX_SCALE * 9 / 500);
+}
+
+// P0 = P * exp(h / (29.27 * Tm)), Tm is the mean temperature of the air column below the station
+int32_t sea_level_pressure_centi_hpa(int32_t pressure, int32_t temperature, int16_t altitude) {
+	// 0.001 cK, rounding it to whole cK would cost up to 0.02 hPa at high altitudes
+	int64_t const columnTemperature = ((int64_t) temperature + ZERO_CELSIUS_CENTI_KELVIN) * 1000
+			+ (int64_t) altitude * HALF_LAPSE_RATE_MILLI_CK;
+	int64_t const exponent = divide_rounded((int64_t) altitude * 10000000 * (1 << FIXED_SHIFT),
+			AIR_SCALE_HEIGHT_CENTI * columnTemperature);
+	int64_t const exponent2 = divide_rounded(exponent * LOG2E_Q24, 1 << FIXED_SHIFT);
+	return (int32_t) divide_rounded((int64_t) pressure * (int64_t) exp2_q30((int32_t) exponent2), 1ll << TABLE_SHIFT);
+}
+
+void derive_metrics(int32_t temperature, int32_t pressure, int32_t humidity, int16_t altitude,
+		DerivedMetrics* metrics) {
+	bool const isTemperatureKnown = temperature != DERIVED_METRIC_UNKNOWN;
+	bool const hasHumidityInputs = isTemperatureKnown && humidity != DERIVED_METRIC_UNKNOWN;
+	bool const hasPressureInputs = isTemperatureKnown && pressure != DERIVED_METRIC_UNKNOWN;
+
+	metrics->dewPoint = hasHumidityInputs ? dew_point_centi_celsius(temperature, humidity) : DERIVED_METRIC_UNKNOWN;
+	metrics->absoluteHumidity =
+			hasHumidityInputs ? absolute_humidity_centi_gpm3(temperature, humidity) : DERIVED_METRIC_UNKNOWN;
+	metrics->heatIndex = hasHumidityInputs ? heat_index_centi_celsius(temperature, humidity) : DERIVED_METRIC_UNKNOWN;
+	metrics->seaLevelPressure =
+			hasPressureInputs ? sea_level_pressure_centi_hpa(pressure, temperature, altitude) : DERIVED_METRIC_UNKNOWN;
+}
@@ -0,0 +1,235 @@
+/*
+ * i2c_bus.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: steelph0enix
+ */
+
+#include "i2c_bus.h"
+#include "stm32g4xx_nucleo_bus.h"
+#include "print_utils.h"
+#include "thread_flags.h"
+
+#include "cmsis_os.h"
+#include "main.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#define I2C_BUS_STACK_WORDS 256
+// Device address, register, and the device address again after the repeated start of a read
+#define I2C_BUS_OVERHEAD_BYTES 3u
+
+// Lives on the stack of the requesting task, it's blocked until the bus task is done with it
+typedef struct I2CBusRequest_t {
+	bool isRead;
+	uint16_t address;
+	uint16_t reg;
+	uint8_t* data;
+	uint16_t length;
+	osThreadId_t requester;
+	uint32_t enqueuedCycles;
+	int32_t status;
+	volatile bool isDone; // set by the bus task, the request can't be touched by it after that
+} I2CBusRequest;
+
+// Task and queue are allocated statically, FreeRTOS heap is sized for the default task only
+static StaticTask_t busTaskControlBlock;
+static uint32_t busTaskStack[I2C_BUS_STACK_WORDS];
+static StaticQueue_t requestQueueControlBlock;
+static uint8_t requestQueueStorage[I2C_BUS_QUEUE_LENGTH * sizeof(I2CBusRequest*)];
+
+static osMessageQueueId_t requestQueue = NULL;
+static osThreadId_t busTaskHandle = NULL;
+static osThreadAttr_t const busTaskAttributes = { .name = "i2cBusTask", .priority = (osPriority_t) osPriorityAboveNormal,
+		.cb_mem = &busTaskControlBlock, .cb_size = sizeof(busTaskControlBlock), .stack_mem = busTaskStack,
+		.stack_size = sizeof(busTaskStack) };
+static osMessageQueueAttr_t const requestQueueAttributes = { .name = "i2cRequestQueue", .cb_mem =
+		&requestQueueControlBlock, .cb_size = sizeof(requestQueueControlBlock), .mq_mem = requestQueueStorage, .mq_size =
+		sizeof(requestQueueStorage) };
+
+// Written by the I2C interrupts, read by the bus task after THREAD_FLAG_I2C_TRANSFER_DONE
+static volatile bool transferFailed = false;
+
+static I2CBusStats busStats = { 0 };
+
+// DWT cycle counter is enabled by HCI_TL_SPI_Init()
+static uint32_t cycles_to_us(uint32_t cycles) {
+	return cycles / (SystemCoreClock / 1000000u);
+}
+
+static void update_max(uint32_t* max, uint32_t value) {
+	if (value > *max) {
+		*max = value;
+	}
+}
+
+static HAL_StatusTypeDef start_transfer(I2CBusRequest const* request) {
+	if (request->isRead) {
+		return HAL_I2C_Mem_Read_IT(&hi2c1, request->address, request->reg, I2C_MEMADD_SIZE_8BIT, request->data,
+				request->length);
+	}
+	return HAL_I2C_Mem_Write_IT(&hi2c1, request->address, request->reg, I2C_MEMADD_SIZE_8BIT, request->data,
+			request->length);
+}
+
+// HAL can't abort a memory transfer half way, the peripheral is brought back to a known state instead.
+// Failures are only counted, bus task stack is too small for printing.
+static void recover_bus() {
+	HAL_I2C_DeInit(&hi2c1);
+	if (MX_I2C1_Init(&hi2c1) != HAL_OK) {
+		busStats.recoveryFailures++;
+	}
+	// Interrupt of the aborted transfer may have come in the meantime
+	osThreadFlagsClear(THREAD_FLAG_I2C_TRANSFER_DONE);
+}
+
+static int32_t transfer_status() {
+	if (HAL_I2C_GetError(&hi2c1) == HAL_I2C_ERROR_AF) {
+		busStats.ackFailures++;
+		return BSP_ERROR_BUS_ACKNOWLEDGE_FAILURE;
+	}
+	busStats.errors++;
+	return BSP_ERROR_PERIPH_FAILURE;
+}
+
+static uint32_t transfer_timeout_ms(I2CBusRequest const* request) {
+	uint32_t const busUs = (request->length + I2C_BUS_OVERHEAD_BYTES) * I2C_BUS_BYTE_US;
+	return I2C_BUS_TIMEOUT_MARGIN_MS + (busUs + 999u) / 1000u;
+}
+
+static int32_t execute_request(I2CBusRequest const* request) {
+	transferFailed = false;
+	if (start_transfer(request) != HAL_OK) {
+		return transfer_status();
+	}
+
+	uint32_t const flags = osThreadFlagsWait(THREAD_FLAG_I2C_TRANSFER_DONE, osFlagsWaitAny,
+			pdMS_TO_TICKS(transfer_timeout_ms(request)));
+	if (flags & osFlagsError) {
+		busStats.timeouts++;
+		recover_bus();
+		return BSP_ERROR_BUSY;
+	}
+
+	return transferFailed ? transfer_status() : BSP_ERROR_NONE;
+}
+
+static void bus_task(void* argument) {
+	UNUSED(argument);
+	I2CBusRequest* request = NULL;
+
+	for (;;) {
+		if (osMessageQueueGet(requestQueue, &request, NULL, osWaitForever) != osOK) {
+			continue;
+		}
+
+		uint32_t const startCycles = DWT->CYCCNT;
+		uint32_t const wait = cycles_to_us(startCycles - request->enqueuedCycles);
+		busStats.waitUs += wait;
+		update_max(&busStats.maxWaitUs, wait);
+
+		request->status = execute_request(request);
+
+		uint32_t const duration = cycles_to_us(DWT->CYCCNT - startCycles);
+		busStats.transfers++;
+		busStats.bytes += request->length;
+		busStats.transferUs += duration;
+		update_max(&busStats.maxTransferUs, duration);
+
+		// Requester may return as soon as it sees isDone, its stack is gone after that
+		osThreadId_t const requester = request->requester;
+		request->isDone = true;
+		osThreadFlagsSet(requester, THREAD_FLAG_I2C_REQUEST_DONE);
+	}
+}
+
+static int32_t polled_transfer(I2CBusRequest const* request) {
+	busStats.polledTransfers++;
+	if (request->isRead) {
+		return BSP_I2C1_ReadReg(request->address, request->reg, request->data, request->length);
+	}
+	return BSP_I2C1_WriteReg(request->address, request->reg, request->data, request->length);
+}
+
+static int32_t transfer(bool is_read, uint16_t address, uint16_t reg, uint8_t* data, uint16_t length) {
+	I2CBusRequest request = { .isRead = is_read, .address = address, .reg = reg, .data = data, .length = length,
+			.status = BSP_ERROR_UNKNOWN_FAILURE };
+	I2CBusRequest* pointer = &request;
+
+	// Sensors may be set up before the scheduler, and interrupts can't wait for the bus task
+	if (busTaskHandle == NULL || osKernelGetState() != osKernelRunning || __get_IPSR() != 0) {
+		return polled_transfer(&request);
+	}
+
+	request.requester = osThreadGetId();
+	request.enqueuedCycles = DWT->CYCCNT;
+	// Flag may be left over from a request that was already done when its requester woke up
+	osThreadFlagsClear(THREAD_FLAG_I2C_REQUEST_DONE);
+	if (osMessageQueuePut(requestQueue, &pointer, 0, osWaitForever) != osOK) {
+		return BSP_ERROR_BUSY;
+	}
+	update_max(&busStats.maxDepth, osMessageQueueGetCount(requestQueue));
+
+	// Bus task always answers, a stuck transfer ends with its timeout.
+	// Completion is taken from the request, the flag only wakes the task up.
+	while (!request.isDone) {
+		osThreadFlagsWait(THREAD_FLAG_I2C_REQUEST_DONE, osFlagsWaitAny, osWaitForever);
+	}
+	return request.status;
+}
+
+void i2c_bus_init() {
+	requestQueue = osMessageQueueNew(I2C_BUS_QUEUE_LENGTH, sizeof(I2CBusRequest*), &requestQueueAttributes);
+	if (requestQueue == NULL) {
+		debugPrint("Couldn't create I2C request queue, transfers will be polled!");
+		return;
+	}
+	busTaskHandle = osThreadNew(bus_task, NULL, &busTaskAttributes);
+	if (busTaskHandle == NULL) {
+		debugPrint("Couldn't create I2C bus task, transfers will be polled!");
+	}
+}
+
+int32_t i2c_bus_read_reg(uint16_t address, uint16_t reg, uint8_t* data, uint16_t length) {
+	return transfer(true, address, reg, data, length);
+}
+
+int32_t i2c_bus_write_reg(uint16_t address, uint16_t reg, uint8_t* data, uint16_t length) {
+	return transfer(false, address, reg, data, length);
+}
+
+I2CBusStats get_i2c_bus_stats() {
+	return busStats;
+}
+
+void i2c_bus_print_stats() {
+	I2CBusStats const* stats = &busStats;
+	uint32_t const transfers = stats->transfers > 0 ? stats->transfers : 1;
+	// @formatter:off
+	printf("I2C bus: %lu transfers, %lu bytes, %lu polled, %lu NACKs, %lu errors, %lu timeouts, %lu failed recoveries, transfer %lu us avg, %lu us max, queued %lu us avg, %lu us max, max queue depth %lu\n",
+			stats->transfers, stats->bytes, stats->polledTransfers, stats->ackFailures, stats->errors, stats->timeouts,
+			stats->recoveryFailures,
+			(uint32_t) (stats->transferUs / transfers), stats->maxTransferUs, (uint32_t) (stats->waitUs / transfers),
+			stats->maxWaitUs, stats->maxDepth);
+	// @formatter:on
+}
+
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef* hi2c) {
+	if (hi2c == &hi2c1 && busTaskHandle != NULL) {
+		osThreadFlagsSet(busTaskHandle, THREAD_FLAG_I2C_TRANSFER_DONE);
+	}
+}
+
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef* hi2c) {
+	if (hi2c == &hi2c1 && busTaskHandle != NULL) {
+		osThreadFlagsSet(busTaskHandle, THREAD_FLAG_I2C_TRANSFER_DONE);
+	}
+}
+
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef* hi2c) {
+	if (hi2c == &hi2c1 && busTaskHandle != NULL) {
+		transferFailed = true;
+		osThreadFlagsSet(busTaskHandle, THREAD_FLAG_I2C_TRANSFER_DONE);
+	}
+}
@@ -0,0 +1,79 @@
+/*
+ * mems_conversion.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: steelph0enix
+ */
+
+#include "mems_conversion.h"
+
+#define CENTI_PERCENT_MAX 10000
+
+static int32_t divide_rounded(int64_t numerator, int64_t denominator) {
+	if (denominator < 0) {
+		numerator = -numerator;
+		denominator = -denominator;
+	}
+	// Half away from zero, C division truncates towards zero
+	int64_t const half = denominator / 2;
+	return (int32_t) ((numerator >= 0 ? numerator + half : numerator - half) / denominator);
+}
+
+// STTS751 has 8 fractional bits, so it's raw / 256 *C
+int32_t stts751_raw_to_centi_celsius(int16_t raw) {
+	return divide_rounded((int64_t) raw * 100, 256);
+}
+
+// LPS22HB PRESS_OUT is a 24-bit value in 1/4096 hPa
+int32_t lps22hb_raw_to_centi_hpa(int32_t raw) {
+	return lps22hb_raw_sum_to_centi_hpa(raw, 1);
+}
+
+int32_t lps22hb_raw_sum_to_centi_hpa(int64_t raw_sum, uint32_t samples) {
+	if (samples == 0) {
+		return 0;
+	}
+	return divide_rounded(raw_sum * 100, (int64_t) samples * 4096);
+}
+
+int32_t lps22hb_raw_sum_to_centi_celsius(int64_t raw_sum, uint32_t samples) {
+	if (samples == 0) {
+		return 0;
+	}
+	return divide_rounded(raw_sum, samples);
+}
+
+// Linear interpolation between the calibration points, the same line as the ST driver uses:
+// %rH = H0 + (H1 - H0) * (raw - H0_T0_OUT) / (H1_T0_OUT - H0_T0_OUT), with H0 and H1 in %rH x 2
+int32_t hts221_raw_to_centi_percent(HTS221Calibration const* calibration, int16_t raw) {
+	int32_t const outSpan = (int32_t) calibration->h1T0Out - calibration->h0T0Out;
+	if (outSpan == 0) {
+		return 0;
+	}
+
+	int64_t const rhSpan = (int64_t) calibration->h1RhX2 - calibration->h0RhX2;
+	int64_t const numerator = ((int64_t) calibration->h0RhX2 * outSpan
+			+ rhSpan * ((int32_t) raw - calibration->h0T0Out)) * 50;
+	int32_t const value = divide_rounded(numerator, outSpan);
+
+	if (value < 0) {
+		return 0;
+	}
+	if (value > CENTI_PERCENT_MAX) {
+		return CENTI_PERCENT_MAX;
+	}
+	return value;
+}
+
+// Same interpolation with T0 and T1 in *C x 8: T = T0 + (T1 - T0) * (raw - T0_OUT) / (T1_OUT - T0_OUT)
+int32_t hts221_raw_to_centi_celsius(HTS221Calibration const* calibration, int16_t raw) {
+	int32_t const outSpan = (int32_t) calibration->t1Out - calibration->t0Out;
+	if (outSpan == 0) {
+		return 0;
+	}
+
+	int64_t const degSpan = (int64_t) calibration->t1DegCX8 - calibration->t0DegCX8;
+	int64_t const numerator = ((int64_t) calibration->t0DegCX8 * outSpan
+			+ degSpan * ((int32_t) raw - calibration->t0Out)) * 25;
+	return divide_rounded(numerator, (int64_t) outSpan * 2);
+}
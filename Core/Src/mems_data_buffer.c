@@ -15,6 +15,7 @@ static WeatherStationMeasurement const* const endOfMeasurementDataBuffer = &meas
 static WeatherStationMeasurement* lastMeasurement = &measurementsData[0];
 static WeatherStationMeasurement* firstMeasurement = &measurementsData[0];
 static size_t currentlyStoredMeasurements = 0;
+static uint32_t firstMeasurementSequence = 0;
 
 size_t calculateMeasurementSlot(WeatherStationMeasurement* measurement) {
 	ptrdiff_t const distance = (ptrdiff_t)(measurement - measurementsData);
@@ -47,6 +48,7 @@ size_t measurements_slots_left() {
 }
 
 void clear_stored_measurements() {
+	firstMeasurementSequence += currentlyStoredMeasurements;
 	currentlyStoredMeasurements = 0;
 	lastMeasurement = &measurementsData[0];
 	firstMeasurement = &measurementsData[0];
@@ -73,6 +75,7 @@ bool fetch_measurement(WeatherStationMeasurement* output_measurement) {
 		return false;
 	}
 	currentlyStoredMeasurements--;
+	firstMeasurementSequence++;
 
 	debugPrint("First measurement is currently in slot #%u", calculateMeasurementSlot(firstMeasurement));
 
@@ -83,3 +86,28 @@ bool fetch_measurement(WeatherStationMeasurement* output_measurement) {
 
 	return true;
 }
+
+uint32_t measurements_first_sequence() {
+	return firstMeasurementSequence;
+}
+
+uint32_t measurements_end_sequence() {
+	return firstMeasurementSequence + currentlyStoredMeasurements;
+}
+
+bool peek_measurement(uint32_t sequence, WeatherStationMeasurement* output_measurement) {
+	uint32_t const offset = sequence - firstMeasurementSequence;
+	if (offset >= measurements_stored_count()) {
+		return false;
+	}
+
+	size_t const slot = (calculateMeasurementSlot(firstMeasurement) + offset) % MAX_MEASUREMENTS_STORED;
+	*output_measurement = measurementsData[slot];
+	return true;
+}
+
+void release_measurements(uint32_t end_sequence) {
+	WeatherStationMeasurement released = { 0 };
+	while ((int32_t) (end_sequence - firstMeasurementSequence) > 0 && fetch_measurement(&released)) {
+	}
+}
@@ -0,0 +1,183 @@
+/*
+ * mems_filters.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: steelph0enix
+ */
+
+#include "mems_filters.h"
+
+#include <string.h>
+
+#define EXPONENTIAL_FRACTION_BITS 8
+#define EXPONENTIAL_MAX_K 8
+// Spike rejection parameter is in 0.1 units, samples are in 0.01 units
+#define SPIKE_THRESHOLD_SCALE 10
+
+static int32_t divide_rounded(int32_t numerator, int32_t denominator) {
+	int32_t const half = denominator / 2;
+	return (numerator >= 0 ? numerator + half : numerator - half) / denominator;
+}
+
+static bool is_stage_valid(MemsFilterStage const* stage) {
+	switch (stage->type) {
+	case MEMS_FILTER_NONE:
+		return true;
+	case MEMS_FILTER_SPIKE_REJECTION:
+		// Zero step would hold every change as a spike
+		return stage->parameter >= 1;
+	case MEMS_FILTER_MOVING_AVERAGE:
+	case MEMS_FILTER_MEDIAN:
+		return stage->parameter >= 1 && stage->parameter <= MEMS_FILTER_MAX_WINDOW;
+	case MEMS_FILTER_EXPONENTIAL:
+		return stage->parameter >= 1 && stage->parameter <= EXPONENTIAL_MAX_K;
+	default:
+		return false;
+	}
+}
+
+bool mems_filter_config_is_valid(MemsFilterConfig const* config) {
+	for (uint8_t i = 0; i < MEMS_FILTER_STAGES; i++) {
+		if (!is_stage_valid(&config->stages[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void mems_filter_chain_init(MemsFilterChain* chain, MemsFilterConfig const* config) {
+	memset(chain, 0, sizeof(MemsFilterChain));
+	chain->config = *config;
+}
+
+bool mems_filter_chain_is_active(MemsFilterChain const* chain) {
+	for (uint8_t i = 0; i < MEMS_FILTER_STAGES; i++) {
+		if (chain->config.stages[i].type != MEMS_FILTER_NONE) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Keeps the last `window` samples, oldest one is overwritten
+static void push_history(MemsFilterState* state, uint8_t window, int32_t sample) {
+	state->history[state->next] = sample;
+	state->next = (state->next + 1) % window;
+	if (state->count < window) {
+		state->count++;
+	}
+}
+
+static int32_t moving_average(MemsFilterState* state, uint8_t window, int32_t sample) {
+	push_history(state, window, sample);
+	int32_t sum = 0;
+	for (uint8_t i = 0; i < state->count; i++) {
+		sum += state->history[i];
+	}
+	return divide_rounded(sum, state->count);
+}
+
+static int32_t median(MemsFilterState* state, uint8_t window, int32_t sample) {
+	int32_t sorted[MEMS_FILTER_MAX_WINDOW];
+	push_history(state, window, sample);
+
+	// Insertion sort, the window is tiny
+	for (uint8_t i = 0; i < state->count; i++) {
+		int32_t const value = state->history[i];
+		uint8_t j = i;
+		for (; j > 0 && sorted[j - 1] > value; j--) {
+			sorted[j] = sorted[j - 1];
+		}
+		sorted[j] = value;
+	}
+
+	uint8_t const middle = state->count / 2;
+	if (state->count % 2 == 0) {
+		return divide_rounded(sorted[middle - 1] + sorted[middle], 2);
+	}
+	return sorted[middle];
+}
+
+static int32_t exponential(MemsFilterState* state, uint8_t k, int32_t sample) {
+	int32_t const scaled = sample * (1 << EXPONENTIAL_FRACTION_BITS);
+	if (state->count == 0) {
+		state->count = 1;
+		state->accumulator = scaled;
+	} else {
+		state->accumulator += divide_rounded(scaled - state->accumulator, 1 << k);
+	}
+	return divide_rounded(state->accumulator, 1 << EXPONENTIAL_FRACTION_BITS);
+}
+
+// Sample that jumps too far from the last accepted one is replaced by it. If the jump
+// persists, the signal really changed and the filter follows it.
+static int32_t spike_rejection(MemsFilterState* state, uint8_t threshold, int32_t sample) {
+	int32_t const step = sample - state->accumulator;
+	int32_t const limit = (int32_t) threshold * SPIKE_THRESHOLD_SCALE;
+
+	if (state->count > 0 && (step > limit || step < -limit) && state->rejected < MEMS_FILTER_SPIKE_PERSISTENCE) {
+		state->rejected++;
+		return state->accumulator;
+	}
+
+	state->count = 1;
+	state->rejected = 0;
+	state->accumulator = sample;
+	return sample;
+}
+
+int32_t mems_filter_chain_apply(MemsFilterChain* chain, int32_t sample) {
+	int32_t value = sample;
+	for (uint8_t i = 0; i < MEMS_FILTER_STAGES; i++) {
+		MemsFilterStage const* stage = &chain->config.stages[i];
+		MemsFilterState* state = &chain->states[i];
+
+		switch (stage->type) {
+		case MEMS_FILTER_MOVING_AVERAGE:
+			value = moving_average(state, stage->parameter, value);
+			break;
+		case MEMS_FILTER_MEDIAN:
+			value = median(state, stage->parameter, value);
+			break;
+		case MEMS_FILTER_EXPONENTIAL:
+			value = exponential(state, stage->parameter, value);
+			break;
+		case MEMS_FILTER_SPIKE_REJECTION:
+			value = spike_rejection(state, stage->parameter, value);
+			break;
+		default:
+			break;
+		}
+	}
+	return value;
+}
+
+bool mems_filter_config_decode(uint8_t const data[], uint16_t length, MemsFilterConfig configs[MEMS_CHANNELS]) {
+	MemsFilterConfig decoded[MEMS_CHANNELS];
+	if (length != MEMS_FILTER_CONFIG_LENGTH) {
+		return false;
+	}
+
+	for (uint8_t channel = 0; channel < MEMS_CHANNELS; channel++) {
+		for (uint8_t i = 0; i < MEMS_FILTER_STAGES; i++) {
+			uint8_t const* bytes = &data[(channel * MEMS_FILTER_STAGES + i) * 2];
+			decoded[channel].stages[i] = (MemsFilterStage ) { .type = bytes[0], .parameter = bytes[1] };
+		}
+		if (!mems_filter_config_is_valid(&decoded[channel])) {
+			return false;
+		}
+	}
+
+	memcpy(configs, decoded, sizeof(decoded));
+	return true;
+}
+
+void mems_filter_config_encode(MemsFilterConfig const configs[MEMS_CHANNELS], uint8_t data[MEMS_FILTER_CONFIG_LENGTH]) {
+	for (uint8_t channel = 0; channel < MEMS_CHANNELS; channel++) {
+		for (uint8_t i = 0; i < MEMS_FILTER_STAGES; i++) {
+			uint8_t* bytes = &data[(channel * MEMS_FILTER_STAGES + i) * 2];
+			bytes[0] = configs[channel].stages[i].type;
+			bytes[1] = configs[channel].stages[i].parameter;
+		}
+	}
+}
@@ -6,65 +6,670 @@
  */
 
 #include "mems_sensors.h"
+#include "mems_conversion.h"
 #include "stm32g4xx_nucleo_bus.h"
+#include "i2c_bus.h"
 #include "print_utils.h"
 #include "hts221.h"
 #include "lps22hb.h"
 #include "stts751.h"
 
+#include "cmsis_os.h"
+#include "main.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+// Set to 1 to spin on DRDY status in a loop (the old way), for comparing the statistics
+#ifndef MEMS_BUSY_POLLING
+#define MEMS_BUSY_POLLING 0
+#endif
+
+// One-shot conversion times with the resolution and averaging set by the drivers' Init functions
+// (STTS751 12 bit, HTS221 default averaging). The task sleeps until the first conversion should be
+// done, then checks DRDY of the converted channels every MEMS_DRDY_POLL_MS, so a sensor that's
+// slower than expected only costs a few more polls.
+#define STTS751_CONVERSION_MS 80u
+#define LPS22HB_CONVERSION_MS 12u
+#define HTS221_CONVERSION_MS 30u
+#define MEMS_DRDY_POLL_MS 2u
+#define MEMS_DRDY_TIMEOUT_MS 500u
+
+// Set to 0 to take pressure as a single one-shot sample, like the other channels
+#ifndef LPS22HB_FIFO_OVERSAMPLING
+#define LPS22HB_FIFO_OVERSAMPLING 1
+#endif
+
+// LPS22HB converts continuously and keeps the samples in its FIFO, mems_process() drains it once
+// LPS22HB_FIFO_WATERMARK samples should be there. Everything collected between two measurements
+// is averaged into the stored pressure. ODR can be 1, 10, 25, 50 or 75 Hz, watermark 1-31.
+#define LPS22HB_FIFO_ODR_HZ 1u
+#define LPS22HB_FIFO_WATERMARK 16u
+#define LPS22HB_FIFO_DEPTH 32u
+#define LPS22HB_FIFO_SAMPLE_SIZE 5u // PRESS_OUT_XL..TEMP_OUT_H
+#define LPS22HB_FIFO_DRAIN_MS (LPS22HB_FIFO_WATERMARK * 1000u / LPS22HB_FIFO_ODR_HZ)
+
+// Set to 0 to store STTS751 temperature as it is, the other sensors' temperatures are still compared with it
+#ifndef MEMS_TEMPERATURE_FUSION
+#define MEMS_TEMPERATURE_FUSION 1
+#endif
+
+// Sensor further than this from the median of three is rejected. With only two valid sensors there's
+// no median, when they disagree by more than this the one with lower weight is rejected.
+// LPS22HB is specified to +-1.5 *C, STTS751 and HTS221 to +-0.5 *C.
+#define MEMS_TEMPERATURE_OUTLIER_CENTI 200
+
 HTS221_Object_t hts;
 LPS22HB_Object_t lps;
 STTS751_Object_t stts;
 
-float mems_get_temperature() {
-	float ret = 0.f;
-	uint8_t ready = 0;
-	STTS751_Set_One_Shot(&stts);
+// Value of the channel and temperature of the sensor, both in centi-units. Sensors compensate
+// their readings with the temperature, so it comes in the same burst at no extra bus cost.
+typedef struct MemsReading_t {
+	int32_t value;
+	int32_t temperature;
+	bool hasTemperature;
+} MemsReading;
+
+typedef struct MemsChannelDescriptor_t {
+	char const* name;
+	int32_t (*trigger)();
+	// Checks DRDY and reads the values when it's set, in as few transactions as the sensor allows
+	int32_t (*poll)(uint8_t* ready, MemsReading* reading);
+	uint32_t conversionMs;
+	uint8_t temperatureWeight; // weight of the sensor's temperature in the fused value
+	// Sampled in the background, not converted on trigger. Nothing at the first poll means nothing
+	// will come before the next sample period, so the channel isn't polled again.
+	bool isContinuous;
+} MemsChannelDescriptor;
+
+typedef enum MemsCollectResult_t {
+	MEMS_COLLECT_DONE,
+	MEMS_COLLECT_PENDING, // still converting, or the transfer failed, polled again until the timeout
+	MEMS_COLLECT_NO_DATA  // continuous channel has no samples
+} MemsCollectResult;
+
+// Read once in mems_init(), the driver would read it again with every humidity sample
+static HTS221Calibration htsCalibration = { 0 };
+static bool isHtsCalibrationValid = false;
+
+#if LPS22HB_FIFO_OVERSAMPLING
+// Pressure samples drained from the LPS22HB FIFO since the last measurement
+typedef struct PressureAccumulator_t {
+	int64_t rawSum;
+	int64_t temperatureSum;
+	uint32_t samples;
+} PressureAccumulator;
+
+static PressureAccumulator pressureAccumulator = { 0 };
+static uint32_t nextFifoDrainTick = 0;
+#endif
+static MemsFifoStats fifoStats = { 0 };
+
+static MemsChannelStats channelStats[MEMS_CHANNELS] = { 0 };
+static MemsMeasurementStats measurementStats = { 0 };
+static MemsTemperatureStats temperatureStats = { 0 };
+static uint32_t i2cTransactions = 0;
+static uint32_t i2cBusCycles = 0;
+
+static int32_t stts_trigger() {
+	return STTS751_Set_One_Shot(&stts);
+}
+
+// STTS751 doesn't auto-increment the register address and its status register sits between
+// the temperature bytes, so it still takes a transaction per register
+static int32_t stts_poll(uint8_t* ready, MemsReading* reading) {
+	int16_t raw = 0;
+	if (STTS751_TEMP_Get_DRDY_Status(&stts, ready) != STTS751_OK) {
+		return STTS751_ERROR;
+	}
+	if (*ready == 0) {
+		return STTS751_OK;
+	}
+	if (stts751_temperature_raw_get(&stts.Ctx, &raw) != STTS751_OK) {
+		return STTS751_ERROR;
+	}
+	reading->value = stts751_raw_to_centi_celsius(raw);
+	reading->temperature = reading->value;
+	reading->hasTemperature = true;
+	return STTS751_OK;
+}
+
+static int32_t decode_pressure(uint8_t const sample[]) {
+	return (int32_t) (((uint32_t) sample[2] << 24) | ((uint32_t) sample[1] << 16) | ((uint32_t) sample[0] << 8)) / 256;
+}
+
+static int16_t decode_word(uint8_t const bytes[]) {
+	return (int16_t) ((bytes[1] << 8) | bytes[0]);
+}
+
+#if LPS22HB_FIFO_OVERSAMPLING
+static int32_t lps_fifo_trigger() {
+	// Sensor converts all the time
+	return LPS22HB_OK;
+}
+
+// FIFO_STATUS tells how many samples there are, then all of them are read in one burst. In FIFO mode
+// the output register address rolls back from TEMP_OUT_H to PRESS_OUT_XL, each pass pops one sample.
+static int32_t drain_pressure_fifo() {
+	uint8_t statusRegister = 0;
+	uint8_t block[LPS22HB_FIFO_DEPTH * LPS22HB_FIFO_SAMPLE_SIZE] = { 0 };
+
+	if (lps22hb_read_reg(&lps.Ctx, LPS22HB_FIFO_STATUS, &statusRegister, 1) != LPS22HB_OK) {
+		return LPS22HB_ERROR;
+	}
+
+	lps22hb_fifo_status_t const* status = (lps22hb_fifo_status_t const*) &statusRegister;
+	uint8_t const level = status->fss > LPS22HB_FIFO_DEPTH ? LPS22HB_FIFO_DEPTH : status->fss;
+	fifoStats.drains++;
+	if (status->ovr) {
+		// Stream mode overwrote the oldest samples, average is still valid, just made of fewer of them
+		fifoStats.overruns++;
+	}
+	if (level > fifoStats.maxLevel) {
+		fifoStats.maxLevel = level;
+	}
+	if (level == 0) {
+		return LPS22HB_OK;
+	}
 
-	while (ready == 0) {
-		STTS751_TEMP_Get_DRDY_Status(&stts, &ready);
+	if (lps.IO.ReadReg(lps.IO.Address, LPS22HB_PRESS_OUT_XL, block, level * LPS22HB_FIFO_SAMPLE_SIZE) != LPS22HB_OK) {
+		return LPS22HB_ERROR;
 	}
 
-	if (STTS751_TEMP_GetTemperature(&stts, &ret) != STTS751_OK) {
-		debugPrint("Couldn't read temperature correctly!");
+	for (uint8_t i = 0; i < level; i++) {
+		uint8_t const* sample = &block[i * LPS22HB_FIFO_SAMPLE_SIZE];
+		pressureAccumulator.rawSum += decode_pressure(sample);
+		pressureAccumulator.temperatureSum += decode_word(&sample[LPS22HB_TEMP_OUT_L - LPS22HB_PRESS_OUT_XL]);
 	}
-	return ret;
+	pressureAccumulator.samples += level;
+	fifoStats.samples += level;
+	return LPS22HB_OK;
 }
 
-float mems_get_pressure() {
-	float ret = 0.f;
-	uint8_t ready = 0;
-	LPS22HB_Set_One_Shot(&lps);
+// Averages everything since the last stored measurement, the FIFO is drained first so it has the latest
+// samples. Temperature is averaged over the same samples. The average is restarted by mems_measure().
+static int32_t lps_fifo_poll(uint8_t* ready, MemsReading* reading) {
+	if (drain_pressure_fifo() != LPS22HB_OK) {
+		return LPS22HB_ERROR;
+	}
 
-	while (ready == 0) {
-		LPS22HB_PRESS_Get_DRDY_Status(&lps, &ready);
+	*ready = pressureAccumulator.samples > 0;
+	if (*ready == 0) {
+		// FIFO was just drained, at 1 Hz ODR the next sample may be a second away
+		fifoStats.empty++;
+	} else {
+		reading->value = lps22hb_raw_sum_to_centi_hpa(pressureAccumulator.rawSum, pressureAccumulator.samples);
+		reading->temperature = lps22hb_raw_sum_to_centi_celsius(pressureAccumulator.temperatureSum,
+				pressureAccumulator.samples);
+		reading->hasTemperature = true;
 	}
+	nextFifoDrainTick = HAL_GetTick() + LPS22HB_FIFO_DRAIN_MS;
+	return LPS22HB_OK;
+}
+#else
+static int32_t lps_trigger() {
+	return LPS22HB_Set_One_Shot(&lps);
+}
 
-	if (LPS22HB_PRESS_GetPressure(&lps, &ret) != LPS22HB_OK) {
-		debugPrint("Couldn't read pressure correctly!");
+// STATUS, PRESS_OUT_XL..PRESS_OUT_H and TEMP_OUT_L..TEMP_OUT_H in one auto-incremented read.
+// Driver's I2C wrapper splits reads into single bytes, so the bus IO is called directly.
+static int32_t lps_poll(uint8_t* ready, MemsReading* reading) {
+	uint8_t block[LPS22HB_TEMP_OUT_H - LPS22HB_STATUS + 1] = { 0 };
+	if (lps.IO.ReadReg(lps.IO.Address, LPS22HB_STATUS, block, sizeof(block)) != LPS22HB_OK) {
+		return LPS22HB_ERROR;
 	}
-	return ret;
+
+	lps22hb_status_t const* status = (lps22hb_status_t const*) &block[0];
+	*ready = status->p_da;
+	if (*ready != 0) {
+		reading->value = lps22hb_raw_to_centi_hpa(decode_pressure(&block[LPS22HB_PRESS_OUT_XL - LPS22HB_STATUS]));
+		reading->temperature = decode_word(&block[LPS22HB_TEMP_OUT_L - LPS22HB_STATUS]);
+		reading->hasTemperature = status->t_da;
+	}
+	return LPS22HB_OK;
+}
+#endif
+
+static int32_t hts_trigger() {
+	return HTS221_Set_One_Shot(&hts);
+}
+
+// STATUS_REG, HUMIDITY_OUT_L..H and TEMP_OUT_L..H in one read, driver's wrapper sets the auto-increment bit
+static int32_t hts_poll(uint8_t* ready, MemsReading* reading) {
+	uint8_t block[HTS221_TEMP_OUT_H - HTS221_STATUS_REG + 1] = { 0 };
+	if (!isHtsCalibrationValid || hts221_read_reg(&hts.Ctx, HTS221_STATUS_REG, block, sizeof(block)) != HTS221_OK) {
+		return HTS221_ERROR;
+	}
+
+	hts221_status_reg_t const* status = (hts221_status_reg_t const*) &block[0];
+	*ready = status->h_da;
+	if (*ready != 0) {
+		reading->value = hts221_raw_to_centi_percent(&htsCalibration,
+				decode_word(&block[HTS221_HUMIDITY_OUT_L - HTS221_STATUS_REG]));
+		reading->temperature = hts221_raw_to_centi_celsius(&htsCalibration,
+				decode_word(&block[HTS221_TEMP_OUT_L - HTS221_STATUS_REG]));
+		reading->hasTemperature = status->t_da;
+	}
+	return HTS221_OK;
+}
+
+static int16_t calibration_word(uint8_t const block[], uint8_t reg) {
+	return decode_word(&block[reg - HTS221_H0_RH_X2]);
+}
+
+static int32_t read_hts_calibration() {
+	// Whole calibration area (0x30-0x3F) in one transaction instead of a read per coefficient
+	uint8_t block[16] = { 0 };
+	if (hts221_read_reg(&hts.Ctx, HTS221_H0_RH_X2, block, sizeof(block)) != HTS221_OK) {
+		return HTS221_ERROR;
+	}
+
+	htsCalibration.h0RhX2 = block[HTS221_H0_RH_X2 - HTS221_H0_RH_X2];
+	htsCalibration.h1RhX2 = block[HTS221_H1_RH_X2 - HTS221_H0_RH_X2];
+	htsCalibration.h0T0Out = calibration_word(block, HTS221_H0_T0_OUT_L);
+	htsCalibration.h1T0Out = calibration_word(block, HTS221_H1_T0_OUT_L);
+
+	hts221_t1_t0_msb_t const* msb = (hts221_t1_t0_msb_t const*) &block[HTS221_T1_T0_MSB - HTS221_H0_RH_X2];
+	htsCalibration.t0DegCX8 = (msb->t0_msb << 8) | block[HTS221_T0_DEGC_X8 - HTS221_H0_RH_X2];
+	htsCalibration.t1DegCX8 = (msb->t1_msb << 8) | block[HTS221_T1_DEGC_X8 - HTS221_H0_RH_X2];
+	htsCalibration.t0Out = calibration_word(block, HTS221_T0_OUT_L);
+	htsCalibration.t1Out = calibration_word(block, HTS221_T1_OUT_L);
+
+	isHtsCalibrationValid = htsCalibration.h1T0Out != htsCalibration.h0T0Out
+			&& htsCalibration.t1Out != htsCalibration.t0Out;
+	return isHtsCalibrationValid ? HTS221_OK : HTS221_ERROR;
+}
+
+// Channels are triggered in this order, the slowest one goes first
+// @formatter:off
+static MemsChannelDescriptor const channels[MEMS_CHANNELS] = {
+	[MEMS_CHANNEL_TEMPERATURE] = { "temperature", stts_trigger, stts_poll, STTS751_CONVERSION_MS, 4, false },
+#if LPS22HB_FIFO_OVERSAMPLING
+	[MEMS_CHANNEL_PRESSURE]    = { "pressure",    lps_fifo_trigger, lps_fifo_poll, 0, 1, true },
+#else
+	[MEMS_CHANNEL_PRESSURE]    = { "pressure",    lps_trigger,  lps_poll,  LPS22HB_CONVERSION_MS, 1, false },
+#endif
+	[MEMS_CHANNEL_HUMIDITY]    = { "humidity",    hts_trigger,  hts_poll,  HTS221_CONVERSION_MS, 2, false }
+};
+// @formatter:on
+
+// Every register access of the drivers goes through these, so all I2C transactions and bus time are counted
+static int32_t counted_write_reg(uint16_t address, uint16_t reg, uint8_t* data, uint16_t length) {
+	uint32_t const start = DWT->CYCCNT;
+	int32_t const status = i2c_bus_write_reg(address, reg, data, length);
+	i2cBusCycles += DWT->CYCCNT - start;
+	i2cTransactions++;
+	return status;
 }
 
-float mems_get_humidity() {
-	float ret = 0.f;
+static int32_t counted_read_reg(uint16_t address, uint16_t reg, uint8_t* data, uint16_t length) {
+	uint32_t const start = DWT->CYCCNT;
+	int32_t const status = i2c_bus_read_reg(address, reg, data, length);
+	i2cBusCycles += DWT->CYCCNT - start;
+	i2cTransactions++;
+	return status;
+}
+
+// DWT cycle counter is enabled by HCI_TL_SPI_Init()
+static uint32_t cycles_to_us(uint32_t cycles) {
+	return cycles / (SystemCoreClock / 1000000u);
+}
+
+// Time until the first pending channel should have its data, or until its next DRDY poll
+static uint32_t next_wait_ms(uint8_t pending, uint32_t elapsed_ms) {
+	uint32_t wait = UINT32_MAX;
+	for (uint8_t channel = 0; channel < MEMS_CHANNELS; channel++) {
+		if (!(pending & (1u << channel))) {
+			continue;
+		}
+		uint32_t const conversionMs = channels[channel].conversionMs;
+		uint32_t const remaining = conversionMs > elapsed_ms ? conversionMs - elapsed_ms : MEMS_DRDY_POLL_MS;
+		if (remaining < wait) {
+			wait = remaining;
+		}
+	}
+	return wait;
+}
+
+// Skew is measured between the channels that were actually triggered, a failed one doesn't have a trigger time
+static void trigger_channels(MemsMeasurement* measurement, uint8_t* pending, uint32_t trigger_cycles[]) {
+	uint32_t firstCycles = 0;
+	uint32_t lastCycles = 0;
+	for (uint8_t channel = 0; channel < MEMS_CHANNELS; channel++) {
+		if (channels[channel].trigger() != 0) {
+			debugPrint("Couldn't start %s conversion!", channels[channel].name);
+			continue;
+		}
+		trigger_cycles[channel] = DWT->CYCCNT;
+		if (*pending == 0) {
+			firstCycles = trigger_cycles[channel];
+		}
+		lastCycles = trigger_cycles[channel];
+		*pending |= 1u << channel;
+	}
+	measurement->skewUs = cycles_to_us(lastCycles - firstCycles);
+}
+
+// Reads the channel if its conversion is done. Failed transfers are retried with the next poll,
+// until the channel times out.
+static MemsCollectResult collect_channel(MemsMeasurement* measurement, uint8_t channel, uint32_t trigger_cycles) {
+	MemsChannelStats* stats = &channelStats[channel];
 	uint8_t ready = 0;
-	HTS221_Set_One_Shot(&hts);
+	MemsReading reading = { 0 };
 
-	while (ready == 0) {
-		HTS221_HUM_Get_DRDY_Status(&hts, &ready);
+	stats->drdyPolls++;
+	if (channels[channel].poll(&ready, &reading) != 0) {
+		return MEMS_COLLECT_PENDING;
+	}
+	if (ready == 0) {
+		return channels[channel].isContinuous ? MEMS_COLLECT_NO_DATA : MEMS_COLLECT_PENDING;
+	}
+
+	measurement->values[channel] = reading.value;
+	measurement->validChannels |= 1u << channel;
+	if (reading.hasTemperature) {
+		measurement->temperatures[channel] = reading.temperature;
+		measurement->validTemperatures |= 1u << channel;
 	}
 
-	if (HTS221_HUM_GetHumidity(&hts, &ret) != HTS221_OK) {
-		debugPrint("Couldn't read humidity correctly!");
+	uint32_t const latency = cycles_to_us(DWT->CYCCNT - trigger_cycles);
+	stats->acquisitions++;
+	stats->latencyUs += latency;
+	if (latency > stats->maxLatencyUs) {
+		stats->maxLatencyUs = latency;
 	}
-	return ret;
+	return MEMS_COLLECT_DONE;
+}
+
+static int32_t absolute(int32_t value) {
+	return value < 0 ? -value : value;
+}
+
+// Median of up to MEMS_CHANNELS values, sorted in place
+static int32_t median_of(int32_t values[], uint8_t count) {
+	for (uint8_t i = 1; i < count; i++) {
+		int32_t const value = values[i];
+		uint8_t j = i;
+		for (; j > 0 && values[j - 1] > value; j--) {
+			values[j] = values[j - 1];
+		}
+		values[j] = value;
+	}
+	return values[count / 2];
+}
+
+static void reject_temperature_outliers(MemsMeasurement* measurement, int32_t sorted[], uint8_t count) {
+	if (count >= 3) {
+		int32_t const median = median_of(sorted, count);
+		for (uint8_t channel = 0; channel < MEMS_CHANNELS; channel++) {
+			if ((measurement->validTemperatures & (1u << channel))
+					&& absolute(measurement->temperatures[channel] - median) > MEMS_TEMPERATURE_OUTLIER_CENTI) {
+				measurement->rejectedTemperatures |= 1u << channel;
+			}
+		}
+	} else if (count == 2 && measurement->temperatureSpread > MEMS_TEMPERATURE_OUTLIER_CENTI) {
+		int8_t weakest = -1;
+		for (uint8_t channel = 0; channel < MEMS_CHANNELS; channel++) {
+			if ((measurement->validTemperatures & (1u << channel))
+					&& (weakest < 0 || channels[channel].temperatureWeight < channels[weakest].temperatureWeight)) {
+				weakest = channel;
+			}
+		}
+		measurement->rejectedTemperatures |= 1u << weakest;
+	}
+}
+
+// Compares temperatures of all sensors, drops the one that doesn't agree with the others
+// and averages the rest, weighted by the sensors' accuracy
+static void fuse_temperature(MemsMeasurement* measurement) {
+	int32_t sorted[MEMS_CHANNELS] = { 0 };
+	uint8_t count = 0;
+	int32_t lowest = INT32_MAX;
+	int32_t highest = INT32_MIN;
+
+	for (uint8_t channel = 0; channel < MEMS_CHANNELS; channel++) {
+		if (measurement->validTemperatures & (1u << channel)) {
+			int32_t const temperature = measurement->temperatures[channel];
+			sorted[count++] = temperature;
+			lowest = temperature < lowest ? temperature : lowest;
+			highest = temperature > highest ? temperature : highest;
+			temperatureStats.sources[channel]++;
+		}
+	}
+	if (count == 0) {
+		return;
+	}
+
+	measurement->temperatureSpread = highest - lowest;
+	reject_temperature_outliers(measurement, sorted, count);
+
+	int32_t weightedSum = 0;
+	int32_t weights = 0;
+	for (uint8_t channel = 0; channel < MEMS_CHANNELS; channel++) {
+		if ((measurement->validTemperatures & ~measurement->rejectedTemperatures) & (1u << channel)) {
+			weightedSum += measurement->temperatures[channel] * channels[channel].temperatureWeight;
+			weights += channels[channel].temperatureWeight;
+		} else if (measurement->rejectedTemperatures & (1u << channel)) {
+			temperatureStats.rejections[channel]++;
+			debugPrint("%s sensor temperature %ld is off by more than %d from the others, rejected",
+					channels[channel].name, measurement->temperatures[channel], MEMS_TEMPERATURE_OUTLIER_CENTI);
+		}
+	}
+
+	temperatureStats.fusions++;
+	temperatureStats.spreadSum += measurement->temperatureSpread;
+	if ((uint32_t) measurement->temperatureSpread > temperatureStats.maxSpread) {
+		temperatureStats.maxSpread = measurement->temperatureSpread;
+	}
+
+#if MEMS_TEMPERATURE_FUSION
+	int32_t const half = weights / 2;
+	measurement->values[MEMS_CHANNEL_TEMPERATURE] = (weightedSum >= 0 ? weightedSum + half : weightedSum - half)
+			/ weights;
+	measurement->validChannels |= 1u << MEMS_CHANNEL_TEMPERATURE;
+#else
+	UNUSED(weightedSum);
+#endif
+}
+
+static void update_measurement_stats(MemsMeasurement const* measurement, uint32_t transactions, uint32_t bus_us,
+		uint32_t busy_us) {
+	measurementStats.measurements++;
+	measurementStats.i2cTransactions += transactions;
+	measurementStats.busUs += bus_us;
+	if (bus_us > measurementStats.maxBusUs) {
+		measurementStats.maxBusUs = bus_us;
+	}
+	measurementStats.busyUs += busy_us;
+	measurementStats.latencyUs += measurement->latencyUs;
+	if (measurement->latencyUs > measurementStats.maxLatencyUs) {
+		measurementStats.maxLatencyUs = measurement->latencyUs;
+	}
+	if (measurement->skewUs > measurementStats.maxSkewUs) {
+		measurementStats.maxSkewUs = measurement->skewUs;
+	}
+}
+
+static void measure(MemsMeasurement* measurement) {
+	uint32_t const startCycles = DWT->CYCCNT;
+	uint32_t const startTick = HAL_GetTick();
+	uint32_t const startTransactions = i2cTransactions;
+	uint32_t const startBusCycles = i2cBusCycles;
+	uint32_t triggerCycles[MEMS_CHANNELS] = { 0 };
+	uint32_t sleptCycles = 0;
+	uint8_t pending = 0;
+
+	memset(measurement, 0, sizeof(MemsMeasurement));
+
+	// All sensors convert at the same time, so the measurement takes as long as the slowest one
+	trigger_channels(measurement, &pending, triggerCycles);
+
+	while (pending != 0) {
+		uint32_t const elapsedMs = HAL_GetTick() - startTick;
+#if !MEMS_BUSY_POLLING
+		uint32_t const sleepStart = DWT->CYCCNT;
+		osDelay(next_wait_ms(pending, elapsedMs));
+		sleptCycles += DWT->CYCCNT - sleepStart;
+#endif
+
+		for (uint8_t channel = 0; channel < MEMS_CHANNELS; channel++) {
+			if (!(pending & (1u << channel))) {
+				continue;
+			}
+#if !MEMS_BUSY_POLLING
+			if (HAL_GetTick() - startTick < channels[channel].conversionMs) {
+				continue;
+			}
+#endif
+			MemsCollectResult const result = collect_channel(measurement, channel, triggerCycles[channel]);
+			if (result == MEMS_COLLECT_DONE) {
+				pending &= ~(1u << channel);
+			} else if (result == MEMS_COLLECT_NO_DATA) {
+				pending &= ~(1u << channel);
+				debugPrint("No %s samples since the last measurement", channels[channel].name);
+			} else if (elapsedMs >= MEMS_DRDY_TIMEOUT_MS) {
+				channelStats[channel].timeouts++;
+				pending &= ~(1u << channel);
+				debugPrint("No %s data after %lu ms!", channels[channel].name, elapsedMs);
+			}
+		}
+	}
+
+	fuse_temperature(measurement);
+
+	uint32_t const elapsedCycles = DWT->CYCCNT - startCycles;
+	measurement->latencyUs = cycles_to_us(elapsedCycles);
+	update_measurement_stats(measurement, i2cTransactions - startTransactions,
+			cycles_to_us(i2cBusCycles - startBusCycles), cycles_to_us(elapsedCycles - sleptCycles));
+}
+
+// Oversampled pressure is averaged over the whole measurement interval, the window
+// is closed only when the measurement is stored
+static void restart_oversampling(MemsMeasurement const* measurement) {
+#if LPS22HB_FIFO_OVERSAMPLING
+	if (measurement->validChannels & (1u << MEMS_CHANNEL_PRESSURE)) {
+		fifoStats.decimations++;
+		memset(&pressureAccumulator, 0, sizeof(PressureAccumulator));
+	}
+#else
+	UNUSED(measurement);
+#endif
+}
+
+void mems_measure(MemsMeasurement* measurement) {
+	measure(measurement);
+	restart_oversampling(measurement);
+}
+
+void mems_sample(MemsMeasurement* measurement) {
+	measure(measurement);
+}
+
+void mems_process() {
+#if LPS22HB_FIFO_OVERSAMPLING
+	// There's no interrupt line from the sensors, the watermark time is known from the ODR instead
+	if ((int32_t) (HAL_GetTick() - nextFifoDrainTick) < 0) {
+		return;
+	}
+	nextFifoDrainTick = HAL_GetTick() + LPS22HB_FIFO_DRAIN_MS;
+	if (drain_pressure_fifo() != LPS22HB_OK) {
+		debugPrint("Couldn't read LPS22HB FIFO!");
+	}
+#endif
+}
+
+MemsChannelStats get_mems_channel_stats(MemsChannel channel) {
+	return channelStats[channel];
+}
+
+MemsMeasurementStats get_mems_measurement_stats() {
+	return measurementStats;
+}
+
+MemsFifoStats get_mems_fifo_stats() {
+	return fifoStats;
+}
+
+MemsTemperatureStats get_mems_temperature_stats() {
+	return temperatureStats;
+}
+
+void mems_print_stats() {
+	for (uint8_t channel = 0; channel < MEMS_CHANNELS; channel++) {
+		MemsChannelStats const* stats = &channelStats[channel];
+		uint32_t const averageLatency = stats->acquisitions > 0 ? (uint32_t) (stats->latencyUs / stats->acquisitions) : 0;
+		// @formatter:off
+		printf("MEMS %s: %lu acquisitions, %lu DRDY polls, %lu timeouts, conversion %lu us avg, %lu us max\n",
+				channels[channel].name, stats->acquisitions, stats->drdyPolls, stats->timeouts, averageLatency,
+				stats->maxLatencyUs);
+		// @formatter:on
+	}
+
+#if LPS22HB_FIFO_OVERSAMPLING
+	// @formatter:off
+	printf("MEMS pressure FIFO: %u Hz, %lu drains, %lu samples, %lu per stored value avg, max level %lu, %lu overruns, "
+			"%lu empty\n", LPS22HB_FIFO_ODR_HZ, fifoStats.drains, fifoStats.samples,
+			fifoStats.decimations > 0 ? fifoStats.samples / fifoStats.decimations : 0, fifoStats.maxLevel,
+			fifoStats.overruns, fifoStats.empty);
+	// @formatter:on
+#endif
+
+	MemsTemperatureStats const* temperature = &temperatureStats;
+	if (temperature->fusions > 0) {
+		// @formatter:off
+		printf("MEMS temperature %s: %lu done, spread %lu avg, %lu max (0.01 *C), rejected STTS751 %lu/%lu, LPS22HB %lu/%lu, HTS221 %lu/%lu\n",
+				MEMS_TEMPERATURE_FUSION ? "fusion" : "cross-check", temperature->fusions,
+				(uint32_t) (temperature->spreadSum / temperature->fusions), temperature->maxSpread,
+				temperature->rejections[MEMS_CHANNEL_TEMPERATURE], temperature->sources[MEMS_CHANNEL_TEMPERATURE],
+				temperature->rejections[MEMS_CHANNEL_PRESSURE], temperature->sources[MEMS_CHANNEL_PRESSURE],
+				temperature->rejections[MEMS_CHANNEL_HUMIDITY], temperature->sources[MEMS_CHANNEL_HUMIDITY]);
+		// @formatter:on
+	}
+
+	MemsMeasurementStats const* stats = &measurementStats;
+	if (stats->measurements == 0) {
+		return;
+	}
+	// @formatter:off
+	printf("MEMS measurement: %lu done, %lu I2C transactions avg, bus time %lu us avg, %lu us max, CPU busy %lu us avg, latency %lu us avg, %lu us max, channels sampled within %lu us (%s)\n",
+			stats->measurements, stats->i2cTransactions / stats->measurements,
+			(uint32_t) (stats->busUs / stats->measurements), stats->maxBusUs,
+			(uint32_t) (stats->busyUs / stats->measurements), (uint32_t) (stats->latencyUs / stats->measurements),
+			stats->maxLatencyUs, stats->maxSkewUs, MEMS_BUSY_POLLING ? "busy polling" : "sleeping until conversion is done");
+	// @formatter:on
 }
 
 int32_t get_tick_wrap() {
 	return HAL_GetTick();
 }
 
+#if LPS22HB_FIFO_OVERSAMPLING
+static int32_t config_pressure_fifo() {
+	int32_t status = LPS22HB_PRESS_SetOutputDataRate(&lps, (float) LPS22HB_FIFO_ODR_HZ);
+	if (status != LPS22HB_OK) {
+		debugPrint("Error while setting LPS22HB output data rate: %ld", status);
+		return status;
+	}
+
+	status = LPS22HB_FIFO_Usage(&lps, PROPERTY_ENABLE);
+	if (status == LPS22HB_OK) {
+		status = LPS22HB_FIFO_Set_Watermark_Level(&lps, LPS22HB_FIFO_WATERMARK);
+	}
+	if (status == LPS22HB_OK) {
+		status = LPS22HB_FIFO_Set_Mode(&lps, LPS22HB_STREAM_MODE);
+	}
+	if (status != LPS22HB_OK) {
+		debugPrint("Error while setting LPS22HB FIFO stream mode: %ld", status);
+		return status;
+	}
+
+	nextFifoDrainTick = HAL_GetTick() + LPS22HB_FIFO_DRAIN_MS;
+	debugPrint("LPS22HB streaming at %u Hz, FIFO drained every %u ms", LPS22HB_FIFO_ODR_HZ, LPS22HB_FIFO_DRAIN_MS);
+	return LPS22HB_OK;
+}
+#endif
+
 int32_t mems_config() {
 	int32_t status = 0;
 
@@ -80,11 +685,13 @@ int32_t mems_config() {
 		return status;
 	}
 
+#if !LPS22HB_FIFO_OVERSAMPLING
 	status = LPS22HB_Set_One_Shot(&lps);
 	if (status != LPS22HB_OK) {
 		debugPrint("Error while setting LPS22HB one shot mode: %ld", status);
 		return status;
 	}
+#endif
 
 	status = LPS22HB_PRESS_Enable(&lps);
 	if (status != LPS22HB_OK) {
@@ -92,6 +699,20 @@ int32_t mems_config() {
 		return status;
 	}
 
+#if LPS22HB_FIFO_OVERSAMPLING
+	status = config_pressure_fifo();
+	if (status != LPS22HB_OK) {
+		return status;
+	}
+#endif
+
+	// LPS22HB_Init() turns it off for I2C, burst reads of the output registers need it
+	status = lps22hb_auto_add_inc_set(&lps.Ctx, PROPERTY_ENABLE);
+	if (status != LPS22HB_OK) {
+		debugPrint("Error while enabling LPS22HB register address auto-increment: %ld", status);
+		return status;
+	}
+
 	status = STTS751_Set_One_Shot(&stts);
 	if (status != STTS751_OK) {
 		debugPrint("Error while setting STTS751 one shot mode: %ld", status);
@@ -109,13 +730,13 @@ int32_t mems_config() {
 
 void mems_init() {
 	HTS221_IO_t hts_io = { .Init = BSP_I2C1_Init, .DeInit = BSP_I2C1_DeInit, .BusType = 0, .Address = 0xBE, .WriteReg =
-			BSP_I2C1_WriteReg, .ReadReg = BSP_I2C1_ReadReg, .GetTick = get_tick_wrap };
+			counted_write_reg, .ReadReg = counted_read_reg, .GetTick = get_tick_wrap };
 
 	LPS22HB_IO_t lps_io = { .Init = BSP_I2C1_Init, .DeInit = BSP_I2C1_DeInit, .BusType = 0, .Address = 0xBA, .WriteReg =
-			BSP_I2C1_WriteReg, .ReadReg = BSP_I2C1_ReadReg, .GetTick = get_tick_wrap };
+			counted_write_reg, .ReadReg = counted_read_reg, .GetTick = get_tick_wrap };
 
 	STTS751_IO_t stts_io = { .Init = BSP_I2C1_Init, .DeInit = BSP_I2C1_DeInit, .BusType = 0, .Address = 0x94,
-			.WriteReg = BSP_I2C1_WriteReg, .ReadReg = BSP_I2C1_ReadReg, .GetTick = get_tick_wrap };
+			.WriteReg = counted_write_reg, .ReadReg = counted_read_reg, .GetTick = get_tick_wrap };
 
 	int32_t retval = HTS221_RegisterBusIO(&hts, &hts_io);
 	if (retval != HTS221_OK) {
@@ -159,6 +780,14 @@ void mems_init() {
 		debugPrint("STTS751 init successful!");
 	}
 
+	retval = read_hts_calibration();
+	if (retval != HTS221_OK) {
+		debugPrint("Couldn't read HTS221 calibration, humidity won't be measured!");
+	} else {
+		debugPrint("HTS221 calibration: %d%% x2 at %d, %d%% x2 at %d", htsCalibration.h0RhX2, htsCalibration.h0T0Out,
+				htsCalibration.h1RhX2, htsCalibration.h1T0Out);
+	}
+
 	retval = mems_config();
 	if (retval != 0) {
 		debugPrint("There was an issue with MEMS configuration!");
@@ -0,0 +1,212 @@
+/*
+ * pressure_trend.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: steelph0enix
+ */
+
+#include "pressure_trend.h"
+
+#include <string.h>
+
+// Samples are averaged over buckets of this length, regression runs on the buckets,
+// so the history has fixed size no matter how often the measurements are made
+#define BUCKET_MS (5u * 60u * 1000u)
+#define BUCKETS_PER_HOUR 12
+#define HISTORY_BUCKETS (3 * BUCKETS_PER_HOUR)
+
+// Regression needs a few points and at least half of the window to have passed since they started coming
+#define MIN_WINDOW_SAMPLES 3
+
+// Zambretti steady band, 1.6 hPa in 3 hours
+#define STEADY_CHANGE_3H 160
+
+// Forecast numbers 1-9 are for falling, 10-19 for steady and 20-32 for rising pressure
+static char const zambrettiLetters[] = "ABDHORUXZ" "ABEKNPSWXZ" "ABCFGIJLMQTYZ";
+
+typedef enum TrendWindowId_t {
+	TREND_WINDOW_1H,
+	TREND_WINDOW_3H,
+	TREND_WINDOWS
+} TrendWindowId;
+
+// Least squares sums of the valid buckets in the window, x is the bucket position (0 is the oldest).
+// When the window slides, the leaving bucket is removed and all x move down by one, which only
+// takes a few operations on the sums, so nothing is summed again.
+typedef struct TrendWindow_t {
+	uint8_t length;   // buckets
+	int32_t count;
+	int64_t sumX;
+	int64_t sumXX;
+	int64_t sumY;
+	int64_t sumXY;
+} TrendWindow;
+
+typedef struct PressureBucket_t {
+	int32_t pressure; // average, 0.01 hPa
+	bool isValid;     // there was a measurement in it
+} PressureBucket;
+
+static PressureBucket history[HISTORY_BUCKETS] = { 0 };
+static uint8_t newest = HISTORY_BUCKETS - 1;
+static uint32_t bucketsClosed = 0;
+
+static TrendWindow windows[TREND_WINDOWS] = { 0 };
+
+static int64_t bucketSum = 0;
+static uint32_t bucketSamples = 0;
+static uint32_t bucketElapsedMs = 0;
+static uint32_t lastTick = 0;
+static bool isStarted = false;
+
+static int64_t divide_rounded(int64_t numerator, int64_t denominator) {
+	if (denominator < 0) {
+		numerator = -numerator;
+		denominator = -denominator;
+	}
+	int64_t const half = denominator / 2;
+	return (numerator >= 0 ? numerator + half : numerator - half) / denominator;
+}
+
+static PressureBucket const* bucket_at_age(uint8_t age) {
+	return &history[(newest + HISTORY_BUCKETS - age) % HISTORY_BUCKETS];
+}
+
+static void slide_window(TrendWindow* window, PressureBucket const* leaving, PressureBucket const* entering) {
+	// Leaving bucket is at x = 0, it only counts in the count and sum of y
+	if (leaving->isValid) {
+		window->count--;
+		window->sumY -= leaving->pressure;
+	}
+
+	// sum((x - 1)^2) = sum(x^2) - 2 sum(x) + n, sum((x - 1) y) = sum(x y) - sum(y)
+	window->sumXX += window->count - 2 * window->sumX;
+	window->sumX -= window->count;
+	window->sumXY -= window->sumY;
+
+	if (entering->isValid) {
+		int64_t const x = window->length - 1;
+		window->count++;
+		window->sumX += x;
+		window->sumXX += x * x;
+		window->sumY += entering->pressure;
+		window->sumXY += x * entering->pressure;
+	}
+}
+
+static void close_bucket() {
+	PressureBucket bucket = { 0 };
+	if (bucketSamples > 0) {
+		bucket.pressure = (int32_t) divide_rounded(bucketSum, bucketSamples);
+		bucket.isValid = true;
+	}
+
+	for (uint8_t id = 0; id < TREND_WINDOWS; id++) {
+		slide_window(&windows[id], bucket_at_age(windows[id].length - 1), &bucket);
+	}
+
+	newest = (newest + 1) % HISTORY_BUCKETS;
+	history[newest] = bucket;
+	if (bucketsClosed < UINT32_MAX) {
+		bucketsClosed++;
+	}
+	bucketSum = 0;
+	bucketSamples = 0;
+}
+
+void pressure_trend_reset() {
+	memset(history, 0, sizeof(history));
+	memset(windows, 0, sizeof(windows));
+	windows[TREND_WINDOW_1H].length = BUCKETS_PER_HOUR;
+	windows[TREND_WINDOW_3H].length = HISTORY_BUCKETS;
+	newest = HISTORY_BUCKETS - 1;
+	bucketsClosed = 0;
+	bucketSum = 0;
+	bucketSamples = 0;
+	bucketElapsedMs = 0;
+	isStarted = false;
+}
+
+void pressure_trend_add(int32_t pressure, uint32_t tick) {
+	if (!isStarted) {
+		pressure_trend_reset();
+		isStarted = true;
+	} else {
+		bucketElapsedMs += tick - lastTick;
+		uint32_t const buckets = bucketElapsedMs / BUCKET_MS;
+		bucketElapsedMs %= BUCKET_MS;
+
+		// After a gap longer than the history only empty buckets are left, sliding further changes nothing
+		for (uint32_t i = 0; i < buckets && i < HISTORY_BUCKETS; i++) {
+			close_bucket();
+		}
+		if (buckets > HISTORY_BUCKETS) {
+			bucketsClosed += buckets - HISTORY_BUCKETS;
+		}
+	}
+
+	lastTick = tick;
+	bucketSum += pressure;
+	bucketSamples++;
+}
+
+static int16_t clamp_16bit(int64_t value) {
+	return value > INT16_MAX ? INT16_MAX : (value < INT16_MIN ? INT16_MIN : (int16_t) value);
+}
+
+// Slope of the regression line scaled to given number of buckets, false if it can't be trusted yet
+static bool window_change(TrendWindow const* window, int32_t buckets, int16_t* change) {
+	int64_t const n = window->count;
+	int64_t const denominator = n * window->sumXX - window->sumX * window->sumX;
+	if (n < MIN_WINDOW_SAMPLES || bucketsClosed < window->length / 2u || denominator <= 0) {
+		return false;
+	}
+
+	int64_t const numerator = n * window->sumXY - window->sumX * window->sumY;
+	*change = clamp_16bit(divide_rounded(numerator * buckets, denominator));
+	return true;
+}
+
+static int32_t clamp(int32_t value, int32_t min, int32_t max) {
+	return value < min ? min : (value > max ? max : value);
+}
+
+// Negretti & Zambra's forecaster, without the wind direction and season corrections:
+// falling Z = 127 - 0.12 P, steady Z = 144 - 0.13 P, rising Z = 185 - 0.16 P, P in hPa
+static char zambretti(int32_t sea_level_pressure, PressureTendency tendency) {
+	int32_t number = 0;
+	switch (tendency) {
+	case PRESSURE_TENDENCY_FALLING:
+		number = clamp(divide_rounded(1270000 - 12ll * sea_level_pressure, 10000), 1, 9);
+		break;
+	case PRESSURE_TENDENCY_STEADY:
+		number = clamp(divide_rounded(1440000 - 13ll * sea_level_pressure, 10000), 10, 19);
+		break;
+	case PRESSURE_TENDENCY_RISING:
+		number = clamp(divide_rounded(1850000 - 16ll * sea_level_pressure, 10000), 20, 32);
+		break;
+	default:
+		return PRESSURE_FORECAST_UNKNOWN;
+	}
+	return zambrettiLetters[number - 1];
+}
+
+PressureTrend pressure_trend_get(int32_t sea_level_pressure) {
+	PressureTrend trend = { 0 };
+	trend.isValid1h = window_change(&windows[TREND_WINDOW_1H], BUCKETS_PER_HOUR, &trend.change1h);
+	trend.isValid3h = window_change(&windows[TREND_WINDOW_3H], HISTORY_BUCKETS, &trend.change3h);
+
+	// Until there's 3 hours of history, the last hour is extrapolated
+	int32_t const change3h = trend.isValid3h ? trend.change3h : trend.change1h * 3;
+	if (trend.isValid3h || trend.isValid1h) {
+		if (change3h <= -STEADY_CHANGE_3H) {
+			trend.tendency = PRESSURE_TENDENCY_FALLING;
+		} else if (change3h >= STEADY_CHANGE_3H) {
+			trend.tendency = PRESSURE_TENDENCY_RISING;
+		} else {
+			trend.tendency = PRESSURE_TENDENCY_STEADY;
+		}
+	}
+	trend.forecast = zambretti(sea_level_pressure, trend.tendency);
+	return trend;
+}
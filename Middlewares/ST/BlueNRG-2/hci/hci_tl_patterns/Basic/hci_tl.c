@@ -20,7 +20,12 @@
 #include "hci.h"
 #include "hci_tl.h"
 
-#define HCI_LOG_ON                      0
+#ifndef HCI_LOG_ON
+  #define HCI_LOG_ON                    0
+#endif
+#if HCI_LOG_ON
+  #include "hci_snoop.h"
+#endif
 #define HCI_PCK_TYPE_OFFSET             0
 #define EVENT_PARAMETER_TOT_LEN_OFFSET  2
 
@@ -39,11 +44,44 @@
   #define MAX(a,b)      ((a) > (b))? (a) : (b)
 #endif
 
-tListNode             hciReadPktPool;
-tListNode             hciReadPktRxQueue;
+/**
+ * Packets are passed between the ISR and the task by their index in hciReadPacketBuffer,
+ * through two lock-free single-producer/single-consumer rings:
+ * - hciReadPktPool: free packets, filled by the task, drained by the ISR
+ * - hciReadPktRxQueue: received packets, filled by the ISR, drained by the task
+ * Ring size is the smallest power of two able to hold all the packets, so a ring
+ * can never overflow.
+ */
+#if HCI_READ_PACKET_NUM_MAX <= 8
+  #define HCI_PKT_RING_SIZE            (8)
+#elif HCI_READ_PACKET_NUM_MAX <= 16
+  #define HCI_PKT_RING_SIZE            (16)
+#elif HCI_READ_PACKET_NUM_MAX <= 32
+  #define HCI_PKT_RING_SIZE            (32)
+#elif HCI_READ_PACKET_NUM_MAX <= 64
+  #define HCI_PKT_RING_SIZE            (64)
+#elif HCI_READ_PACKET_NUM_MAX <= 128
+  #define HCI_PKT_RING_SIZE            (128)
+#else
+  #error "HCI_READ_PACKET_NUM_MAX is too big"
+#endif
+
+tBleRing              hciReadPktPool;
+tBleRing              hciReadPktRxQueue;
+static uint8_t        hciReadPktPoolSlots[HCI_PKT_RING_SIZE];
+static uint8_t        hciReadPktRxQueueSlots[HCI_PKT_RING_SIZE];
 static tHciDataPacket hciReadPacketBuffer[HCI_READ_PACKET_NUM_MAX];
 static tHciContext    hciContext;
 
+/**
+ * Pool statistics. Each counter has a single writer: high_water_mark, exhausted
+ * and invalid are updated by the ISR, recycled by the task.
+ */
+static volatile uint32_t hciPoolHighWaterMark;
+static volatile uint32_t hciPoolExhausted;
+static volatile uint32_t hciPoolRecycled;
+static volatile uint32_t hciPoolInvalid;
+
 /************************* Static internal functions **************************/
 
 /**
@@ -86,6 +124,10 @@ static void send_cmd(uint16_t ogf, uint16_t ocf, uint8_t plen, void *param)
   BLUENRG_memcpy(payload + 1, &hc, sizeof(hc));
   BLUENRG_memcpy(payload + HCI_HDR_SIZE + HCI_COMMAND_HDR_SIZE, param, plen);
   
+#if HCI_LOG_ON
+  hci_snoop_capture(payload, HCI_HDR_SIZE + HCI_COMMAND_HDR_SIZE + plen, FALSE);
+#endif
+
   if (hciContext.io.Send)
   {
     hciContext.io.Send (payload, HCI_HDR_SIZE + HCI_COMMAND_HDR_SIZE + plen);
@@ -93,21 +135,19 @@ static void send_cmd(uint16_t ogf, uint16_t ocf, uint8_t plen, void *param)
 }
 
 /**
-  * @brief  Remove the tail from a source list and insert it to the head 
-  *         of a destination list.
+  * @brief  Give the packets held aside back to the front of the RX queue,
+  *         preserving their order.
   *
-  * @param  dest_list
-  * @param  src_list
+  * @param  pckts Indexes of the packets
+  * @param  count Number of packets
   * @retval None
   */
-static void move_list(tListNode * dest_list, tListNode * src_list)
+static void return_to_rx_queue(const uint8_t * pckts, uint8_t count)
 {
-  pListNode tmp_node;
-  
-  while (!list_is_empty(src_list))
+  while (count > 0)
   {
-    list_remove_tail(src_list, &tmp_node);
-    list_insert_head(dest_list, tmp_node);
+    count--;
+    ble_ring_push_front(&hciReadPktRxQueue, pckts[count]);
   }
 }
 
@@ -119,11 +159,13 @@ static void move_list(tListNode * dest_list, tListNode * src_list)
   */
 static void free_event_list(void)
 {
-  tHciDataPacket * pckt;
+  uint8_t pckt;
 
-  while(list_get_size(&hciReadPktPool) < HCI_READ_PACKET_NUM_MAX/2){
-    list_remove_head(&hciReadPktRxQueue, (tListNode **)&pckt);    
-    list_insert_tail(&hciReadPktPool, (tListNode *)pckt);
+  while(ble_ring_get_size(&hciReadPktPool) < HCI_READ_PACKET_NUM_MAX/2){
+    if (!ble_ring_pop(&hciReadPktRxQueue, &pckt))
+      break;
+    ble_ring_push(&hciReadPktPool, pckt);
+    hciPoolRecycled++;
   }
 }
 
@@ -138,17 +180,26 @@ void hci_init(void(* UserEvtRx)(void* pData), void* pConf)
     hciContext.UserEvtRx = UserEvtRx;
   }
   
-  /* Initialize list heads of ready and free hci data packet queues */
-  list_init_head(&hciReadPktPool);
-  list_init_head(&hciReadPktRxQueue);
+  hciPoolHighWaterMark = 0;
+  hciPoolExhausted = 0;
+  hciPoolRecycled = 0;
+  hciPoolInvalid = 0;
+
+  /* Initialize ready and free hci data packet queues */
+  ble_ring_init(&hciReadPktPool, hciReadPktPoolSlots, HCI_PKT_RING_SIZE);
+  ble_ring_init(&hciReadPktRxQueue, hciReadPktRxQueueSlots, HCI_PKT_RING_SIZE);
 
   /* Initialize TL BLE layer */
   hci_tl_lowlevel_init();
 
+#if HCI_LOG_ON
+  hci_snoop_init();
+#endif
+
   /* Initialize the queue of free hci data packets */
   for (index = 0; index < HCI_READ_PACKET_NUM_MAX; index++)
   {
-    list_insert_tail(&hciReadPktPool, (tListNode *)&hciReadPacketBuffer[index]);
+    ble_ring_push(&hciReadPktPool, index);
   } 
   
   /* Initialize low level driver */
@@ -174,9 +225,9 @@ int hci_send_req(struct hci_request* r, BOOL async)
   hci_spi_pckt *hci_hdr;
 
   tHciDataPacket * hciReadPacket = NULL;
-  tListNode hciTempQueue;
-  
-  list_init_head(&hciTempQueue);
+  uint8_t hciReadPacketIndex = 0;
+  uint8_t hciTempQueue[HCI_READ_PACKET_NUM_MAX];
+  uint8_t hciTempQueueSize = 0;
 
   free_event_list();
   
@@ -203,14 +254,14 @@ int hci_send_req(struct hci_request* r, BOOL async)
         goto failed;
       }
       
-      if (!list_is_empty(&hciReadPktRxQueue)) 
+      /* Extract packet from HCI event queue. */
+      if (ble_ring_pop(&hciReadPktRxQueue, &hciReadPacketIndex))
       {
         break;
       }
     }
     
-    /* Extract packet from HCI event queue. */
-    list_remove_head(&hciReadPktRxQueue, (tListNode **)&hciReadPacket);    
+    hciReadPacket = &hciReadPacketBuffer[hciReadPacketIndex];
     
     hci_hdr = (void *)hciReadPacket->dataBuff;
 
@@ -276,8 +327,8 @@ int hci_send_req(struct hci_request* r, BOOL async)
        packet in the pool to process the expected event.
        If no free packets are available, discard the processed event and insert it
        into the pool. */
-    if (list_is_empty(&hciReadPktPool) && list_is_empty(&hciReadPktRxQueue)) {
-      list_insert_tail(&hciReadPktPool, (tListNode *)hciReadPacket);
+    if (ble_ring_is_empty(&hciReadPktPool) && ble_ring_is_empty(&hciReadPktRxQueue)) {
+      ble_ring_push(&hciReadPktPool, hciReadPacketIndex);
       hciReadPacket=NULL;
     }
     else {
@@ -285,56 +336,66 @@ int hci_send_req(struct hci_request* r, BOOL async)
       inserted back in the main queue just before exiting from send_req(), so that
       these events can be processed by the application.
     */
-    list_insert_tail(&hciTempQueue, (tListNode *)hciReadPacket);
+    hciTempQueue[hciTempQueueSize++] = hciReadPacketIndex;
       hciReadPacket=NULL;
     }
   }
   
 failed: 
   if (hciReadPacket!=NULL) {
-    list_insert_head(&hciReadPktPool, (tListNode *)hciReadPacket);
+    ble_ring_push(&hciReadPktPool, hciReadPacketIndex);
   }
-  move_list(&hciReadPktRxQueue, &hciTempQueue);
+  return_to_rx_queue(hciTempQueue, hciTempQueueSize);
 
   return -1;
   
 done:
   /* Insert the packet back into the pool.*/
-  list_insert_head(&hciReadPktPool, (tListNode *)hciReadPacket); 
-  move_list(&hciReadPktRxQueue, &hciTempQueue);
+  ble_ring_push(&hciReadPktPool, hciReadPacketIndex);
+  return_to_rx_queue(hciTempQueue, hciTempQueueSize);
 
   return 0;
 }
 
 void hci_user_evt_proc(void)
 {
-  tHciDataPacket * hciReadPacket = NULL;
+  uint8_t hciReadPacketIndex;
      
   /* process any pending events read */
-  while (list_is_empty(&hciReadPktRxQueue) == FALSE)
+  while (ble_ring_pop(&hciReadPktRxQueue, &hciReadPacketIndex))
   {
-    list_remove_head (&hciReadPktRxQueue, (tListNode **)&hciReadPacket);
-
     if (hciContext.UserEvtRx != NULL)
     {
-      hciContext.UserEvtRx(hciReadPacket->dataBuff);
+      hciContext.UserEvtRx(hciReadPacketBuffer[hciReadPacketIndex].dataBuff);
     }
 
-    list_insert_tail(&hciReadPktPool, (tListNode *)hciReadPacket);
+    ble_ring_push(&hciReadPktPool, hciReadPacketIndex);
   }
 }
 
+void hci_get_pool_stats(tHciPoolStats * stats)
+{
+  stats->pool_size = HCI_READ_PACKET_NUM_MAX;
+  stats->in_use = HCI_READ_PACKET_NUM_MAX - ble_ring_get_size(&hciReadPktPool);
+  stats->high_water_mark = hciPoolHighWaterMark;
+  stats->exhausted = hciPoolExhausted;
+  stats->recycled = hciPoolRecycled;
+  stats->invalid = hciPoolInvalid;
+}
+
 int32_t hci_notify_asynch_evt(void* pdata)
 {
   tHciDataPacket * hciReadPacket = NULL;
+  uint8_t hciReadPacketIndex;
   uint8_t data_len;
   
   int32_t ret = 0;
   
-  if (list_is_empty (&hciReadPktPool) == FALSE)
+  /* Packet is taken from the pool only once it holds a valid event,
+     otherwise it stays at the front of the pool */
+  if (ble_ring_peek(&hciReadPktPool, &hciReadPacketIndex))
   {
-    /* Queuing a packet to read */
-    list_remove_head (&hciReadPktPool, (tListNode **)&hciReadPacket);
+    hciReadPacket = &hciReadPacketBuffer[hciReadPacketIndex];
     
     if (hciContext.io.Receive)
     {
@@ -342,20 +403,32 @@ int32_t hci_notify_asynch_evt(void* pdata)
       if (data_len > 0)
       {                    
         hciReadPacket->data_len = data_len;
+#if HCI_LOG_ON
+        hci_snoop_capture(hciReadPacket->dataBuff, data_len, TRUE);
+#endif
         if (verify_packet(hciReadPacket) == 0)
-          list_insert_tail(&hciReadPktRxQueue, (tListNode *)hciReadPacket);
+        {
+          uint32_t in_use;
+
+          ble_ring_drop(&hciReadPktPool);
+          ble_ring_push(&hciReadPktRxQueue, hciReadPacketIndex);
+
+          in_use = HCI_READ_PACKET_NUM_MAX - ble_ring_get_size(&hciReadPktPool);
+          if (in_use > hciPoolHighWaterMark)
+          {
+            hciPoolHighWaterMark = in_use;
+          }
+        }
         else
-          list_insert_head(&hciReadPktPool, (tListNode *)hciReadPacket);          
-      }
-      else 
-      {
-        /* Insert the packet back into the pool*/
-        list_insert_head(&hciReadPktPool, (tListNode *)hciReadPacket);
+        {
+          hciPoolInvalid++;
+        }
       }
     }
   }
   else 
   {
+    hciPoolExhausted++;
     ret = 1;
   }
   return ret;
@@ -21,6 +21,7 @@
 #include "hci_tl_interface.h"
 #include "ble_types.h"
 #include "ble_list.h"
+#include "ble_ring.h"
 #include "bluenrg_conf.h"
 
 /** 
@@ -92,6 +93,23 @@ typedef struct
  * @}
  */
 
+/**
+ * @brief Statistics of the HCI read packet pool
+ * @{
+ */
+typedef struct
+{
+  uint32_t pool_size;       /**< Number of packets in the pool (HCI_READ_PACKET_NUM_MAX) */
+  uint32_t in_use;          /**< Packets currently queued or being processed */
+  uint32_t high_water_mark; /**< Maximum number of packets in use at the same time */
+  uint32_t exhausted;       /**< Times an event was left in BlueNRG because the pool was empty */
+  uint32_t recycled;        /**< Queued events discarded without processing to refill the pool */
+  uint32_t invalid;         /**< Received packets discarded by verification */
+} tHciPoolStats;
+/**
+ * @}
+ */
+
 /**
  * @brief Describe the HCI flow status
  * @{
@@ -192,6 +210,16 @@ void hci_register_io_bus(tHciIO* fops);
  */
 int32_t hci_notify_asynch_evt(void* pdata);
 
+/**
+ * @brief  Get the statistics of the HCI read packet pool.
+ *         Use the high water mark to size HCI_READ_PACKET_NUM_MAX
+ *         (see HCI_POOL_OBSERVED_PEAK in bluenrg_conf.h).
+ *
+ * @param  stats Destination of the statistics
+ * @retval None
+ */
+void hci_get_pool_stats(tHciPoolStats * stats);
+
 /**
  * @brief  This function resume the User Event Flow which has been stopped on return 
  *         from UserEvtRx() when the User Event has not been processed.
@@ -0,0 +1,128 @@
+/**
+  ******************************************************************************
+  * @file    ble_ring.c
+  * @brief   Lock-free single-producer/single-consumer ring implementation.
+  ******************************************************************************
+  * @attention
+  *
+  * Head and tail are free-running counters, the slot is selected by masking
+  * them with the storage size. The ring is empty when head == tail and full
+  * when head - tail == size.
+  *
+  ******************************************************************************
+  */
+
+/******************************************************************************
+ * Include Files
+******************************************************************************/
+#include "ble_ring.h"
+
+/******************************************************************************
+ * Function Definitions
+******************************************************************************/
+void ble_ring_init (tBleRing * ring, uint8_t * storage, uint32_t size)
+{
+  ring->slots = storage;
+  ring->mask = size - 1;
+  atomic_init(&ring->head, 0);
+  atomic_init(&ring->tail, 0);
+}
+
+uint8_t ble_ring_is_empty (tBleRing * ring)
+{
+  return ble_ring_get_size(ring) == 0;
+}
+
+uint32_t ble_ring_get_size (tBleRing * ring)
+{
+  uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+  uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+  return head - tail;
+}
+
+/**
+  * @brief  Append an item at the end of the ring. Producer only.
+  * @retval 1 if item was stored, 0 if the ring is full
+  */
+uint8_t ble_ring_push (tBleRing * ring, uint8_t item)
+{
+  uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+  if ((head - tail) > ring->mask)
+  {
+    return 0;
+  }
+
+  ring->slots[head & ring->mask] = item;
+  atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+  return 1;
+}
+
+/**
+  * @brief  Read the first item without removing it. Consumer only.
+  * @retval 1 if item was read, 0 if the ring is empty
+  */
+uint8_t ble_ring_peek (tBleRing * ring, uint8_t * item)
+{
+  uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+  if (head == tail)
+  {
+    return 0;
+  }
+
+  *item = ring->slots[tail & ring->mask];
+  return 1;
+}
+
+/**
+  * @brief  Remove the first item, previously read with ble_ring_peek. Consumer only.
+  */
+void ble_ring_drop (tBleRing * ring)
+{
+  uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+  atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+/**
+  * @brief  Read and remove the first item. Consumer only.
+  * @retval 1 if item was read, 0 if the ring is empty
+  */
+uint8_t ble_ring_pop (tBleRing * ring, uint8_t * item)
+{
+  if (!ble_ring_peek(ring, item))
+  {
+    return 0;
+  }
+
+  ble_ring_drop(ring);
+  return 1;
+}
+
+/**
+  * @brief  Give an item back to the front of the ring. Consumer only.
+  *         The producer can fill the ring between the check below and the
+  *         write, then both write the slot in front of the tail. Only safe
+  *         when the items in circulation can't fill the ring, like packet
+  *         indexes in a ring that holds every packet.
+  * @retval 1 if item was stored, 0 if the ring is full
+  */
+uint8_t ble_ring_push_front (tBleRing * ring, uint8_t item)
+{
+  uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+  if ((head - tail) > ring->mask)
+  {
+    return 0;
+  }
+
+  tail--;
+  ring->slots[tail & ring->mask] = item;
+  atomic_store_explicit(&ring->tail, tail, memory_order_release);
+  return 1;
+}
@@ -0,0 +1,43 @@
+/**
+  ******************************************************************************
+  * @file    ble_ring.h
+  * @brief   Header file for lock-free single-producer/single-consumer ring.
+  ******************************************************************************
+  * @attention
+  *
+  * The ring stores 8-bit item indexes. Exactly one context (e.g. an ISR) may
+  * call the producer functions and exactly one context (e.g. a task) may call
+  * the consumer functions. No interrupt masking is used, synchronisation
+  * relies only on the acquire/release ordering of the head and tail indexes.
+  *
+  ******************************************************************************
+  */
+
+#ifndef __BLE_RING_H_
+#define __BLE_RING_H_
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+typedef struct _tBleRing {
+  atomic_uint head;   /**< Write index, modified by the producer only */
+  atomic_uint tail;   /**< Read index, modified by the consumer only */
+  uint8_t *   slots;  /**< Item storage, size must be a power of two */
+  uint32_t    mask;   /**< Storage size - 1 */
+} tBleRing;
+
+/* Common */
+void ble_ring_init (tBleRing * ring, uint8_t * storage, uint32_t size);
+uint8_t ble_ring_is_empty (tBleRing * ring);
+uint32_t ble_ring_get_size (tBleRing * ring);
+
+/* Producer side */
+uint8_t ble_ring_push (tBleRing * ring, uint8_t item);
+
+/* Consumer side */
+uint8_t ble_ring_peek (tBleRing * ring, uint8_t * item);
+void ble_ring_drop (tBleRing * ring);
+uint8_t ble_ring_pop (tBleRing * ring, uint8_t * item);
+uint8_t ble_ring_push_front (tBleRing * ring, uint8_t item);
+
+#endif /* __BLE_RING_H_ */
@@ -0,0 +1,889 @@
+/*
+ * hci_sim.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: steelph0enix
+ */
+
+#include "hci_sim.h"
+#include "hci_tl.h"
+#include "hci_tl_interface.h"
+#include "hci_const.h"
+#include "bluenrg1_types.h"
+#include "bluenrg1_gatt_aci.h"
+#include "bluenrg_conf.h"
+#include "bit_helpers.h"
+
+#include <string.h>
+
+#define SIM_EVENT_QUEUE_SIZE 64
+#define SIM_MAX_SERVICES 8
+#define SIM_MAX_CHARACTERISTICS 48
+#define SIM_MAX_VALUE_LENGTH 64
+#define SIM_FIRST_HANDLE 0x0001
+#define SIM_FIRST_CONNECTION_HANDLE 0x0801
+#define SIM_MAX_ATT_MTU 247
+
+#define OPCODE(ogf, ocf) ((uint16_t) (((ogf) << 10) | (ocf)))
+#define OPCODE_HCI_RESET OPCODE(0x03, 0x003)
+#define OPCODE_ACI_GAP_SET_NON_DISCOVERABLE OPCODE(0x3F, 0x081)
+#define OPCODE_ACI_GAP_SET_DISCOVERABLE OPCODE(0x3F, 0x083)
+#define OPCODE_ACI_GAP_INIT OPCODE(0x3F, 0x08A)
+#define OPCODE_ACI_GAP_UPDATE_ADV_DATA OPCODE(0x3F, 0x08E)
+#define OPCODE_ACI_GATT_ADD_SERVICE OPCODE(0x3F, 0x102)
+#define OPCODE_ACI_GATT_ADD_CHAR OPCODE(0x3F, 0x104)
+#define OPCODE_ACI_GATT_UPDATE_CHAR_VALUE OPCODE(0x3F, 0x106)
+#define OPCODE_ACI_GATT_ALLOW_READ OPCODE(0x3F, 0x127)
+#define OPCODE_ACI_GATT_UPDATE_CHAR_VALUE_EXT OPCODE(0x3F, 0x12C)
+
+#define EVT_BLUE_INITIALIZED 0x0001
+#define EVT_ATTRIBUTE_MODIFIED 0x0C01
+#define EVT_READ_PERMIT_REQ 0x0C14
+#define EVT_READ_MULTI_PERMIT_REQ 0x0C15
+#define EVT_TX_POOL_AVAILABLE 0x0C16
+#define EVT_ATT_EXCHANGE_MTU_RESP 0x0C03
+#define EVT_LE_CONNECTION_COMPLETE 0x01
+#define EVT_DISCONNECTION_COMPLETE 0x05
+
+#define ADV_DATA_MAX_LENGTH 31
+#define SET_DISCOVERABLE_LOCAL_NAME_LENGTH_OFFSET 7
+#define SET_DISCOVERABLE_INTERVAL_MIN_OFFSET 1
+#define ADV_INTERVAL_UNIT_US 625u
+#define UPDATE_TYPE_NOTIFICATION 0x01
+
+#define STATUS_SUCCESS 0x00
+#define STATUS_COMMAND_DISALLOWED 0x0C
+#define STATUS_INVALID_PARAMS 0x12
+#define STATUS_INSUFFICIENT_RESOURCES 0x64
+
+typedef struct SimEvent_t {
+	uint64_t readyAtUs;
+	uint16_t length;
+	uint8_t data[HCI_READ_PACKET_SIZE];
+} SimEvent;
+
+typedef struct SimService_t {
+	uint16_t handle;
+	uint16_t endHandle;
+} SimService;
+
+typedef struct SimCharacteristic_t {
+	uint16_t serviceHandle;
+	uint16_t handle;
+	uint8_t uuid[16];
+	uint8_t properties;
+	uint8_t eventMask;
+	uint16_t maxLength;
+	uint16_t length;
+	uint8_t value[SIM_MAX_VALUE_LENGTH];
+} SimCharacteristic;
+
+// Link to a single central, connection handle is SIM_FIRST_CONNECTION_HANDLE + index
+typedef struct SimConnection_t {
+	bool isRequested; // central is connecting, waits for an advertising event
+	bool isConnected;
+	uint16_t handle;
+	uint64_t nextEventUs;
+	uint8_t txCredits;
+	bool isTxPoolAvailableEventPending;
+	// Reads of GATT_NOTIFY_READ_REQ_AND_WAIT_FOR_APPL_RESP characteristics wait for aci_gatt_allow_read(),
+	// read response is made from the value that was in GATT database at that moment
+	uint16_t pendingReadHandle;
+	uint16_t allowedReadHandle;
+	uint8_t allowedValue[SIM_MAX_VALUE_LENGTH];
+	uint16_t allowedLength;
+	bool notificationsEnabled[SIM_MAX_CHARACTERISTICS]; // CCCD, by characteristic index
+} SimConnection;
+
+// @formatter:off
+static HCISimConfig config = {
+		.bootTimeUs = 20000,
+		.commandLatencyUs = 150,
+		.connectionIntervalUs = 30000,
+		.txBuffers = 4
+};
+// @formatter:on
+
+static HCISimStatistics statistics = { 0 };
+static HCISimConnectionEventCallback connectionEventCallback = NULL;
+static HCISimNotificationCallback notificationCallback = NULL;
+
+static uint64_t timeUs = 0;
+static bool isIRQActive = false;
+
+static SimEvent events[SIM_EVENT_QUEUE_SIZE];
+static uint32_t eventsHead = 0;
+static uint32_t eventsTail = 0;
+
+static SimService services[SIM_MAX_SERVICES];
+static uint8_t servicesCount = 0;
+static SimCharacteristic characteristics[SIM_MAX_CHARACTERISTICS];
+static uint8_t characteristicsCount = 0;
+static uint16_t nextHandle = SIM_FIRST_HANDLE;
+
+static bool isAdvertising = false;
+static uint32_t advertisingIntervalUs = 0;
+static uint64_t advertisingStartUs = 0;
+static SimConnection connections[HCI_SIM_MAX_CONNECTIONS];
+static uint8_t advData[ADV_DATA_MAX_LENGTH];
+static uint8_t advDataLength = 0;
+
+/* Event queue */
+
+static uint8_t* push_event(uint8_t event_code, uint8_t parameters_length, uint32_t delay_us) {
+	if (eventsHead - eventsTail >= SIM_EVENT_QUEUE_SIZE || parameters_length + HCI_EVENT_HDR_SIZE + 1 > HCI_READ_PACKET_SIZE) {
+		statistics.eventsDropped++;
+		return NULL;
+	}
+
+	SimEvent* event = &events[eventsHead % SIM_EVENT_QUEUE_SIZE];
+	event->readyAtUs = timeUs + delay_us;
+	event->length = 1 + HCI_EVENT_HDR_SIZE + parameters_length;
+	event->data[0] = HCI_EVENT_PKT;
+	event->data[1] = event_code;
+	event->data[2] = parameters_length;
+	eventsHead++;
+	return &event->data[1 + HCI_EVENT_HDR_SIZE];
+}
+
+static void push_command_complete(uint16_t opcode, void const* return_parameters, uint8_t length) {
+	uint8_t* parameters = push_event(EVT_CMD_COMPLETE, EVT_CMD_COMPLETE_SIZE + length, config.commandLatencyUs);
+	if (parameters != NULL) {
+		uint8_t* opcodeBytes = &parameters[1];
+		parameters[0] = 1; // Num_HCI_Command_Packets
+		VALUE_TO_16BIT_BYTEARRAY_LE(opcode, opcodeBytes);
+		memcpy(&parameters[EVT_CMD_COMPLETE_SIZE], return_parameters, length);
+	}
+}
+
+static void push_command_status(uint16_t opcode, uint8_t status) {
+	push_command_complete(opcode, &status, 1);
+}
+
+static void push_vendor_event(uint16_t code, void const* data, uint8_t length, uint32_t delay_us) {
+	uint8_t* parameters = push_event(EVT_VENDOR, 2 + length, delay_us);
+	if (parameters != NULL) {
+		VALUE_TO_16BIT_BYTEARRAY_LE(code, parameters);
+		memcpy(&parameters[2], data, length);
+	}
+}
+
+// Connection handle, attribute handle, offset and data length, followed by the data
+static void push_attribute_modified_event(SimConnection const* connection, uint16_t attribute_handle,
+		uint8_t const* data, uint8_t length) {
+	uint8_t* parameters = push_event(EVT_VENDOR, 2 + 8 + length, 0);
+	if (parameters != NULL) {
+		uint16_t const fields[] = { EVT_ATTRIBUTE_MODIFIED, connection->handle, attribute_handle, 0, length };
+		for (uint8_t i = 0; i < 5; i++) {
+			uint8_t* field = &parameters[i * 2];
+			VALUE_TO_16BIT_BYTEARRAY_LE(fields[i], field);
+		}
+		memcpy(&parameters[10], data, length);
+	}
+}
+
+static bool is_event_ready() {
+	return eventsHead != eventsTail && events[eventsTail % SIM_EVENT_QUEUE_SIZE].readyAtUs <= timeUs;
+}
+
+/* GATT database */
+
+static SimCharacteristic* find_characteristic(uint16_t handle) {
+	for (uint8_t i = 0; i < characteristicsCount; i++) {
+		if (characteristics[i].handle == handle) {
+			return &characteristics[i];
+		}
+	}
+	return NULL;
+}
+
+static uint8_t characteristic_index(SimCharacteristic const* characteristic) {
+	return (uint8_t) (characteristic - characteristics);
+}
+
+static SimService* find_service(uint16_t handle) {
+	for (uint8_t i = 0; i < servicesCount; i++) {
+		if (services[i].handle == handle) {
+			return &services[i];
+		}
+	}
+	return NULL;
+}
+
+static uint16_t allocate_service(uint8_t max_records) {
+	if (servicesCount >= SIM_MAX_SERVICES || max_records == 0) {
+		return 0;
+	}
+
+	SimService* service = &services[servicesCount++];
+	service->handle = nextHandle;
+	service->endHandle = nextHandle + max_records - 1;
+	nextHandle += max_records;
+	return service->handle;
+}
+
+static uint8_t uuid_length(uint8_t uuid_type) {
+	return uuid_type == UUID_TYPE_16 ? 2 : 16;
+}
+
+// Characteristic takes declaration and value records, plus CCCD if it can notify or indicate
+static uint8_t characteristic_records(uint8_t properties) {
+	return (properties & (CHAR_PROP_NOTIFY | CHAR_PROP_INDICATE)) ? 3 : 2;
+}
+
+static uint16_t characteristic_end_handle(SimService const* service) {
+	uint16_t end = service->handle;
+	for (uint8_t i = 0; i < characteristicsCount; i++) {
+		if (characteristics[i].serviceHandle == service->handle) {
+			end = characteristics[i].handle + characteristic_records(characteristics[i].properties) - 1;
+		}
+	}
+	return end;
+}
+
+static uint8_t add_characteristic(uint16_t service_handle, uint8_t uuid_type, uint8_t const* uuid,
+		uint16_t max_length, uint8_t properties, uint8_t event_mask, uint16_t* handle) {
+	SimService* service = find_service(service_handle);
+	if (service == NULL || max_length > SIM_MAX_VALUE_LENGTH) {
+		return STATUS_INVALID_PARAMS;
+	}
+
+	uint16_t const characteristicHandle = characteristic_end_handle(service) + 1;
+	if (characteristicsCount >= SIM_MAX_CHARACTERISTICS
+			|| characteristicHandle + characteristic_records(properties) - 1 > service->endHandle) {
+		return STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	SimCharacteristic* characteristic = &characteristics[characteristicsCount++];
+	memset(characteristic, 0, sizeof(SimCharacteristic));
+	characteristic->serviceHandle = service_handle;
+	characteristic->handle = characteristicHandle;
+	memcpy(characteristic->uuid, uuid, uuid_length(uuid_type));
+	characteristic->properties = properties;
+	characteristic->eventMask = event_mask;
+	characteristic->maxLength = max_length;
+	*handle = characteristicHandle;
+	return STATUS_SUCCESS;
+}
+
+static uint8_t connected_count() {
+	uint8_t count = 0;
+	for (uint8_t i = 0; i < HCI_SIM_MAX_CONNECTIONS; i++) {
+		count += connections[i].isConnected;
+	}
+	return count;
+}
+
+static SimConnection* find_connection(uint16_t handle) {
+	for (uint8_t i = 0; i < HCI_SIM_MAX_CONNECTIONS; i++) {
+		if (connections[i].isConnected && connections[i].handle == handle) {
+			return &connections[i];
+		}
+	}
+	return NULL;
+}
+
+static bool should_notify(SimConnection const* connection, SimCharacteristic const* characteristic) {
+	return connection->isConnected && connection->notificationsEnabled[characteristic_index(characteristic)]
+			&& (characteristic->properties & CHAR_PROP_NOTIFY);
+}
+
+// Notification needs a TX buffer on every link it goes to, nothing is sent if one of them is full
+static bool take_tx_credits(SimCharacteristic const* characteristic, uint16_t only_handle) {
+	bool isRefused = false;
+	for (uint8_t i = 0; i < HCI_SIM_MAX_CONNECTIONS; i++) {
+		SimConnection* connection = &connections[i];
+		if (should_notify(connection, characteristic) && (only_handle == 0 || connection->handle == only_handle)
+				&& connection->txCredits == 0) {
+			connection->isTxPoolAvailableEventPending = true;
+			isRefused = true;
+		}
+	}
+	if (isRefused) {
+		statistics.notificationsRefused++;
+		return false;
+	}
+
+	for (uint8_t i = 0; i < HCI_SIM_MAX_CONNECTIONS; i++) {
+		SimConnection* connection = &connections[i];
+		if (should_notify(connection, characteristic) && (only_handle == 0 || connection->handle == only_handle)) {
+			connection->txCredits--;
+			statistics.notificationsSent++;
+			if (notificationCallback != NULL) {
+				notificationCallback(i, characteristic->handle + 1, characteristic->value, characteristic->length);
+			}
+		}
+	}
+	return true;
+}
+
+// Notifies everyone subscribed when only_handle is 0, otherwise only that connection.
+// Local update (no notification) only changes the value in GATT database.
+static uint8_t update_characteristic(uint16_t service_handle, uint16_t handle, uint8_t offset, uint8_t length,
+		uint8_t const* value, bool notify, uint16_t only_handle) {
+	SimCharacteristic* characteristic = find_characteristic(handle);
+	if (characteristic == NULL || characteristic->serviceHandle != service_handle
+			|| offset + length > characteristic->maxLength) {
+		return STATUS_INVALID_PARAMS;
+	}
+	if (only_handle != 0 && find_connection(only_handle) == NULL) {
+		return STATUS_INVALID_PARAMS;
+	}
+
+	statistics.charValueUpdates++;
+	uint8_t const oldLength = characteristic->length;
+	uint8_t oldValue[SIM_MAX_VALUE_LENGTH];
+	memcpy(oldValue, characteristic->value, oldLength);
+
+	memcpy(&characteristic->value[offset], value, length);
+	if (offset + length > characteristic->length) {
+		characteristic->length = offset + length;
+	}
+
+	if (notify && !take_tx_credits(characteristic, only_handle)) {
+		memcpy(characteristic->value, oldValue, oldLength);
+		characteristic->length = oldLength;
+		return STATUS_INSUFFICIENT_RESOURCES;
+	}
+	return STATUS_SUCCESS;
+}
+
+/* Advertising */
+
+// Controller advertises at Advertising_Interval_Min, without the random advDelay
+static uint64_t next_advertising_event_us() {
+	uint64_t const events = (timeUs - advertisingStartUs + advertisingIntervalUs - 1) / advertisingIntervalUs;
+	return advertisingStartUs + events * advertisingIntervalUs;
+}
+
+static void start_advertising(uint8_t const* parameters) {
+	uint8_t const* interval = &parameters[SET_DISCOVERABLE_INTERVAL_MIN_OFFSET];
+	isAdvertising = true;
+	advertisingIntervalUs = BYTEARRAY_TO_16BIT_VALUE_LE(interval) * ADV_INTERVAL_UNIT_US;
+	advertisingStartUs = timeUs;
+}
+
+// Counts advertising events sent since advertising started or since the last call
+static void count_advertising_events() {
+	if (isAdvertising) {
+		uint64_t const events = (timeUs - advertisingStartUs) / advertisingIntervalUs;
+		statistics.advertisingEvents += (uint32_t) events;
+		advertisingStartUs += events * advertisingIntervalUs;
+	}
+}
+
+static void stop_advertising() {
+	count_advertising_events();
+	isAdvertising = false;
+}
+
+static void establish_connection(SimConnection* connection) {
+	stop_advertising();
+	memset(connection, 0, sizeof(SimConnection));
+	connection->handle = SIM_FIRST_CONNECTION_HANDLE + (uint16_t) (connection - connections);
+	connection->isConnected = true;
+	connection->txCredits = config.txBuffers;
+	connection->nextEventUs = timeUs + config.connectionIntervalUs;
+
+	// @formatter:off
+	hci_le_connection_complete_event_rp0 event = {
+			.Status = STATUS_SUCCESS,
+			.Connection_Handle = connection->handle,
+			.Role = 0x01,
+			.Peer_Address_Type = 0x01,
+			.Peer_Address = { 0x11, 0x22, 0x33, 0x44, 0x55, (uint8_t) (0xC0 + connection->handle) },
+			.Conn_Interval = (uint16_t) (config.connectionIntervalUs / 1250u),
+			.Conn_Latency = 0,
+			.Supervision_Timeout = 400,
+			.Master_Clock_Accuracy = 0
+	};
+	// @formatter:on
+	uint8_t* parameters = push_event(EVT_LE_META_EVENT, 1 + sizeof(event), 0);
+	if (parameters != NULL) {
+		parameters[0] = EVT_LE_CONNECTION_COMPLETE;
+		memcpy(&parameters[1], &event, sizeof(event));
+	}
+}
+
+// Only one central can connect on a single advertising event
+static SimConnection* requested_connection() {
+	for (uint8_t i = 0; i < HCI_SIM_MAX_CONNECTIONS; i++) {
+		if (connections[i].isRequested) {
+			return &connections[i];
+		}
+	}
+	return NULL;
+}
+
+/* Command processing */
+
+static void reset_controller() {
+	eventsHead = eventsTail = 0;
+	servicesCount = 0;
+	characteristicsCount = 0;
+	nextHandle = SIM_FIRST_HANDLE;
+	isAdvertising = false;
+	memset(connections, 0, sizeof(connections));
+	advDataLength = 0;
+
+	uint8_t const reasonCode = 0x01; // firmware started properly
+	push_vendor_event(EVT_BLUE_INITIALIZED, &reasonCode, 1, config.bootTimeUs);
+}
+
+/* Advertising data */
+
+// Returns offset of AD structure with given type, or advDataLength if there's none
+static uint8_t find_ad_structure(uint8_t type) {
+	uint8_t offset = 0;
+	while (offset < advDataLength && advData[offset + 1] != type) {
+		offset += advData[offset] + 1;
+	}
+	return offset;
+}
+
+// Replaces AD structure of the same type, or appends it
+static bool put_ad_structure(uint8_t const* ad) {
+	uint8_t const length = ad[0] + 1;
+	uint8_t const offset = find_ad_structure(ad[1]);
+	uint8_t oldLength = 0;
+	if (offset < advDataLength) {
+		oldLength = advData[offset] + 1;
+	}
+	if (advDataLength - oldLength + length > ADV_DATA_MAX_LENGTH) {
+		return false;
+	}
+
+	memmove(&advData[offset + length], &advData[offset + oldLength], advDataLength - offset - oldLength);
+	memcpy(&advData[offset], ad, length);
+	advDataLength = advDataLength - oldLength + length;
+	return true;
+}
+
+// Flags and TX power level are always added by the stack, then local name from the command
+static uint8_t set_discoverable_adv_data(uint8_t const* parameters) {
+	uint8_t const flags[] = { 0x02, 0x01, 0x06 };
+	uint8_t const txPower[] = { 0x02, 0x0A, 0x00 };
+	uint8_t const nameLength = parameters[SET_DISCOVERABLE_LOCAL_NAME_LENGTH_OFFSET];
+
+	advDataLength = 0;
+	put_ad_structure(flags);
+	put_ad_structure(txPower);
+	if (nameLength > 0) {
+		uint8_t name[ADV_DATA_MAX_LENGTH];
+		name[0] = nameLength;
+		memcpy(&name[1], &parameters[SET_DISCOVERABLE_LOCAL_NAME_LENGTH_OFFSET + 1], nameLength);
+		if (!put_ad_structure(name)) {
+			return STATUS_INVALID_PARAMS;
+		}
+	}
+	return STATUS_SUCCESS;
+}
+
+static uint8_t update_adv_data(uint8_t const* parameters) {
+	uint8_t const length = parameters[0];
+	uint8_t const* ad = &parameters[1];
+	for (uint8_t offset = 0; offset < length; offset += ad[offset] + 1) {
+		if (!put_ad_structure(&ad[offset])) {
+			return STATUS_INVALID_PARAMS;
+		}
+	}
+	return STATUS_SUCCESS;
+}
+
+static void process_command(uint16_t opcode, uint8_t const* parameters, uint8_t length) {
+	statistics.commands++;
+
+	switch (opcode) {
+	case OPCODE_HCI_RESET:
+		reset_controller();
+		push_command_status(opcode, STATUS_SUCCESS);
+		break;
+	case OPCODE_ACI_GAP_INIT: {
+		// GAP service: device name and appearance characteristics
+		aci_gap_init_rp0 response = { .Status = STATUS_SUCCESS };
+		response.Service_Handle = allocate_service(5);
+		response.Dev_Name_Char_Handle = response.Service_Handle + 1;
+		response.Appearance_Char_Handle = response.Service_Handle + 3;
+		push_command_complete(opcode, &response, sizeof(response));
+		break;
+	}
+	case OPCODE_ACI_GAP_SET_DISCOVERABLE: {
+		// Like the real controller, advertising parameters can't be changed while advertising
+		uint8_t status = STATUS_COMMAND_DISALLOWED;
+		if (connected_count() < HCI_SIM_MAX_CONNECTIONS && !isAdvertising) {
+			status = set_discoverable_adv_data(parameters);
+		}
+		if (status == STATUS_SUCCESS) {
+			start_advertising(parameters);
+		}
+		push_command_status(opcode, status);
+		break;
+	}
+	case OPCODE_ACI_GAP_UPDATE_ADV_DATA:
+		push_command_status(opcode, update_adv_data(parameters));
+		break;
+	case OPCODE_ACI_GAP_SET_NON_DISCOVERABLE:
+		stop_advertising();
+		push_command_status(opcode, STATUS_SUCCESS);
+		break;
+	case OPCODE_ACI_GATT_ADD_SERVICE: {
+		// Service_UUID_Type, Service_UUID, Service_Type, Max_Attribute_Records
+		uint8_t const uuidLength = uuid_length(parameters[0]);
+		aci_gatt_add_service_rp0 response = { .Status = STATUS_SUCCESS };
+		response.Service_Handle = allocate_service(parameters[1 + uuidLength + 1]);
+		if (response.Service_Handle == 0) {
+			response.Status = STATUS_INSUFFICIENT_RESOURCES;
+		}
+		push_command_complete(opcode, &response, sizeof(response));
+		break;
+	}
+	case OPCODE_ACI_GATT_ADD_CHAR: {
+		aci_gatt_add_char_cp0 const* header = (aci_gatt_add_char_cp0 const*) parameters;
+		uint8_t const uuidLength = uuid_length(header->Char_UUID_Type);
+		aci_gatt_add_char_cp1 const* footer = (aci_gatt_add_char_cp1 const*) &parameters[3 + uuidLength];
+		uint16_t characteristicHandle = 0;
+		aci_gatt_add_char_rp0 response = { 0 };
+		response.Status = add_characteristic(header->Service_Handle, header->Char_UUID_Type, &parameters[3],
+				footer->Char_Value_Length, footer->Char_Properties, footer->GATT_Evt_Mask, &characteristicHandle);
+		response.Char_Handle = characteristicHandle;
+		push_command_complete(opcode, &response, sizeof(response));
+		break;
+	}
+	case OPCODE_ACI_GATT_UPDATE_CHAR_VALUE: {
+		aci_gatt_update_char_value_cp0 const* command = (aci_gatt_update_char_value_cp0 const*) parameters;
+		push_command_status(opcode,
+				update_characteristic(command->Service_Handle, command->Char_Handle, command->Val_Offset,
+						command->Char_Value_Length, command->Char_Value, true, 0));
+		break;
+	}
+	case OPCODE_ACI_GATT_UPDATE_CHAR_VALUE_EXT: {
+		aci_gatt_update_char_value_ext_cp0 const* command = (aci_gatt_update_char_value_ext_cp0 const*) parameters;
+		push_command_status(opcode,
+				update_characteristic(command->Service_Handle, command->Char_Handle, (uint8_t) command->Value_Offset,
+						command->Value_Length, command->Value, (command->Update_Type & UPDATE_TYPE_NOTIFICATION) != 0,
+						command->Conn_Handle_To_Notify));
+		break;
+	}
+	case OPCODE_ACI_GATT_ALLOW_READ: {
+		aci_gatt_allow_read_cp0 const* command = (aci_gatt_allow_read_cp0 const*) parameters;
+		SimConnection* connection = find_connection(command->Connection_Handle);
+		SimCharacteristic const* characteristic =
+				connection != NULL ? find_characteristic(connection->pendingReadHandle - 1) : NULL;
+		if (characteristic != NULL) {
+			connection->allowedReadHandle = connection->pendingReadHandle;
+			connection->pendingReadHandle = 0;
+			connection->allowedLength = characteristic->length;
+			memcpy(connection->allowedValue, characteristic->value, characteristic->length);
+		}
+		push_command_status(opcode, connection != NULL ? STATUS_SUCCESS : STATUS_INVALID_PARAMS);
+		break;
+	}
+	default:
+		// Everything else (configuration, security, TX power, ...) just succeeds
+		// and gets zeroed return parameters
+		push_command_status(opcode, STATUS_SUCCESS);
+		break;
+	}
+
+	(void) length;
+}
+
+/* Connection events */
+
+static void process_connection_event(SimConnection* connection) {
+	statistics.connectionEvents++;
+	connection->txCredits = config.txBuffers;
+
+	if (connection->isTxPoolAvailableEventPending) {
+		connection->isTxPoolAvailableEventPending = false;
+		aci_gatt_tx_pool_available_event_rp0 event = { .Connection_Handle = connection->handle, .Available_Buffers =
+				connection->txCredits };
+		push_vendor_event(EVT_TX_POOL_AVAILABLE, &event, sizeof(event), 0);
+	}
+
+	if (connectionEventCallback != NULL) {
+		connectionEventCallback((uint8_t) (connection - connections));
+	}
+}
+
+static SimConnection* next_connection_event() {
+	SimConnection* next = NULL;
+	for (uint8_t i = 0; i < HCI_SIM_MAX_CONNECTIONS; i++) {
+		if (connections[i].isConnected && (next == NULL || connections[i].nextEventUs < next->nextEventUs)) {
+			next = &connections[i];
+		}
+	}
+	return next;
+}
+
+/* IRQ line */
+
+static void hci_sim_isr() {
+	if (isIRQActive) {
+		return;
+	}
+
+	isIRQActive = true;
+	while (is_event_ready()) {
+		if (hci_notify_asynch_evt(NULL)) {
+			// no free packets in the HCI pool, the event stays pending
+			break;
+		}
+	}
+	isIRQActive = false;
+}
+
+/* tHciIO */
+
+static int32_t HCI_SIM_Init(void* pConf) {
+	UNUSED(pConf);
+	return 0;
+}
+
+static int32_t HCI_SIM_DeInit(void) {
+	return 0;
+}
+
+static int32_t HCI_SIM_Reset(void) {
+	reset_controller();
+	return 0;
+}
+
+static int32_t HCI_SIM_Receive(uint8_t* buffer, uint16_t size) {
+	if (!is_event_ready()) {
+		return 0;
+	}
+
+	SimEvent const* event = &events[eventsTail % SIM_EVENT_QUEUE_SIZE];
+	uint16_t const length = event->length < size ? event->length : size;
+	memcpy(buffer, event->data, length);
+	eventsTail++;
+
+	statistics.eventsDelivered++;
+	statistics.bytesFromController += length;
+	return length;
+}
+
+static int32_t HCI_SIM_Send(uint8_t* buffer, uint16_t size) {
+	statistics.bytesToController += size;
+
+	if (size < 1 + HCI_COMMAND_HDR_SIZE || buffer[0] != HCI_COMMAND_PKT) {
+		return -1;
+	}
+
+	uint8_t const* opcodeBytes = &buffer[1];
+	uint16_t const opcode = BYTEARRAY_TO_16BIT_VALUE_LE(opcodeBytes);
+	uint8_t const length = buffer[3];
+	process_command(opcode, &buffer[1 + HCI_COMMAND_HDR_SIZE], length);
+	return size;
+}
+
+static int32_t HCI_SIM_GetTick(void) {
+	return (int32_t) (timeUs / 1000u);
+}
+
+void hci_tl_lowlevel_init(void) {
+	tHciIO fops;
+
+	fops.Init = HCI_SIM_Init;
+	fops.DeInit = HCI_SIM_DeInit;
+	fops.Send = HCI_SIM_Send;
+	fops.Receive = HCI_SIM_Receive;
+	fops.Reset = HCI_SIM_Reset;
+	fops.GetTick = HCI_SIM_GetTick;
+
+	hci_register_io_bus(&fops);
+}
+
+// There's no SPI, only the command count is meaningful here
+void HCI_TL_SPI_GetStats(tHciSpiStats* stats) {
+	*stats = (tHciSpiStats ) { .writes = statistics.commands };
+}
+
+void HCI_TL_SPI_ResetStats(void) {
+}
+
+/* Public API */
+
+void hci_sim_configure(HCISimConfig const* new_config) {
+	config = *new_config;
+}
+
+void hci_sim_set_connection_event_callback(HCISimConnectionEventCallback callback) {
+	connectionEventCallback = callback;
+}
+
+void hci_sim_set_notification_callback(HCISimNotificationCallback callback) {
+	notificationCallback = callback;
+}
+
+HCISimStatistics const* hci_sim_statistics() {
+	count_advertising_events();
+	return &statistics;
+}
+
+uint64_t hci_sim_time_us() {
+	return timeUs;
+}
+
+void hci_sim_advance_us(uint32_t us) {
+	uint64_t const target = timeUs + us;
+	SimConnection* requested = requested_connection();
+	if (requested != NULL && isAdvertising && next_advertising_event_us() <= target) {
+		timeUs = next_advertising_event_us();
+		establish_connection(requested);
+	}
+	for (SimConnection* connection = next_connection_event(); connection != NULL && connection->nextEventUs <= target;
+			connection = next_connection_event()) {
+		timeUs = connection->nextEventUs;
+		connection->nextEventUs += config.connectionIntervalUs;
+		process_connection_event(connection);
+		hci_sim_isr();
+	}
+	timeUs = target;
+	hci_sim_isr();
+}
+
+bool hci_sim_is_advertising() {
+	return isAdvertising;
+}
+
+bool hci_sim_is_connected(uint8_t connection) {
+	return connection < HCI_SIM_MAX_CONNECTIONS && connections[connection].isConnected;
+}
+
+uint8_t hci_sim_connected_count() {
+	return connected_count();
+}
+
+void hci_sim_connect(uint8_t connection) {
+	if (connection < HCI_SIM_MAX_CONNECTIONS && !connections[connection].isConnected) {
+		connections[connection].isRequested = true;
+	}
+}
+
+void hci_sim_disconnect(uint8_t connection, uint8_t reason) {
+	if (!hci_sim_is_connected(connection)) {
+		return;
+	}
+
+	SimConnection* link = &connections[connection];
+	link->isConnected = false;
+	// @formatter:off
+	hci_disconnection_complete_event_rp0 event = {
+			.Status = STATUS_SUCCESS,
+			.Connection_Handle = link->handle,
+			.Reason = reason
+	};
+	// @formatter:on
+	uint8_t* parameters = push_event(EVT_DISCONNECTION_COMPLETE, sizeof(event), 0);
+	if (parameters != NULL) {
+		memcpy(parameters, &event, sizeof(event));
+	}
+}
+
+// Central's MTU request, controller answers with its own MTU and reports the result
+void hci_sim_exchange_mtu(uint8_t connection, uint16_t client_mtu) {
+	if (!hci_sim_is_connected(connection)) {
+		return;
+	}
+
+	uint16_t const mtu = client_mtu < SIM_MAX_ATT_MTU ? client_mtu : SIM_MAX_ATT_MTU;
+	aci_att_exchange_mtu_resp_event_rp0 const event = { .Connection_Handle = connections[connection].handle,
+			.Server_RX_MTU = mtu };
+	push_vendor_event(EVT_ATT_EXCHANGE_MTU_RESP, &event, sizeof(event), config.connectionIntervalUs);
+}
+
+uint16_t hci_sim_find_characteristic(uint8_t const uuid[16]) {
+	for (uint8_t i = 0; i < characteristicsCount; i++) {
+		if (memcmp(characteristics[i].uuid, uuid, 16) == 0) {
+			return characteristics[i].handle + 1;
+		}
+	}
+	return 0;
+}
+
+// Read Request is reported with the read permit event, Read By Type (and Read Multiple) with the multi one
+static void push_read_permit_event(SimConnection const* link, uint16_t value_handle, bool is_multi) {
+	statistics.readPermitRequests++;
+	if (is_multi) {
+		aci_gatt_read_multi_permit_req_event_rp0 event = { .Connection_Handle = link->handle, .Number_of_Handles = 1 };
+		event.Handle_Item[0].Handle = value_handle;
+		push_vendor_event(EVT_READ_MULTI_PERMIT_REQ, &event, 3 + sizeof(event.Handle_Item[0]), 0);
+	} else {
+		aci_gatt_read_permit_req_event_rp0 const event = { .Connection_Handle = link->handle,
+				.Attribute_Handle = value_handle, .Offset = 0 };
+		push_vendor_event(EVT_READ_PERMIT_REQ, &event, sizeof(event), 0);
+	}
+}
+
+static uint16_t read_value(uint8_t connection, uint16_t value_handle, bool is_multi, uint8_t* data,
+		uint16_t max_length) {
+	SimCharacteristic const* characteristic = find_characteristic(value_handle - 1);
+	if (characteristic == NULL || !hci_sim_is_connected(connection)) {
+		return 0;
+	}
+
+	SimConnection* link = &connections[connection];
+	if (characteristic->eventMask & GATT_NOTIFY_READ_REQ_AND_WAIT_FOR_APPL_RESP) {
+		if (link->allowedReadHandle != value_handle) {
+			if (link->pendingReadHandle == 0) {
+				link->pendingReadHandle = value_handle;
+				push_read_permit_event(link, value_handle, is_multi);
+			}
+			return 0;
+		}
+		link->allowedReadHandle = 0;
+
+		uint16_t const length = link->allowedLength < max_length ? link->allowedLength : max_length;
+		memcpy(data, link->allowedValue, length);
+		return length;
+	}
+
+	uint16_t const length = characteristic->length < max_length ? characteristic->length : max_length;
+	memcpy(data, characteristic->value, length);
+	return length;
+}
+
+uint16_t hci_sim_read_attribute(uint8_t connection, uint16_t value_handle, uint8_t* data, uint16_t max_length) {
+	return read_value(connection, value_handle, false, data, max_length);
+}
+
+// Characteristic UUIDs are unique in the database, so the response holds a single handle-value pair
+uint16_t hci_sim_read_by_type(uint8_t connection, uint8_t const uuid[16], uint8_t* data, uint16_t max_length) {
+	uint16_t const value_handle = hci_sim_find_characteristic(uuid);
+	return value_handle != 0 ? read_value(connection, value_handle, true, data, max_length) : 0;
+}
+
+void hci_sim_write_attribute(uint8_t connection, uint16_t value_handle, uint8_t const* data, uint16_t length) {
+	SimCharacteristic* characteristic = find_characteristic(value_handle - 1);
+	if (!hci_sim_is_connected(connection) || characteristic == NULL || length > characteristic->maxLength) {
+		return;
+	}
+
+	memcpy(characteristic->value, data, length);
+	characteristic->length = length;
+
+	if (characteristic->eventMask & GATT_NOTIFY_ATTRIBUTE_WRITE) {
+		push_attribute_modified_event(&connections[connection], value_handle, data, length);
+	}
+}
+
+// CCCD write is reported to the application like any other attribute write
+void hci_sim_enable_notifications(uint8_t connection, uint16_t value_handle) {
+	SimCharacteristic* characteristic = find_characteristic(value_handle - 1);
+	if (!hci_sim_is_connected(connection) || characteristic == NULL
+			|| !(characteristic->properties & CHAR_PROP_NOTIFY)) {
+		return;
+	}
+
+	connections[connection].notificationsEnabled[characteristic_index(characteristic)] = true;
+
+	uint8_t const cccd[2] = { 0x01, 0x00 };
+	push_attribute_modified_event(&connections[connection], value_handle + 1, cccd, 2);
+}
+
+uint8_t hci_sim_advertising_data(uint8_t data[31]) {
+	memcpy(data, advData, advDataLength);
+	return advDataLength;
+}
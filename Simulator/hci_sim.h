@@ -0,0 +1,74 @@
+/*
+ * hci_sim.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: steelph0enix
+ */
+
+#ifndef SIMULATOR_HCI_SIM_H_
+#define SIMULATOR_HCI_SIM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Simulated BlueNRG-2 controller, registered as HCI transport by hci_tl_lowlevel_init().
+// It parses ACI/HCI commands sent by the stack, keeps its own GATT database and
+// answers with the same events the real controller would. Time is virtual and only
+// moves forward with hci_sim_advance_us(), events are delivered to hci_tl.c as if
+// they came from the BlueNRG IRQ line.
+
+// Centrals that can be connected at the same time, BlueNRG-2 supports up to 8 links
+#define HCI_SIM_MAX_CONNECTIONS 8
+
+typedef struct HCISimConfig_t {
+	uint32_t bootTimeUs;           // reset to aci_blue_initialized_event
+	uint32_t commandLatencyUs;     // command to its Command Complete event
+	uint32_t connectionIntervalUs; // time between connection events
+	uint8_t txBuffers;             // notifications that can be queued per connection event
+} HCISimConfig;
+
+typedef struct HCISimStatistics_t {
+	uint32_t commands;
+	uint32_t charValueUpdates;
+	uint32_t notificationsSent;
+	uint32_t notificationsRefused;
+	uint32_t eventsDelivered;
+	uint32_t eventsDropped;
+	uint32_t bytesToController;
+	uint32_t bytesFromController;
+	uint32_t connectionEvents;
+	uint32_t readPermitRequests;
+	uint32_t advertisingEvents;
+} HCISimStatistics;
+
+// Connection index, 0 .. HCI_SIM_MAX_CONNECTIONS - 1
+typedef void (*HCISimConnectionEventCallback)(uint8_t connection);
+typedef void (*HCISimNotificationCallback)(uint8_t connection, uint16_t value_handle, uint8_t const* data,
+		uint16_t length);
+
+void hci_sim_configure(HCISimConfig const* config);
+void hci_sim_set_connection_event_callback(HCISimConnectionEventCallback callback);
+void hci_sim_set_notification_callback(HCISimNotificationCallback callback);
+HCISimStatistics const* hci_sim_statistics();
+
+uint64_t hci_sim_time_us();
+void hci_sim_advance_us(uint32_t us);
+
+// Central side, every central is identified by its connection index
+bool hci_sim_is_advertising();
+bool hci_sim_is_connected(uint8_t connection);
+uint8_t hci_sim_connected_count();
+// Central starts connecting, connection is made on the next advertising event (one central per event)
+void hci_sim_connect(uint8_t connection);
+void hci_sim_disconnect(uint8_t connection, uint8_t reason);
+void hci_sim_exchange_mtu(uint8_t connection, uint16_t client_mtu);
+uint16_t hci_sim_find_characteristic(uint8_t const uuid[16]);
+// Returns 0 while the read waits for the application to allow it (read permit request)
+uint16_t hci_sim_read_attribute(uint8_t connection, uint16_t value_handle, uint8_t* data, uint16_t max_length);
+uint16_t hci_sim_read_by_type(uint8_t connection, uint8_t const uuid[16], uint8_t* data, uint16_t max_length);
+void hci_sim_write_attribute(uint8_t connection, uint16_t value_handle, uint8_t const* data, uint16_t length);
+void hci_sim_enable_notifications(uint8_t connection, uint16_t value_handle);
+// What a passive scanner would receive, returns the data length
+uint8_t hci_sim_advertising_data(uint8_t data[31]);
+
+#endif /* SIMULATOR_HCI_SIM_H_ */
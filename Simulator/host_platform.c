@@ -0,0 +1,190 @@
+/*
+ * host_platform.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: steelph0enix
+ */
+
+#include "host_platform.h"
+#include "hci_sim.h"
+#include "main.h"
+#include "rtc.h"
+#include "cmsis_os.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#define SECONDS_PER_DAY 86400u
+
+RTC_HandleTypeDef hrtc;
+uint32_t SystemCoreClock = 170000000u;
+
+static uint32_t tickReads = 0;
+static uint64_t delayedUs = 0;
+
+static uint32_t rtcBaseSecondOfDay = 0;
+static uint64_t rtcBaseTimeUs = 0;
+static RTC_DateTypeDef rtcDate = { 0 };
+static RTC_AlarmTypeDef rtcAlarm = { 0 };
+static bool isAlarmEnabled = false;
+static uint32_t lastCheckedSecond = 0;
+
+// rtc_utils.c reads NVIC registers directly, so the System Control Space gets backed with plain memory
+void host_platform_init() {
+	void* scs = mmap((void*) SCS_BASE, 0x1000, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE,
+			-1, 0);
+	if (scs != (void*) SCS_BASE) {
+		perror("Couldn't map System Control Space");
+		exit(1);
+	}
+}
+
+uint32_t host_platform_tick_reads() {
+	return tickReads;
+}
+
+uint64_t host_platform_delayed_us() {
+	return delayedUs;
+}
+
+/* RTC */
+
+static uint32_t rtc_second_of_day() {
+	uint64_t const elapsedSeconds = (hci_sim_time_us() - rtcBaseTimeUs) / 1000000u;
+	return (uint32_t) ((rtcBaseSecondOfDay + elapsedSeconds) % SECONDS_PER_DAY);
+}
+
+static uint32_t time_to_seconds(RTC_TimeTypeDef const* time) {
+	return time->Hours * 3600u + time->Minutes * 60u + time->Seconds;
+}
+
+static void check_rtc_alarm() {
+	uint32_t const now = rtc_second_of_day();
+	while (lastCheckedSecond != now) {
+		lastCheckedSecond = (lastCheckedSecond + 1) % SECONDS_PER_DAY;
+		if (isAlarmEnabled && lastCheckedSecond == time_to_seconds(&rtcAlarm.AlarmTime)) {
+			HAL_RTC_AlarmAEventCallback(&hrtc);
+		}
+	}
+}
+
+HAL_StatusTypeDef HAL_RTC_SetTime(RTC_HandleTypeDef* handle, RTC_TimeTypeDef* sTime, uint32_t Format) {
+	UNUSED(handle);
+	UNUSED(Format);
+	rtcBaseSecondOfDay = time_to_seconds(sTime);
+	rtcBaseTimeUs = hci_sim_time_us();
+	lastCheckedSecond = rtcBaseSecondOfDay;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RTC_GetTime(RTC_HandleTypeDef* handle, RTC_TimeTypeDef* sTime, uint32_t Format) {
+	UNUSED(handle);
+	UNUSED(Format);
+	uint32_t const seconds = rtc_second_of_day();
+	sTime->Hours = seconds / 3600u;
+	sTime->Minutes = (seconds / 60u) % 60u;
+	sTime->Seconds = seconds % 60u;
+	sTime->SubSeconds = 0;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RTC_SetDate(RTC_HandleTypeDef* handle, RTC_DateTypeDef* sDate, uint32_t Format) {
+	UNUSED(handle);
+	UNUSED(Format);
+	rtcDate = *sDate;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RTC_GetDate(RTC_HandleTypeDef* handle, RTC_DateTypeDef* sDate, uint32_t Format) {
+	UNUSED(handle);
+	UNUSED(Format);
+	*sDate = rtcDate;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RTC_SetAlarm_IT(RTC_HandleTypeDef* handle, RTC_AlarmTypeDef* sAlarm, uint32_t Format) {
+	UNUSED(handle);
+	UNUSED(Format);
+	check_rtc_alarm();
+	rtcAlarm = *sAlarm;
+	isAlarmEnabled = true;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RTC_GetAlarm(RTC_HandleTypeDef* handle, RTC_AlarmTypeDef* sAlarm, uint32_t Alarm,
+		uint32_t Format) {
+	UNUSED(handle);
+	UNUSED(Alarm);
+	UNUSED(Format);
+	*sAlarm = rtcAlarm;
+	return HAL_OK;
+}
+
+// Same initial state as MX_RTC_Init() from rtc.c
+void MX_RTC_Init(void) {
+	RTC_TimeTypeDef time = { 0 };
+	RTC_DateTypeDef date = { .WeekDay = RTC_WEEKDAY_MONDAY, .Month = RTC_MONTH_JANUARY, .Date = 1, .Year = 0 };
+	RTC_AlarmTypeDef alarm = { 0 };
+
+	alarm.AlarmMask = RTC_ALARMMASK_DATEWEEKDAY;
+	alarm.AlarmSubSecondMask = RTC_ALARMSUBSECONDMASK_ALL;
+	alarm.AlarmDateWeekDaySel = RTC_ALARMDATEWEEKDAYSEL_DATE;
+	alarm.AlarmDateWeekDay = 1;
+	alarm.Alarm = RTC_ALARM_A;
+
+	HAL_RTC_SetTime(&hrtc, &time, RTC_FORMAT_BIN);
+	HAL_RTC_SetDate(&hrtc, &date, RTC_FORMAT_BIN);
+	HAL_RTC_SetAlarm_IT(&hrtc, &alarm, RTC_FORMAT_BIN);
+}
+
+/* HAL */
+
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority) {
+	UNUSED(IRQn);
+	UNUSED(PreemptPriority);
+	UNUSED(SubPriority);
+}
+
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn) {
+	NVIC->ISER[((uint32_t) IRQn) >> 5UL] = (uint32_t) (1UL << (((uint32_t) IRQn) & 0x1FUL));
+}
+
+uint32_t HAL_GetTick(void) {
+	tickReads++;
+	hci_sim_advance_us(HOST_TICK_COST_US);
+	return (uint32_t) (hci_sim_time_us() / 1000u);
+}
+
+static void delay_ms(uint32_t ms) {
+	for (uint32_t i = 0; i < ms; i++) {
+		hci_sim_advance_us(1000u);
+		check_rtc_alarm();
+	}
+	delayedUs += ms * 1000ull;
+}
+
+void HAL_Delay(uint32_t Delay) {
+	delay_ms(Delay);
+}
+
+/* BLE command timing, there's no DWT on host */
+
+uint32_t ble_commands_timestamp() {
+	return (uint32_t) hci_sim_time_us();
+}
+
+uint32_t ble_commands_elapsed_us(uint32_t since) {
+	return (uint32_t) hci_sim_time_us() - since;
+}
+
+/* CMSIS-RTOS */
+
+osStatus_t osDelay(uint32_t ticks) {
+	delay_ms(ticks);
+	return osOK;
+}
+
+uint32_t osKernelGetTickCount(void) {
+	return (uint32_t) (hci_sim_time_us() / 1000u);
+}
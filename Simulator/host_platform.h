@@ -0,0 +1,26 @@
+/*
+ * host_platform.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: steelph0enix
+ */
+
+#ifndef SIMULATOR_HOST_PLATFORM_H_
+#define SIMULATOR_HOST_PLATFORM_H_
+
+#include <stdint.h>
+
+// Host replacements for HAL/RTOS functions used by the application.
+// Every HAL_GetTick() call moves the simulated time forward by 1us, so busy-waiting
+// loops (like the one in hci_send_req) eventually see the controller answer.
+// osDelay() and HAL_Delay() move it forward by the requested amount.
+
+#define HOST_TICK_COST_US 1u
+
+void host_platform_init();
+
+// Counters for the simulation report
+uint32_t host_platform_tick_reads();
+uint64_t host_platform_delayed_us();
+
+#endif /* SIMULATOR_HOST_PLATFORM_H_ */
@@ -0,0 +1,38 @@
+/*
+ * host_sensors.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: steelph0enix
+ */
+
+#include "mems_sensors.h"
+#include "hci_sim.h"
+
+#include <stdint.h>
+
+// Synthetic readings instead of the X-NUCLEO-IKS01A3 sensors. Values drift slowly with
+// simulated time, so consecutive records differ from each other.
+
+// Centi-units, like the firmware returns them
+static int32_t drift(int32_t base, int32_t step, uint32_t period) {
+	uint32_t const seconds = (uint32_t) (hci_sim_time_us() / 1000000u);
+	uint32_t const phase = seconds % (2u * period);
+	int32_t const offset = phase < period ? (int32_t) phase : (int32_t) (2u * period - phase);
+	return base + step * offset;
+}
+
+void mems_init() {
+}
+
+void mems_measure(MemsMeasurement* measurement) {
+	mems_sample(measurement);
+}
+
+void mems_sample(MemsMeasurement* measurement) {
+	measurement->values[MEMS_CHANNEL_TEMPERATURE] = drift(2150, 1, 600u);
+	measurement->values[MEMS_CHANNEL_PRESSURE] = drift(101325, 2, 1800u);
+	measurement->values[MEMS_CHANNEL_HUMIDITY] = drift(4500, 5, 300u);
+	measurement->validChannels = (1u << MEMS_CHANNELS) - 1u;
+	measurement->latencyUs = 0;
+	measurement->skewUs = 0;
+}
@@ -0,0 +1,16 @@
+/*
+ * reent.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: steelph0enix
+ */
+
+#ifndef SIMULATOR_REENT_H_
+#define SIMULATOR_REENT_H_
+
+// FreeRTOS.h includes newlib reent.h when configUSE_NEWLIB_REENTRANT is set, glibc has none
+struct _reent {
+	int unused;
+};
+
+#endif /* SIMULATOR_REENT_H_ */
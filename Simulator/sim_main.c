@@ -0,0 +1,467 @@
+/*
+ * sim_main.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: steelph0enix
+ */
+
+#include "hci_sim.h"
+#include "host_platform.h"
+#include "ble_app.h"
+#include "ble_app_interface.h"
+#include "ble_app_services.h"
+#include "ble_app_stats.h"
+#include "app_states.h"
+#include "mems_sensors.h"
+#include "mems_data_buffer.h"
+#include "rtc.h"
+#include "cmsis_os.h"
+#include "bit_helpers.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+#include <string.h>
+
+// Runs the application against the simulated controller:
+// boot, collect measurements for a while, then two centrals (a phone and a gateway)
+// connect and fetch all records at the same time, using the control characteristic
+// protocol. Both have to get the same records. After that they stay connected for
+// a while, subscribed to live measurements, disconnect and the phone connects again
+// shortly after, while the station is still advertising fast. It reads the first
+// record and aborts, the records it hasn't confirmed have to stay in the station.
+// Usage: bluenrg_sim [measuring time in seconds] [connection interval in ms]
+
+#define UUID_LENGTH 16
+#define FETCH_TIMEOUT_MS 600000u
+#define READ_TIMEOUT_MS 1000u
+// Central stays connected after fetching, to receive live measurements
+#define LIVE_LISTENING_MS 31000u
+#define CONNECT_TIMEOUT_MS 10000u
+#define RECONNECT_DELAY_MS 1000u
+#define CENTRALS 2
+#define MAX_FETCHED_RECORDS 64
+
+typedef enum CentralState_t {
+	CENTRAL_IDLE,
+	CENTRAL_FETCHING,
+	CENTRAL_DONE
+} CentralState;
+
+// Record values, read one per connection event
+typedef enum CentralStep_t {
+	STEP_WAIT_FOR_RECORD,
+	STEP_READ_TEMPERATURE,
+	STEP_READ_PRESSURE,
+	STEP_READ_HUMIDITY
+} CentralStep;
+
+typedef struct FetchedRecord_t {
+	int32_t temperature;
+	int32_t pressure;
+	int32_t humidity;
+} FetchedRecord;
+
+typedef struct Central_t {
+	char const* name;
+	uint16_t mtu;
+	CentralState state;
+	CentralStep step;
+	uint8_t control; // last control value notified
+	bool isControlNotified;
+	uint32_t recordsFetched;
+	FetchedRecord records[MAX_FETCHED_RECORDS];
+	uint32_t liveNotifications;
+	uint64_t fetchEndUs;
+	uint32_t abortAfter; // aborts fetching after that many records, 0 to fetch all
+} Central;
+
+// Same UUIDs as in ble_app_services.c, MSB first
+static uint8_t const controlCharUUIDBytes[UUID_LENGTH] = { 0x55, 0x58, 0xCA, 0xA5, 0xAB, 0x6B, 0x4D, 0x0D, 0x95, 0xA6,
+		0xFA, 0x45, 0x38, 0x80, 0x80, 0xC2 };
+static uint8_t const numberOfRecordsCharUUIDBytes[UUID_LENGTH] = { 0x55, 0x58, 0xCA, 0xA6, 0xAB, 0x6B, 0x4D, 0x0D, 0x95,
+		0xA6, 0xFA, 0x45, 0x38, 0x80, 0x80, 0xC2 };
+static uint8_t const temperatureCharUUIDBytes[UUID_LENGTH] = { 0x55, 0x58, 0xCA, 0xA2, 0xAB, 0x6B, 0x4D, 0x0D, 0x95,
+		0xA6, 0xFA, 0x45, 0x38, 0x80, 0x80, 0xC2 };
+static uint8_t const pressureCharUUIDBytes[UUID_LENGTH] = { 0x55, 0x58, 0xCA, 0xA3, 0xAB, 0x6B, 0x4D, 0x0D, 0x95, 0xA6,
+		0xFA, 0x45, 0x38, 0x80, 0x80, 0xC2 };
+static uint8_t const humidityCharUUIDBytes[UUID_LENGTH] = { 0x55, 0x58, 0xCA, 0xA4, 0xAB, 0x6B, 0x4D, 0x0D, 0x95, 0xA6,
+		0xFA, 0x45, 0x38, 0x80, 0x80, 0xC2 };
+static uint8_t const liveMeasurementCharUUIDBytes[UUID_LENGTH] = { 0x55, 0x58, 0xCA, 0xA8, 0xAB, 0x6B, 0x4D, 0x0D, 0x95,
+		0xA6, 0xFA, 0x45, 0x38, 0x80, 0x80, 0xC2 };
+
+static bool isTimeForUpdate = false;
+
+// Central index is its connection index in hci_sim
+static Central centrals[CENTRALS] = { { .name = "Phone", .mtu = 185 }, { .name = "Gateway", .mtu = 23 } };
+static uint16_t controlHandle = 0;
+static uint16_t temperatureHandle = 0;
+static uint16_t pressureHandle = 0;
+static uint16_t humidityHandle = 0;
+static uint16_t liveMeasurementHandle = 0;
+
+// Measurement broadcast in advertising data, decoded like a passive scanner would
+typedef struct Broadcast_t {
+	bool isPresent;
+	uint8_t advertisingLength;
+	uint8_t sequence;
+	int16_t temperature;
+	uint16_t humidity;
+	uint16_t pressure;
+} Broadcast;
+
+void HAL_RTC_AlarmAEventCallback(RTC_HandleTypeDef* handle) {
+	UNUSED(handle);
+	isTimeForUpdate = true;
+}
+
+static void uuid_to_le(uint8_t const* uuid_msb_first, uint8_t uuid[UUID_LENGTH]) {
+	for (uint8_t i = 0; i < UUID_LENGTH; i++) {
+		uuid[i] = uuid_msb_first[UUID_LENGTH - 1 - i];
+	}
+}
+
+static uint16_t find_characteristic(uint8_t const* uuid_msb_first) {
+	uint8_t uuid[UUID_LENGTH];
+	uuid_to_le(uuid_msb_first, uuid);
+
+	uint16_t const handle = hci_sim_find_characteristic(uuid);
+	if (handle == 0) {
+		printf("Characteristic %02X%02X not found in GATT database!\n", uuid_msb_first[2], uuid_msb_first[3]);
+		exit(1);
+	}
+	return handle;
+}
+
+// Returns false while the read waits for the application
+static bool read_int32(uint8_t central, uint16_t handle, int32_t* value) {
+	uint8_t bytes[4] = { 0 };
+	if (hci_sim_read_attribute(central, handle, bytes, 4) == 0) {
+		return false;
+	}
+	*value = (int32_t) BYTEARRAY_TO_32BIT_VALUE_LE(bytes);
+	return true;
+}
+
+static void write_control(uint8_t central, BLEControlCharValue value) {
+	uint8_t const byte = (uint8_t) value;
+	centrals[central].isControlNotified = false;
+	hci_sim_write_attribute(central, controlHandle, &byte, 1);
+}
+
+static void on_notification(uint8_t connection, uint16_t value_handle, uint8_t const* data, uint16_t length) {
+	if (connection >= CENTRALS) {
+		return;
+	}
+
+	Central* central = &centrals[connection];
+	if (value_handle == controlHandle && length > 0) {
+		central->control = data[0];
+		central->isControlNotified = true;
+	} else if (value_handle == liveMeasurementHandle) {
+		central->liveNotifications++;
+	}
+}
+
+// Central reacts once per connection event, like a real GATT client would:
+// it's notified about the control value, then reads the record, one attribute per connection event
+static void on_connection_event(uint8_t connection) {
+	if (connection >= CENTRALS || centrals[connection].state != CENTRAL_FETCHING) {
+		return;
+	}
+
+	Central* central = &centrals[connection];
+	FetchedRecord* record = &central->records[central->recordsFetched % MAX_FETCHED_RECORDS];
+	switch (central->step) {
+	case STEP_WAIT_FOR_RECORD:
+		if (!central->isControlNotified) {
+			break;
+		}
+		if (central->control == BLE_CTRL_NEXT_RECORD_AVAILABLE) {
+			central->step = STEP_READ_TEMPERATURE;
+		} else if (central->control == BLE_CTRL_DEFAULT) {
+			central->state = CENTRAL_DONE;
+			central->fetchEndUs = hci_sim_time_us();
+		}
+		break;
+	case STEP_READ_TEMPERATURE:
+		if (read_int32(connection, temperatureHandle, &record->temperature)) {
+			central->step = STEP_READ_PRESSURE;
+		}
+		break;
+	case STEP_READ_PRESSURE:
+		if (read_int32(connection, pressureHandle, &record->pressure)) {
+			central->step = STEP_READ_HUMIDITY;
+		}
+		break;
+	case STEP_READ_HUMIDITY:
+		if (read_int32(connection, humidityHandle, &record->humidity)) {
+			central->recordsFetched++;
+			printf("\t%s got record #%lu: %ld, %ld, %ld\n", central->name, (unsigned long) central->recordsFetched,
+					(long) record->temperature, (long) record->pressure, (long) record->humidity);
+			central->step = STEP_WAIT_FOR_RECORD;
+			if (central->recordsFetched == central->abortAfter) {
+				central->state = CENTRAL_DONE;
+				write_control(connection, BLE_CTRL_ABORT_FETCHING);
+			} else {
+				write_control(connection, BLE_CTRL_FETCH_NEXT_RECORD);
+			}
+		}
+		break;
+	}
+}
+
+// Single iteration of the default task loop from app_freertos.c
+static void run_default_task_iteration() {
+	osDelay(1);
+	ble_process();
+	app_process();
+
+	if (isTimeForUpdate) {
+		isTimeForUpdate = false;
+		app_rtc_alarm_handler();
+	}
+}
+
+static void run_for_ms(uint32_t ms) {
+	uint64_t const end = hci_sim_time_us() + ms * 1000ull;
+	while (hci_sim_time_us() < end) {
+		run_default_task_iteration();
+	}
+}
+
+// Central starts connecting and waits for the station to advertise, returns how long it took
+static uint64_t connect_central(uint8_t central) {
+	uint64_t const startUs = hci_sim_time_us();
+	hci_sim_connect(central);
+	while (!hci_sim_is_connected(central) && hci_sim_time_us() - startUs < CONNECT_TIMEOUT_MS * 1000ull) {
+		run_default_task_iteration();
+	}
+	if (!hci_sim_is_connected(central)) {
+		printf("%s couldn't connect in %u ms!\n", centrals[central].name, CONNECT_TIMEOUT_MS);
+		exit(1);
+	}
+	return hci_sim_time_us() - startUs;
+}
+
+static bool is_fetching() {
+	for (uint8_t i = 0; i < CENTRALS; i++) {
+		if (centrals[i].state == CENTRAL_FETCHING) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Transfers must not mix, every central has to get all records
+static bool are_records_identical() {
+	uint32_t const compared =
+			centrals[0].recordsFetched < MAX_FETCHED_RECORDS ? centrals[0].recordsFetched : MAX_FETCHED_RECORDS;
+	for (uint8_t i = 1; i < CENTRALS; i++) {
+		if (centrals[i].recordsFetched != centrals[0].recordsFetched
+				|| memcmp(centrals[i].records, centrals[0].records, sizeof(FetchedRecord) * compared) != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static Broadcast scan_broadcast() {
+	Broadcast broadcast = { 0 };
+	uint8_t adv[31];
+	broadcast.advertisingLength = hci_sim_advertising_data(adv);
+
+	for (uint8_t offset = 0; offset < broadcast.advertisingLength; offset += adv[offset] + 1) {
+		uint8_t const* ad = &adv[offset];
+		if (ad[1] == 0xFF && ad[0] == 10) {
+			uint8_t const* temperature = &ad[5];
+			uint8_t const* humidity = &ad[7];
+			uint8_t const* pressure = &ad[9];
+			broadcast.isPresent = true;
+			broadcast.sequence = ad[4];
+			broadcast.temperature = (int16_t) BYTEARRAY_TO_16BIT_VALUE_LE(temperature);
+			broadcast.humidity = BYTEARRAY_TO_16BIT_VALUE_LE(humidity);
+			broadcast.pressure = BYTEARRAY_TO_16BIT_VALUE_LE(pressure);
+		}
+	}
+	return broadcast;
+}
+
+static double host_seconds() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static double sim_ms(uint64_t us) {
+	return us / 1000.0;
+}
+
+int main(int argc, char** argv) {
+	uint32_t const measuringSeconds = argc > 1 ? (uint32_t) atoi(argv[1]) : 120u;
+	uint32_t const connectionIntervalMs = argc > 2 ? (uint32_t) atoi(argv[2]) : 30u;
+
+	HCISimConfig config = { .bootTimeUs = 20000, .commandLatencyUs = 150, .connectionIntervalUs =
+			connectionIntervalMs * 1000u, .txBuffers = 4 };
+	hci_sim_configure(&config);
+	hci_sim_set_connection_event_callback(on_connection_event);
+	hci_sim_set_notification_callback(on_notification);
+	host_platform_init();
+	MX_RTC_Init();
+
+	double const hostStart = host_seconds();
+
+	ble_start();
+	mems_init();
+	ble_init();
+	uint64_t const advertisingAtUs = hci_sim_time_us();
+	if (!hci_sim_is_advertising()) {
+		printf("Device is not advertising after ble_init()!\n");
+		return 1;
+	}
+	uint32_t const bootCommands = hci_sim_statistics()->commands;
+
+	app_set_measurement_interval(0, 0, 15);
+	run_for_ms(measuringSeconds * 1000u);
+	Broadcast const broadcast = scan_broadcast();
+
+	// Advertising is restarted after the first connection, so the second central can join
+	uint64_t const connectUs = connect_central(0);
+	uint64_t const secondConnectUs = connect_central(1);
+	run_for_ms(100);
+	uint16_t const numberOfRecordsHandle = find_characteristic(numberOfRecordsCharUUIDBytes);
+	controlHandle = find_characteristic(controlCharUUIDBytes);
+	temperatureHandle = find_characteristic(temperatureCharUUIDBytes);
+	pressureHandle = find_characteristic(pressureCharUUIDBytes);
+	humidityHandle = find_characteristic(humidityCharUUIDBytes);
+	liveMeasurementHandle = find_characteristic(liveMeasurementCharUUIDBytes);
+	for (uint8_t i = 0; i < CENTRALS; i++) {
+		hci_sim_exchange_mtu(i, centrals[i].mtu);
+		hci_sim_enable_notifications(i, controlHandle);
+		hci_sim_enable_notifications(i, numberOfRecordsHandle);
+		hci_sim_enable_notifications(i, liveMeasurementHandle);
+	}
+	run_for_ms(100);
+
+	uint8_t records[2] = { 0 };
+	// numberOfRecords is lazy, the read is held until the application allows it
+	uint64_t const readStartUs = hci_sim_time_us();
+	while (hci_sim_read_attribute(0, numberOfRecordsHandle, records, 2) == 0
+			&& hci_sim_time_us() - readStartUs < READ_TIMEOUT_MS * 1000ull) {
+		run_default_task_iteration();
+	}
+	// Read By Type of the same characteristic is held too, but allowed through the read multi permit event
+	uint8_t recordsUUID[UUID_LENGTH];
+	uuid_to_le(numberOfRecordsCharUUIDBytes, recordsUUID);
+	uint8_t recordsByType[2] = { 0 };
+	uint16_t recordsByTypeLength = 0;
+	uint64_t const readByTypeStartUs = hci_sim_time_us();
+	while ((recordsByTypeLength = hci_sim_read_by_type(0, recordsUUID, recordsByType, 2)) == 0
+			&& hci_sim_time_us() - readByTypeStartUs < READ_TIMEOUT_MS * 1000ull) {
+		run_default_task_iteration();
+	}
+	uint64_t const readByTypeUs = hci_sim_time_us() - readByTypeStartUs;
+	bool const isReadByTypeCorrect = recordsByTypeLength == 2 && memcmp(recordsByType, records, 2) == 0;
+	uint32_t const commandsBeforeFetch = hci_sim_statistics()->commands;
+	uint64_t const fetchStartUs = hci_sim_time_us();
+
+	// Both start at the same time, their transfers interleave
+	for (uint8_t i = 0; i < CENTRALS; i++) {
+		centrals[i].state = CENTRAL_FETCHING;
+		write_control(i, BLE_CTRL_GET_DATA);
+	}
+	while (is_fetching() && hci_sim_time_us() - fetchStartUs < FETCH_TIMEOUT_MS * 1000ull) {
+		run_default_task_iteration();
+	}
+	uint64_t const fetchEndUs = hci_sim_time_us();
+	uint32_t const fetchCommands = hci_sim_statistics()->commands - commandsBeforeFetch;
+	uint32_t const recordsFetched = centrals[0].recordsFetched;
+	bool const isFetchCorrect = !is_fetching() && are_records_identical();
+
+	for (uint8_t i = 0; i < CENTRALS; i++) {
+		centrals[i].liveNotifications = 0;
+	}
+	run_for_ms(LIVE_LISTENING_MS);
+
+	for (uint8_t i = 0; i < CENTRALS; i++) {
+		hci_sim_disconnect(i, 0x13);
+	}
+	run_for_ms(RECONNECT_DELAY_MS);
+	uint64_t const reconnectUs = connect_central(0);
+
+	// Nothing is confirmed by aborting after the first record, it's only presented
+	hci_sim_enable_notifications(0, controlHandle);
+	uint32_t const storedBeforeAbort = (uint32_t) measurements_stored_count();
+	uint64_t const abortStartUs = hci_sim_time_us();
+	centrals[0].abortAfter = centrals[0].recordsFetched + 1;
+	centrals[0].state = CENTRAL_FETCHING;
+	centrals[0].step = STEP_WAIT_FOR_RECORD;
+	write_control(0, BLE_CTRL_GET_DATA);
+	while (is_fetching() && hci_sim_time_us() - abortStartUs < FETCH_TIMEOUT_MS * 1000ull) {
+		run_default_task_iteration();
+	}
+	run_for_ms(100);
+	uint32_t const storedAfterAbort = (uint32_t) measurements_stored_count();
+	bool const isAbortCorrect = !is_fetching() && storedBeforeAbort > 0 && storedAfterAbort >= storedBeforeAbort;
+	hci_sim_disconnect(0, 0x13);
+	run_for_ms(100);
+
+	double const hostElapsed = host_seconds() - hostStart;
+	HCISimStatistics const* statistics = hci_sim_statistics();
+
+	printf("\n=== Simulation report ===\n");
+	printf("Boot to advertising:      %.3f ms, %lu commands\n", sim_ms(advertisingAtUs), (unsigned long) bootCommands);
+	printf("Connect time:             %.3f ms, %.3f ms for second central, %.3f ms when reconnecting %u ms after disconnection\n",
+			sim_ms(connectUs), sim_ms(secondConnectUs), sim_ms(reconnectUs), RECONNECT_DELAY_MS);
+	printf("Advertising events:       %lu\n", (unsigned long) statistics->advertisingEvents);
+	printf("Records advertised:       %u\n", BYTEARRAY_TO_16BIT_VALUE_LE(records));
+	if (broadcast.isPresent) {
+		printf("Broadcast:                #%u, %.2f*C, %.1fhPa, %.2f%%, %u/31 bytes of advertising data\n",
+				broadcast.sequence, broadcast.temperature / 100.0, broadcast.pressure / 10.0, broadcast.humidity / 100.0,
+				broadcast.advertisingLength);
+	} else {
+		printf("Broadcast:                none\n");
+	}
+	printf("Read By Type:             %.3f ms%s\n", sim_ms(readByTypeUs),
+			isReadByTypeCorrect ? ", same as Read" : " (TIMEOUT OR MISMATCH)");
+	printf("Records fetched:          %lu by each of %u centrals%s\n", (unsigned long) recordsFetched, CENTRALS,
+			isFetchCorrect ? ", identical" : " (TIMEOUT OR MISMATCH)");
+	printf("Aborted fetch:            %lu of %lu records kept after reading one%s\n",
+			(unsigned long) storedAfterAbort, (unsigned long) storedBeforeAbort,
+			isAbortCorrect ? "" : " (RECORDS LOST)");
+	printf("Fetch time:               %.3f ms", sim_ms(fetchEndUs - fetchStartUs));
+	if (recordsFetched > 0) {
+		printf(", %.3f ms/record, %.1f commands/record", sim_ms(fetchEndUs - fetchStartUs) / recordsFetched,
+				(double) fetchCommands / (recordsFetched * CENTRALS));
+	}
+	for (uint8_t i = 0; i < CENTRALS; i++) {
+		printf(", %s done after %.3f ms", centrals[i].name, sim_ms(centrals[i].fetchEndUs - fetchStartUs));
+	}
+	printf("\n");
+	printf("HCI commands:             %lu (%lu char value updates)\n", (unsigned long) statistics->commands,
+			(unsigned long) statistics->charValueUpdates);
+	BLEValueCacheStats const cacheStats = get_value_cache_stats();
+	printf("Value cache:              %lu requested, %lu sent, %lu saved (%lu unchanged, %lu coalesced), %lu deferred\n",
+			(unsigned long) cacheStats.requested, (unsigned long) cacheStats.sent,
+			(unsigned long) (cacheStats.skipped + cacheStats.coalesced), (unsigned long) cacheStats.skipped,
+			(unsigned long) cacheStats.coalesced, (unsigned long) cacheStats.deferred);
+	printf("Notifications:            %lu sent, %lu refused (TX buffers full)\n",
+			(unsigned long) statistics->notificationsSent, (unsigned long) statistics->notificationsRefused);
+	printf("Live notifications:       %lu and %lu in %u s after fetching\n", (unsigned long) centrals[0].liveNotifications,
+			(unsigned long) centrals[1].liveNotifications, LIVE_LISTENING_MS / 1000u);
+	printf("HCI events:               %lu delivered, %lu dropped\n", (unsigned long) statistics->eventsDelivered,
+			(unsigned long) statistics->eventsDropped);
+	printf("HCI traffic:              %lu bytes to controller, %lu bytes from controller\n",
+			(unsigned long) statistics->bytesToController, (unsigned long) statistics->bytesFromController);
+	printf("Connection events:        %lu\n", (unsigned long) statistics->connectionEvents);
+	printf("Read permit requests:     %lu\n", (unsigned long) statistics->readPermitRequests);
+	printf("HAL_GetTick() calls:      %lu\n", (unsigned long) host_platform_tick_reads());
+	printf("Simulated time:           %.3f s (%.3f s in delays)\n", hci_sim_time_us() / 1e6,
+			host_platform_delayed_us() / 1e6);
+	printf("Host time:                %.3f s\n", hostElapsed);
+	printf("\n");
+	ble_print_stats();
+
+	return isReadByTypeCorrect && isFetchCorrect && isAbortCorrect ? 0 : 1;
+}
@@ -0,0 +1,216 @@
+/*
+ * ble_app_events_test.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: steelph0enix
+ */
+
+// Indexed event dispatch against the linear scan of ST event tables it replaced. Every possible
+// event code goes through both, with the real processing functions of bluenrg1_events.c, and the
+// callbacks of the registered events are counted. Then both are timed on the events the station
+// gets most. The module is included to get the size of its tables.
+
+#include "ble_app_events.c"
+#include "bluenrg1_events.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <time.h>
+
+#define EVENT_DATA_LENGTH 256
+#define BENCHMARK_EVENTS 20000000
+
+typedef enum EventKind_t {
+	EVENT_KIND_HCI,
+	EVENT_KIND_LE_META,
+	EVENT_KIND_VENDOR
+} EventKind;
+
+typedef struct RegisteredEvent_t {
+	EventKind kind;
+	uint16_t code;
+	unsigned long calls;
+} RegisteredEvent;
+
+// @formatter:off
+static RegisteredEvent registeredEvents[] = {
+	{ EVENT_KIND_HCI, 0x0005 },
+	{ EVENT_KIND_LE_META, 0x0001 },
+	{ EVENT_KIND_VENDOR, 0x0001 },
+	{ EVENT_KIND_VENDOR, 0x0002 },
+	{ EVENT_KIND_VENDOR, 0x0C01 },
+	{ EVENT_KIND_VENDOR, 0x0C03 },
+	{ EVENT_KIND_VENDOR, 0x0C14 },
+	{ EVENT_KIND_VENDOR, 0x0C15 },
+	{ EVENT_KIND_VENDOR, 0x0C16 }
+};
+// @formatter:on
+
+#define REGISTERED_EVENTS (sizeof(registeredEvents) / sizeof(registeredEvents[0]))
+
+static uint8_t eventData[EVENT_DATA_LENGTH] = { 0 };
+static unsigned long failures = 0;
+
+// Callbacks of the registered events replace the weak ones of bluenrg1_events_cb.c, in the order above
+void hci_disconnection_complete_event(uint8_t Status, uint16_t Connection_Handle, uint8_t Reason) {
+	registeredEvents[0].calls++;
+}
+
+void hci_le_connection_complete_event(uint8_t Status, uint16_t Connection_Handle, uint8_t Role,
+		uint8_t Peer_Address_Type, uint8_t Peer_Address[6], uint16_t Conn_Interval, uint16_t Conn_Latency,
+		uint16_t Supervision_Timeout, uint8_t Master_Clock_Accuracy) {
+	registeredEvents[1].calls++;
+}
+
+void aci_blue_initialized_event(uint8_t Reason_Code) {
+	registeredEvents[2].calls++;
+}
+
+void aci_blue_events_lost_event(uint8_t Lost_Events[8]) {
+	registeredEvents[3].calls++;
+}
+
+void aci_gatt_attribute_modified_event(uint16_t Connection_Handle, uint16_t Attr_Handle, uint16_t Offset,
+		uint16_t Attr_Data_Length, uint8_t Attr_Data[]) {
+	registeredEvents[4].calls++;
+}
+
+void aci_att_exchange_mtu_resp_event(uint16_t Connection_Handle, uint16_t Server_RX_MTU) {
+	registeredEvents[5].calls++;
+}
+
+void aci_gatt_read_permit_req_event(uint16_t Connection_Handle, uint16_t Attribute_Handle, uint16_t Offset) {
+	registeredEvents[6].calls++;
+}
+
+void aci_gatt_read_multi_permit_req_event(uint16_t Connection_Handle, uint8_t Number_of_Handles,
+		Handle_Item_t Handle_Item[]) {
+	registeredEvents[7].calls++;
+}
+
+void aci_gatt_tx_pool_available_event(uint16_t Connection_Handle, uint16_t Available_Buffers) {
+	registeredEvents[8].calls++;
+}
+
+// handle_hci_packet() before the indexed dispatch, every matching entry of the whole table is called
+static void scan_table(hci_events_table_type const table[], size_t length, uint16_t code, void* data) {
+	for (size_t i = 0; i < length; i++) {
+		if (code == table[i].evt_code) {
+			table[i].process((uint8_t*) data);
+		}
+	}
+}
+
+static void scan_event(EventKind kind, uint16_t code, void* data) {
+	switch (kind) {
+	case EVENT_KIND_HCI:
+		scan_table(hci_events_table, ARRAY_LENGTH(hci_events_table), code, data);
+		break;
+	case EVENT_KIND_LE_META:
+		scan_table(hci_le_meta_events_table, ARRAY_LENGTH(hci_le_meta_events_table), code, data);
+		break;
+	case EVENT_KIND_VENDOR:
+		scan_table(hci_vendor_specific_events_table, ARRAY_LENGTH(hci_vendor_specific_events_table), code, data);
+		break;
+	}
+}
+
+static void dispatch(EventKind kind, uint16_t code, void* data) {
+	switch (kind) {
+	case EVENT_KIND_HCI:
+		ble_dispatch_hci_event((uint8_t) code, data);
+		break;
+	case EVENT_KIND_LE_META:
+		ble_dispatch_le_meta_event((uint8_t) code, data);
+		break;
+	case EVENT_KIND_VENDOR:
+		ble_dispatch_vendor_event(code, data);
+		break;
+	}
+}
+
+static void clear_calls() {
+	for (size_t i = 0; i < REGISTERED_EVENTS; i++) {
+		registeredEvents[i].calls = 0;
+	}
+}
+
+static unsigned long total_calls() {
+	unsigned long calls = 0;
+	for (size_t i = 0; i < REGISTERED_EVENTS; i++) {
+		calls += registeredEvents[i].calls;
+	}
+	return calls;
+}
+
+// Registered event calls its own callback once, any other event calls none
+static bool are_calls_expected(EventKind kind, uint16_t code) {
+	bool isCorrect = true;
+	for (size_t i = 0; i < REGISTERED_EVENTS; i++) {
+		RegisteredEvent const* event = &registeredEvents[i];
+		unsigned long const expected = event->kind == kind && event->code == code ? 1 : 0;
+		isCorrect = isCorrect && event->calls == expected;
+	}
+	return isCorrect;
+}
+
+static void check_every_code(EventKind kind, char const* name, uint32_t codes) {
+	unsigned long mismatches = 0;
+	for (uint32_t code = 0; code < codes; code++) {
+		clear_calls();
+		dispatch(kind, (uint16_t) code, eventData);
+		bool isCorrect = are_calls_expected(kind, (uint16_t) code);
+
+		// Registered events must reach the same processing function as through the ST table
+		if (isCorrect && total_calls() > 0) {
+			clear_calls();
+			scan_event(kind, (uint16_t) code, eventData);
+			isCorrect = are_calls_expected(kind, (uint16_t) code);
+		}
+
+		if (!isCorrect && mismatches++ < 5) {
+			printf("\tFAILED: %s event 0x%04lX\n", name, (unsigned long) code);
+		}
+	}
+	printf("%s events: %lu codes dispatched, %lu wrong\n", name, (unsigned long) codes, mismatches);
+	failures += mismatches;
+}
+
+static double host_seconds() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Fetching records is mostly read requests and TX pool events, with a few writes
+// @formatter:off
+static uint16_t const benchmarkEvents[] = { 0x0C14, 0x0C16, 0x0C14, 0x0C16, 0x0C14, 0x0C16, 0x0C01, 0x0C14 };
+// @formatter:on
+
+static double benchmark(void (*handle)(EventKind, uint16_t, void*)) {
+	double const start = host_seconds();
+	for (long i = 0; i < BENCHMARK_EVENTS; i++) {
+		handle(EVENT_KIND_VENDOR, benchmarkEvents[i % ARRAY_LENGTH(benchmarkEvents)], eventData);
+	}
+	return (host_seconds() - start) * 1e9 / BENCHMARK_EVENTS;
+}
+
+int main() {
+	check_every_code(EVENT_KIND_HCI, "HCI", UINT8_MAX + 1);
+	check_every_code(EVENT_KIND_LE_META, "LE meta", UINT8_MAX + 1);
+	check_every_code(EVENT_KIND_VENDOR, "Vendor", UINT16_MAX + 1);
+
+	size_t const indexedSize = sizeof(hciEventHandlers) + sizeof(leMetaEventHandlers) + sizeof(vendorEventHandlers)
+			+ sizeof(hciEventIndex) + sizeof(leMetaEventIndex) + sizeof(vendorEventIndex);
+	size_t const scannedSize = sizeof(hci_events_table) + sizeof(hci_le_meta_events_table)
+			+ sizeof(hci_vendor_specific_events_table);
+	printf("Dispatch tables: %lu bytes indexed, %lu bytes of ST tables on host\n", (unsigned long) indexedSize,
+			(unsigned long) scannedSize);
+
+	double const scanned = benchmark(scan_event);
+	double const indexed = benchmark(dispatch);
+	printf("Vendor event: %.1f ns scanned, %.1f ns indexed on host\n", scanned, indexed);
+
+	printf("BLE event dispatch: %lu checks failed\n", failures);
+	return failures == 0 ? 0 : 1;
+}
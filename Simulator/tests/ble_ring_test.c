@@ -0,0 +1,259 @@
+/*
+ * ble_ring_test.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: steelph0enix
+ */
+
+// ble_ring.c with the producer and the consumer on two host threads, standing for the EXTI ISR and
+// the BLE task. Rings are small, so they're full or empty most of the time. A thread yields when
+// the ring it waits on is full or empty, so the test also runs in reasonable time on a single core.
+//	* sequence - numbered items must come out in order, the consumer mixes pop, and peek with drop,
+//	* packets - packets circulate through a pool and an RX queue like in hci_tl.c, the producer
+//	  writes each packet before queueing it and the consumer checks it, so the ordering of the
+//	  packet data, not only of the indexes, is tested. The consumer holds some packets aside and
+//	  gives them back with push_front, like hci_send_req(). There are as many packets as RX queue
+//	  slots, so it gets full, but push_front can't overflow it. No packet may get lost or doubled.
+// Build with -fsanitize=thread to have the data races reported too.
+
+#include "ble_ring.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#define SEQUENCE_ITEMS 4000000u
+#define SEQUENCE_RING_SIZE 4
+#define PACKETS_SENT 2000000u
+#define PACKET_RING_SIZE 8
+#define PACKET_COUNT PACKET_RING_SIZE
+#define PACKETS_HELD_MAX 3
+#define PACKET_LENGTH 64
+#define BENCHMARK_ITEMS 100000000u
+
+typedef struct SequenceTest_t {
+	tBleRing ring;
+	uint8_t slots[SEQUENCE_RING_SIZE];
+	unsigned long outOfOrder;
+} SequenceTest;
+
+typedef struct Packet_t {
+	uint32_t number;
+	uint8_t data[PACKET_LENGTH];
+} Packet;
+
+typedef struct PacketTest_t {
+	tBleRing pool;
+	tBleRing rxQueue;
+	uint8_t poolSlots[PACKET_RING_SIZE];
+	uint8_t rxQueueSlots[PACKET_RING_SIZE];
+	Packet packets[PACKET_COUNT];
+	unsigned long corrupted;
+	unsigned long outOfOrder;
+	unsigned long givenBack;
+	// A ring that holds every packet refused one, counted by the thread that was refused
+	unsigned long refusedByQueue;
+	unsigned long refusedByPool;
+	unsigned long refusedFront;
+} PacketTest;
+
+static void* sequence_producer(void* argument) {
+	SequenceTest* test = argument;
+	for (uint32_t item = 0; item < SEQUENCE_ITEMS;) {
+		if (ble_ring_push(&test->ring, (uint8_t) item)) {
+			item++;
+		} else {
+			sched_yield();
+		}
+	}
+	return NULL;
+}
+
+static void* sequence_consumer(void* argument) {
+	SequenceTest* test = argument;
+	uint32_t expected = 0;
+	while (expected < SEQUENCE_ITEMS) {
+		uint8_t item;
+		bool isRead = false;
+		if (expected % 2 == 0) {
+			isRead = ble_ring_pop(&test->ring, &item);
+		} else if (ble_ring_peek(&test->ring, &item)) {
+			ble_ring_drop(&test->ring);
+			isRead = true;
+		}
+
+		if (!isRead) {
+			sched_yield();
+			continue;
+		}
+		if (item != (uint8_t) expected) {
+			test->outOfOrder++;
+		}
+		expected++;
+	}
+	return NULL;
+}
+
+// EXTI ISR in hci_tl.c: takes a free packet, reads the event into it and queues it
+static void* packet_producer(void* argument) {
+	PacketTest* test = argument;
+	for (uint32_t number = 0; number < PACKETS_SENT;) {
+		uint8_t index;
+		if (!ble_ring_pop(&test->pool, &index)) {
+			sched_yield();
+			continue;
+		}
+		Packet* packet = &test->packets[index];
+		packet->number = number;
+		memset(packet->data, (uint8_t) number, sizeof(packet->data));
+		while (!ble_ring_push(&test->rxQueue, index)) {
+			test->refusedByQueue++;
+			sched_yield();
+		}
+		number++;
+	}
+	return NULL;
+}
+
+// hci_send_req(): takes a few queued packets that it's not waiting for and gives them back, in front
+// of whatever the producer has queued in the meantime. Producer gets the time to fill the RX queue
+// with the rest of packets, so the last one given back makes it full.
+static void hold_packets_aside(PacketTest* test, uint32_t count) {
+	while (ble_ring_get_size(&test->rxQueue) < count) {
+		sched_yield();
+	}
+	uint8_t held[PACKETS_HELD_MAX];
+	uint32_t heldCount = 0;
+	while (heldCount < count && ble_ring_pop(&test->rxQueue, &held[heldCount])) {
+		heldCount++;
+	}
+	sched_yield();
+	while (heldCount > 0) {
+		heldCount--;
+		if (ble_ring_push_front(&test->rxQueue, held[heldCount])) {
+			test->givenBack++;
+		} else {
+			test->refusedFront++;
+		}
+	}
+}
+
+// hci_user_evt_proc(): takes a queued packet, processes it and returns it to the pool
+static void* packet_consumer(void* argument) {
+	PacketTest* test = argument;
+	for (uint32_t expected = 0; expected < PACKETS_SENT;) {
+		uint32_t const held = expected / 4 % PACKETS_HELD_MAX + 1;
+		if (expected % 4 == 0 && PACKETS_SENT - expected >= held) {
+			hold_packets_aside(test, held);
+		}
+
+		uint8_t index;
+		if (!ble_ring_pop(&test->rxQueue, &index)) {
+			sched_yield();
+			continue;
+		}
+		Packet const* packet = &test->packets[index];
+		if (packet->number != expected) {
+			test->outOfOrder++;
+		}
+		for (size_t i = 0; i < sizeof(packet->data); i++) {
+			if (packet->data[i] != (uint8_t) packet->number) {
+				test->corrupted++;
+				break;
+			}
+		}
+		while (!ble_ring_push(&test->pool, index)) {
+			test->refusedByPool++;
+			sched_yield();
+		}
+		expected++;
+	}
+	return NULL;
+}
+
+static void run_threads(void* (*producer)(void*), void* (*consumer)(void*), void* test) {
+	pthread_t producerThread;
+	pthread_t consumerThread;
+	pthread_create(&producerThread, NULL, producer, test);
+	pthread_create(&consumerThread, NULL, consumer, test);
+	pthread_join(producerThread, NULL);
+	pthread_join(consumerThread, NULL);
+}
+
+static bool test_sequence() {
+	static SequenceTest test = { 0 };
+	ble_ring_init(&test.ring, test.slots, SEQUENCE_RING_SIZE);
+	run_threads(sequence_producer, sequence_consumer, &test);
+
+	bool const isCorrect = test.outOfOrder == 0 && ble_ring_is_empty(&test.ring);
+	printf("Sequence: %u items, %lu out of order%s\n", SEQUENCE_ITEMS, test.outOfOrder, isCorrect ? "" : " - FAILED");
+	return isCorrect;
+}
+
+static bool test_packets() {
+	static PacketTest test = { 0 };
+	ble_ring_init(&test.pool, test.poolSlots, PACKET_RING_SIZE);
+	ble_ring_init(&test.rxQueue, test.rxQueueSlots, PACKET_RING_SIZE);
+	for (uint8_t index = 0; index < PACKET_COUNT; index++) {
+		ble_ring_push(&test.pool, index);
+	}
+	run_threads(packet_producer, packet_consumer, &test);
+
+	// Every packet is back in the pool, once
+	bool seen[PACKET_COUNT] = { false };
+	unsigned long misplaced = ble_ring_is_empty(&test.rxQueue) ? 0 : 1;
+	uint8_t index;
+	while (ble_ring_pop(&test.pool, &index)) {
+		if (index >= PACKET_COUNT || seen[index]) {
+			misplaced++;
+		} else {
+			seen[index] = true;
+		}
+	}
+	for (uint8_t i = 0; i < PACKET_COUNT; i++) {
+		misplaced += seen[i] ? 0 : 1;
+	}
+
+	unsigned long const refused = test.refusedByQueue + test.refusedByPool + test.refusedFront;
+	bool const isCorrect = test.outOfOrder == 0 && test.corrupted == 0 && refused == 0 && misplaced == 0;
+	printf("Packets: %u sent through %d packets, %lu given back, %lu out of order, %lu corrupted, %lu refused, "
+			"%lu lost or doubled%s\n", PACKETS_SENT, PACKET_COUNT, test.givenBack, test.outOfOrder, test.corrupted,
+			refused, misplaced, isCorrect ? "" : " - FAILED");
+	return isCorrect;
+}
+
+static double host_seconds() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// One thread, the cost of the operations without contention
+static void benchmark() {
+	static uint8_t slots[PACKET_RING_SIZE];
+	tBleRing ring;
+	ble_ring_init(&ring, slots, PACKET_RING_SIZE);
+
+	volatile uint8_t sink = 0;
+	double const start = host_seconds();
+	for (uint32_t i = 0; i < BENCHMARK_ITEMS; i++) {
+		uint8_t item;
+		ble_ring_push(&ring, (uint8_t) i);
+		ble_ring_pop(&ring, &item);
+		sink += item;
+	}
+	double const elapsed = host_seconds() - start;
+	printf("Push and pop: %.1f ns on host\n", elapsed * 1e9 / BENCHMARK_ITEMS);
+}
+
+int main() {
+	bool isCorrect = test_sequence();
+	isCorrect = test_packets() && isCorrect;
+	benchmark();
+
+	printf("BLE ring: %s\n", isCorrect ? "no errors" : "FAILED");
+	return isCorrect ? 0 : 1;
+}
@@ -0,0 +1,187 @@
+/*
+ * derived_metrics_test.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: steelph0enix
+ */
+
+#include "derived_metrics.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <math.h>
+#include <time.h>
+
+// Fixed-point derived metrics against the same formulas in doubles with libm, over -40 to 60 *C
+// (heat index up to 125 *C), 0 to 100 %, 900 to 1080 hPa and -400 to 4000 m. Results are rounded
+// to 0.01, so 0.5 of it is the rounding alone, the rest is the error of the tables.
+
+#define DEW_POINT_TOLERANCE 0.6
+#define ABSOLUTE_HUMIDITY_TOLERANCE 0.6
+// Inputs of the regression aren't quantized, its terms are cut to 1e-10 *F on the way
+#define HEAT_INDEX_TOLERANCE (0.5 + 1e-4)
+#define SEA_LEVEL_PRESSURE_TOLERANCE 0.6
+
+#define BENCHMARK_CALLS 1000000
+
+typedef struct MetricError_t {
+	char const* name;
+	double tolerance;
+	double maxError;
+	long temperature;
+	long humidityOrPressure;
+	long altitude;
+	unsigned long checked;
+} MetricError;
+
+static void check(MetricError* error, int32_t value, double reference, long temperature, long humidityOrPressure,
+		long altitude) {
+	double const difference = fabs(value - reference * 100);
+	error->checked++;
+	if (difference > error->maxError) {
+		error->maxError = difference;
+		error->temperature = temperature;
+		error->humidityOrPressure = humidityOrPressure;
+		error->altitude = altitude;
+	}
+}
+
+static bool report(MetricError const* error) {
+	bool const passed = error->maxError <= error->tolerance;
+	printf("%s: %lu values, max error %.4f (at %ld, %ld, %ld), tolerance %.4f%s\n", error->name, error->checked,
+			error->maxError, error->temperature, error->humidityOrPressure, error->altitude, error->tolerance,
+			passed ? "" : " - FAILED");
+	return passed;
+}
+
+static double clamped_humidity(double humidity) {
+	return humidity < 0.01 ? 0.01 : humidity;
+}
+
+static double reference_dew_point(double temperature, double humidity) {
+	double const gamma = log(clamped_humidity(humidity) / 100) + 17.62 * temperature / (243.12 + temperature);
+	return 243.12 * gamma / (17.62 - gamma);
+}
+
+static double reference_absolute_humidity(double temperature, double humidity) {
+	double const saturation = 6.112 * exp(17.62 * temperature / (243.12 + temperature));
+	return 216.68 * clamped_humidity(humidity) / 100 * saturation / (temperature + 273.15);
+}
+
+// NWS heat index, https://www.wpc.ncep.noaa.gov/html/heatindex_equation.shtml
+static double reference_heat_index(double temperature, double humidity) {
+	double const t = temperature * 9 / 5 + 32;
+	double const rh = clamped_humidity(humidity);
+	double const simple = 0.5 * (t + 61 + (t - 68) * 1.2 + rh * 0.094);
+	double index = simple;
+	if ((simple + t) / 2 >= 80) {
+		index = -42.379 + 2.04901523 * t + 10.14333127 * rh - 0.22475541 * t * rh - 6.83783e-3 * t * t
+				- 5.481717e-2 * rh * rh + 1.22874e-3 * t * t * rh + 8.5282e-4 * t * rh * rh - 1.99e-6 * t * t * rh * rh;
+		if (rh < 13 && t >= 80 && t <= 112) {
+			index -= (13 - rh) / 4 * sqrt((17 - fabs(t - 95)) / 17);
+		} else if (rh > 85 && t >= 80 && t <= 87) {
+			index += (rh - 85) / 10 * (87 - t) / 5;
+		}
+	}
+	return (index - 32) * 5 / 9;
+}
+
+static double reference_sea_level_pressure(double pressure, double temperature, double altitude) {
+	return pressure * exp(altitude / (29.27 * (temperature + 273.15 + 0.00325 * altitude)));
+}
+
+static bool check_humidity_metrics() {
+	MetricError dewPoint = { .name = "Dew point [0.01 *C]", .tolerance = DEW_POINT_TOLERANCE };
+	MetricError absoluteHumidity = { .name = "Absolute humidity [0.01 g/m3]", .tolerance =
+			ABSOLUTE_HUMIDITY_TOLERANCE };
+	for (long temperature = -4000; temperature <= 6000; temperature += 7) {
+		for (long humidity = 0; humidity <= 10000; humidity += 13) {
+			check(&dewPoint, dew_point_centi_celsius(temperature, humidity),
+					reference_dew_point(temperature / 100.0, humidity / 100.0), temperature, humidity, 0);
+			check(&absoluteHumidity, absolute_humidity_centi_gpm3(temperature, humidity),
+					reference_absolute_humidity(temperature / 100.0, humidity / 100.0), temperature, humidity, 0);
+		}
+	}
+	bool const isDewPointCorrect = report(&dewPoint);
+	return report(&absoluteHumidity) && isDewPointCorrect;
+}
+
+// Every temperature, so the switch from the simple formula at 80 *F and the edges of the
+// adjustments are all crossed, with a humidity step that changes with the temperature
+static bool check_heat_index() {
+	MetricError heatIndex = { .name = "Heat index [0.01 *C]", .tolerance = HEAT_INDEX_TOLERANCE };
+	for (long temperature = -4000; temperature <= 12500; temperature++) {
+		for (long humidity = 0; humidity <= 10000; humidity += (temperature + 7000) % 7 + 1) {
+			check(&heatIndex, heat_index_centi_celsius(temperature, humidity),
+					reference_heat_index(temperature / 100.0, humidity / 100.0), temperature, humidity, 0);
+		}
+	}
+	return report(&heatIndex);
+}
+
+static bool check_sea_level_pressure() {
+	MetricError seaLevelPressure = { .name = "Sea-level pressure [0.01 hPa]", .tolerance =
+			SEA_LEVEL_PRESSURE_TOLERANCE };
+	for (long pressure = 90000; pressure <= 108000; pressure += 97) {
+		for (long temperature = -4000; temperature <= 6000; temperature += 53) {
+			for (long altitude = -400; altitude <= 4000; altitude += 37) {
+				check(&seaLevelPressure, sea_level_pressure_centi_hpa(pressure, temperature, altitude),
+						reference_sea_level_pressure(pressure, temperature / 100.0, altitude) / 100, temperature,
+						pressure, altitude);
+			}
+		}
+	}
+	return report(&seaLevelPressure);
+}
+
+// Every metric needs the temperature, sea-level pressure the pressure and the rest the humidity
+static bool check_unknown_inputs() {
+	unsigned long wrong = 0;
+	for (uint8_t missing = 0; missing < 8; missing++) {
+		bool const isTemperatureMissing = missing & 1u;
+		bool const isPressureMissing = missing & 2u;
+		bool const isHumidityMissing = missing & 4u;
+		DerivedMetrics metrics;
+		derive_metrics(isTemperatureMissing ? DERIVED_METRIC_UNKNOWN : 2000,
+				isPressureMissing ? DERIVED_METRIC_UNKNOWN : 100000, isHumidityMissing ? DERIVED_METRIC_UNKNOWN : 5000,
+				300, &metrics);
+
+		bool const isHumidityMetricUnknown = isTemperatureMissing || isHumidityMissing;
+		bool const isPressureMetricUnknown = isTemperatureMissing || isPressureMissing;
+		wrong += ((metrics.dewPoint == DERIVED_METRIC_UNKNOWN) != isHumidityMetricUnknown)
+				+ ((metrics.absoluteHumidity == DERIVED_METRIC_UNKNOWN) != isHumidityMetricUnknown)
+				+ ((metrics.heatIndex == DERIVED_METRIC_UNKNOWN) != isHumidityMetricUnknown)
+				+ ((metrics.seaLevelPressure == DERIVED_METRIC_UNKNOWN) != isPressureMetricUnknown);
+	}
+	printf("Unknown inputs: 8 combinations, %lu metrics wrong%s\n", wrong, wrong == 0 ? "" : " - FAILED");
+	return wrong == 0;
+}
+
+static double host_seconds() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void benchmark() {
+	DerivedMetrics metrics;
+	volatile int32_t sink = 0;
+	double const start = host_seconds();
+	for (int i = 0; i < BENCHMARK_CALLS; i++) {
+		derive_metrics(1500 + i % 3000, 100000 + i % 500, 3000 + i % 5000, 300, &metrics);
+		sink += metrics.dewPoint + metrics.absoluteHumidity + metrics.heatIndex + metrics.seaLevelPressure;
+	}
+	double const elapsed = host_seconds() - start;
+	printf("derive_metrics: %.1f ns/call on host\n", elapsed * 1e9 / BENCHMARK_CALLS);
+}
+
+int main() {
+	bool isCorrect = check_humidity_metrics();
+	isCorrect = check_heat_index() && isCorrect;
+	isCorrect = check_sea_level_pressure() && isCorrect;
+	isCorrect = check_unknown_inputs() && isCorrect;
+	benchmark();
+
+	printf("Derived metrics: %s\n", isCorrect ? "all within tolerance" : "FAILED");
+	return isCorrect ? 0 : 1;
+}
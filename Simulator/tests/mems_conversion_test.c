@@ -0,0 +1,106 @@
+/*
+ * mems_conversion_test.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: steelph0enix
+ */
+
+#include "mems_conversion.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <math.h>
+
+// Checks every raw value of the sensors against the exact conversion done in doubles and rounded
+// half away from zero, like the firmware rounds. HTS221 is checked with a few calibrations,
+// including ones with a negative slope and the widest ADC span.
+
+typedef struct TestResult_t {
+	unsigned long checked;
+	unsigned long failed;
+} TestResult;
+
+static long round_half_away(double value) {
+	return value >= 0 ? (long) floor(value + 0.5) : (long) ceil(value - 0.5);
+}
+
+// Exact reference can land on a half only through double rounding, those values are skipped
+static bool is_tie(double value) {
+	return fabs(fabs(value - trunc(value)) - 0.5) < 1e-9;
+}
+
+static void check(TestResult* result, char const* name, long raw, int32_t value, double reference) {
+	result->checked++;
+	if (value != round_half_away(reference) && !is_tie(reference)) {
+		if (result->failed++ < 5) {
+			printf("\t%s(%ld) = %ld, expected %.4f\n", name, raw, (long) value, reference);
+		}
+	}
+}
+
+static void check_stts751(TestResult* result) {
+	for (long raw = INT16_MIN; raw <= INT16_MAX; raw++) {
+		check(result, "stts751_raw_to_centi_celsius", raw, stts751_raw_to_centi_celsius((int16_t) raw), raw * 100.0 / 256);
+	}
+}
+
+// Whole 24-bit range of PRESS_OUT
+static void check_lps22hb(TestResult* result) {
+	for (long raw = -(1l << 23); raw < (1l << 23); raw++) {
+		check(result, "lps22hb_raw_to_centi_hpa", raw, lps22hb_raw_to_centi_hpa((int32_t) raw), raw * 100.0 / 4096);
+	}
+	for (uint32_t samples = 1; samples <= 32; samples++) {
+		for (long raw = 4096000 - 5000; raw <= 4096000 + 5000; raw += 7) {
+			int64_t const sum = (int64_t) raw * samples + samples / 2;
+			check(result, "lps22hb_raw_sum_to_centi_hpa", raw, lps22hb_raw_sum_to_centi_hpa(sum, samples),
+					(double) sum * 100 / 4096 / samples);
+			check(result, "lps22hb_raw_sum_to_centi_celsius", raw, lps22hb_raw_sum_to_centi_celsius(sum / 2000, samples),
+					(double) (sum / 2000) / samples);
+		}
+	}
+}
+
+// @formatter:off
+static HTS221Calibration const calibrations[] = {
+	{ .h0RhX2 = 66, .h1RhX2 = 150, .h0T0Out = -2, .h1T0Out = -8000, .t0DegCX8 = 8 * 15 + 3, .t1DegCX8 = 8 * 40 + 5, .t0Out = -3, .t1Out = 700 },
+	{ .h0RhX2 = 40, .h1RhX2 = 160, .h0T0Out = 1234, .h1T0Out = -6789, .t0DegCX8 = 160, .t1DegCX8 = 330, .t0Out = 300, .t1Out = -400 },
+	{ .h0RhX2 = 0, .h1RhX2 = 200, .h0T0Out = -32768, .h1T0Out = 32767, .t0DegCX8 = 0x1A5, .t1DegCX8 = 0x3E1, .t0Out = 12000, .t1Out = -9000 },
+	{ .h0RhX2 = 90, .h1RhX2 = 90, .h0T0Out = 5, .h1T0Out = 100, .t0DegCX8 = 0, .t1DegCX8 = 0x3FF, .t0Out = -32768, .t1Out = 32767 }
+};
+// @formatter:on
+
+static void check_hts221(TestResult* result) {
+	for (size_t i = 0; i < sizeof(calibrations) / sizeof(calibrations[0]); i++) {
+		HTS221Calibration const* calibration = &calibrations[i];
+		for (long raw = INT16_MIN; raw <= INT16_MAX; raw++) {
+			double const humidity = (calibration->h0RhX2 / 2.0
+					+ (calibration->h1RhX2 - calibration->h0RhX2) / 2.0 * (raw - calibration->h0T0Out)
+							/ (calibration->h1T0Out - calibration->h0T0Out)) * 100;
+			double const clamped = humidity < 0 ? 0 : (humidity > 10000 ? 10000 : humidity);
+			check(result, "hts221_raw_to_centi_percent", raw, hts221_raw_to_centi_percent(calibration, (int16_t) raw),
+					clamped);
+
+			double const t0 = calibration->t0DegCX8 / 8.0;
+			double const t1 = calibration->t1DegCX8 / 8.0;
+			double const temperature = (t0
+					+ (t1 - t0) * (raw - calibration->t0Out) / (calibration->t1Out - calibration->t0Out)) * 100;
+			check(result, "hts221_raw_to_centi_celsius", raw, hts221_raw_to_centi_celsius(calibration, (int16_t) raw),
+					temperature);
+		}
+	}
+
+	HTS221Calibration const invalid = { .h0T0Out = 10, .h1T0Out = 10, .t0Out = -5, .t1Out = -5 };
+	check(result, "hts221_raw_to_centi_percent", 1000, hts221_raw_to_centi_percent(&invalid, 1000), 0);
+	check(result, "hts221_raw_to_centi_celsius", 1000, hts221_raw_to_centi_celsius(&invalid, 1000), 0);
+}
+
+int main() {
+	TestResult result = { 0 };
+	check_stts751(&result);
+	check_lps22hb(&result);
+	check_hts221(&result);
+
+	printf("MEMS conversions: %lu values checked, %lu differ from the exact conversion\n", result.checked,
+			result.failed);
+	return result.failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,160 @@
+/*
+ * mems_filters_test.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: steelph0enix
+ */
+
+#include "mems_filters.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+// Golden traces of every filter type and of chained stages, configuration codec checks,
+// exponential filter against a floating-point reference and the cost of the slowest chain.
+
+#define TRACE_LENGTH 10
+#define BENCHMARK_SAMPLES 10000000
+
+typedef struct FilterTrace_t {
+	char const* name;
+	MemsFilterConfig config;
+	uint8_t length;
+	int32_t input[TRACE_LENGTH];
+	int32_t output[TRACE_LENGTH];
+} FilterTrace;
+
+// @formatter:off
+static FilterTrace const traces[] = {
+	{ "moving average of 4", { { { MEMS_FILTER_MOVING_AVERAGE, 4 } } }, 6,
+		{ 100, 200, 300, 400, 500, 600 },
+		{ 100, 150, 200, 250, 350, 450 } },
+	{ "moving average rounding", { { { MEMS_FILTER_MOVING_AVERAGE, 2 } } }, 4,
+		{ -101, -100, 1, 2 },
+		{ -101, -101, -50, 2 } },
+	{ "median of 3", { { { MEMS_FILTER_MEDIAN, 3 } } }, 6,
+		{ 10, 1000, 12, 11, -500, 13 },
+		{ 10, 505, 12, 12, 11, 11 } },
+	{ "exponential, k = 1", { { { MEMS_FILTER_EXPONENTIAL, 1 } } }, 5,
+		{ 1000, 2000, 2000, 2000, 0 },
+		{ 1000, 1500, 1750, 1875, 938 } },
+	// 1.0 unit = 100 centi-units, a step lasting for 3 samples is accepted with the 4th
+	{ "spike rejection of 1.0", { { { MEMS_FILTER_SPIKE_REJECTION, 10 } } }, 9,
+		{ 2000, 2050, 2500, 2040, 2600, 2600, 2600, 2600, 2610 },
+		{ 2000, 2050, 2050, 2040, 2040, 2040, 2040, 2600, 2610 } },
+	{ "spike rejection, then median", { { { MEMS_FILTER_SPIKE_REJECTION, 20 }, { MEMS_FILTER_MEDIAN, 3 } } }, 6,
+		{ -1500, -1510, -9000, -1490, -1500, -1480 },
+		{ -1500, -1505, -1510, -1510, -1500, -1490 } },
+	{ "no filters", { { { MEMS_FILTER_NONE, 0 } } }, 3,
+		{ 1, -2, 3 },
+		{ 1, -2, 3 } }
+};
+// @formatter:on
+
+static unsigned long failures = 0;
+
+static void expect(bool condition, char const* description) {
+	if (!condition) {
+		failures++;
+		printf("\tFAILED: %s\n", description);
+	}
+}
+
+static void check_trace(FilterTrace const* trace) {
+	MemsFilterChain chain;
+	mems_filter_chain_init(&chain, &trace->config);
+	for (uint8_t i = 0; i < trace->length; i++) {
+		int32_t const output = mems_filter_chain_apply(&chain, trace->input[i]);
+		if (output != trace->output[i]) {
+			failures++;
+			printf("\tFAILED: %s, sample %u: %ld, expected %ld\n", trace->name, i, (long) output,
+					(long) trace->output[i]);
+		}
+	}
+}
+
+// Integer filter with 8 fractional bits stays within 1 centi-unit of the exact one
+static void check_exponential() {
+	for (uint8_t k = 1; k <= 8; k++) {
+		MemsFilterConfig const config = { { { MEMS_FILTER_EXPONENTIAL, k } } };
+		MemsFilterChain chain;
+		mems_filter_chain_init(&chain, &config);
+
+		double reference = 0;
+		long maxError = 0;
+		for (int i = 0; i < 2000; i++) {
+			int32_t const sample = 101325 + (int32_t) (300 * sin(i / 20.0)) + (i % 7) * 13;
+			int32_t const output = mems_filter_chain_apply(&chain, sample);
+			reference = i == 0 ? sample : reference + (sample - reference) / (1 << k);
+			long const error = labs(output - lround(reference));
+			maxError = error > maxError ? error : maxError;
+		}
+		printf("Exponential k = %u: %ld max error against double\n", k, maxError);
+		expect(maxError <= 1, "exponential filter follows the double reference");
+	}
+}
+
+static void check_config() {
+	uint8_t data[MEMS_FILTER_CONFIG_LENGTH] = { 0 };
+	MemsFilterConfig configs[MEMS_CHANNELS] = { 0 };
+
+	data[0] = MEMS_FILTER_MOVING_AVERAGE;
+	data[1] = MEMS_FILTER_MAX_WINDOW + 1;
+	expect(!mems_filter_config_decode(data, sizeof(data), configs), "window over the maximum is rejected");
+	data[1] = MEMS_FILTER_MAX_WINDOW;
+	expect(mems_filter_config_decode(data, sizeof(data), configs), "maximum window is accepted");
+	expect(!mems_filter_config_decode(data, sizeof(data) - 1, configs), "short configuration is rejected");
+
+	data[2] = 0x07;
+	expect(!mems_filter_config_decode(data, sizeof(data), configs), "unknown filter type is rejected");
+	data[2] = MEMS_FILTER_SPIKE_REJECTION;
+	data[3] = 0;
+	expect(!mems_filter_config_decode(data, sizeof(data), configs), "spike rejection with zero step is rejected");
+	data[3] = 1;
+	expect(mems_filter_config_decode(data, sizeof(data), configs), "spike rejection with 0.1 step is accepted");
+	data[4] = MEMS_FILTER_EXPONENTIAL;
+	expect(!mems_filter_config_decode(data, sizeof(data), configs), "exponential filter with k = 0 is rejected");
+	data[4] = MEMS_FILTER_NONE;
+
+	uint8_t encoded[MEMS_FILTER_CONFIG_LENGTH] = { 0 };
+	mems_filter_config_encode(configs, encoded);
+	expect(encoded[0] == MEMS_FILTER_MOVING_AVERAGE && encoded[1] == MEMS_FILTER_MAX_WINDOW
+			&& encoded[2] == MEMS_FILTER_SPIKE_REJECTION && encoded[3] == 1, "configuration is encoded back");
+}
+
+static double host_seconds() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Every stage with its largest window, the most work a sample can take
+static void benchmark() {
+	MemsFilterConfig const config = { { { MEMS_FILTER_SPIKE_REJECTION, 5 }, { MEMS_FILTER_MEDIAN,
+			MEMS_FILTER_MAX_WINDOW }, { MEMS_FILTER_MOVING_AVERAGE, MEMS_FILTER_MAX_WINDOW } } };
+	MemsFilterChain chain;
+	mems_filter_chain_init(&chain, &config);
+
+	volatile int32_t sink = 0;
+	double const start = host_seconds();
+	for (int i = 0; i < BENCHMARK_SAMPLES; i++) {
+		sink += mems_filter_chain_apply(&chain, 101325 + (int32_t) ((uint32_t) i * 7919u % 400u));
+	}
+	double const elapsed = host_seconds() - start;
+	printf("Slowest chain: %.1f ns/sample on host\n", elapsed * 1e9 / BENCHMARK_SAMPLES);
+}
+
+int main() {
+	for (size_t i = 0; i < sizeof(traces) / sizeof(traces[0]); i++) {
+		check_trace(&traces[i]);
+	}
+	check_exponential();
+	check_config();
+	benchmark();
+
+	printf("MEMS filters: %lu traces, %lu checks failed\n", (unsigned long) (sizeof(traces) / sizeof(traces[0])),
+			failures);
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,329 @@
+/*
+ * mems_sensors_test.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: steelph0enix
+ */
+
+// mems_sensors.c and the ST drivers run against a fake I2C bus with a register file per sensor.
+// Every transaction is logged, so the test checks how many of them reading the sensors takes,
+// not only the values. DWT is replaced before the module is included, there's no cycle counter on host.
+
+#include "main.h"
+#include "cmsis_os.h"
+
+#undef DWT
+static DWT_Type fakeDwt;
+#define DWT (&fakeDwt)
+
+#include "mems_sensors.c"
+
+#include <stdio.h>
+
+#define HTS221_ADDRESS 0xBE
+#define LPS22HB_ADDRESS 0xBA
+#define STTS751_ADDRESS 0x94
+#define HTS221_AUTO_INCREMENT 0x80u
+#define LPS22HB_IF_ADD_INC 0x10u
+#define LPS22HB_FIFO_EN 0x40u
+#define FAKE_REGISTERS 128
+#define FAKE_FIFO_DEPTH 32
+#define FAKE_LOG_LENGTH 256
+
+typedef struct FakeDevice_t {
+	char const* name;
+	uint16_t address;
+	uint8_t registers[FAKE_REGISTERS];
+} FakeDevice;
+
+typedef struct FakeTransaction_t {
+	uint16_t address;
+	uint8_t reg; // without the auto-increment bit
+	uint16_t length;
+	bool isRead;
+} FakeTransaction;
+
+typedef struct FakeSample_t {
+	int32_t pressure;
+	int16_t temperature;
+} FakeSample;
+
+uint32_t SystemCoreClock = 170000000u;
+
+static uint32_t tick = 0;
+static FakeDevice devices[] = { { "HTS221", HTS221_ADDRESS }, { "LPS22HB", LPS22HB_ADDRESS }, { "STTS751",
+		STTS751_ADDRESS } };
+static FakeSample fifo[FAKE_FIFO_DEPTH];
+static uint8_t fifoLevel = 0;
+static FakeTransaction transactions[FAKE_LOG_LENGTH];
+static uint32_t transactionCount = 0;
+static uint32_t failures = 0;
+
+uint32_t HAL_GetTick(void) {
+	return tick;
+}
+
+osStatus_t osDelay(uint32_t ticks) {
+	tick += ticks;
+	return osOK;
+}
+
+int32_t BSP_I2C1_Init(void) {
+	return BSP_ERROR_NONE;
+}
+
+int32_t BSP_I2C1_DeInit(void) {
+	return BSP_ERROR_NONE;
+}
+
+static FakeDevice* find_device(uint16_t address) {
+	for (size_t i = 0; i < sizeof(devices) / sizeof(devices[0]); i++) {
+		if (devices[i].address == address) {
+			return &devices[i];
+		}
+	}
+	return NULL;
+}
+
+static void log_transaction(uint16_t address, uint8_t reg, uint16_t length, bool is_read) {
+	if (transactionCount < FAKE_LOG_LENGTH) {
+		transactions[transactionCount] = (FakeTransaction ) { address, reg, length, is_read };
+	}
+	transactionCount++;
+}
+
+static uint8_t fifo_byte(uint16_t index) {
+	FakeSample const* sample = &fifo[index / LPS22HB_FIFO_SAMPLE_SIZE];
+	uint8_t const bytes[LPS22HB_FIFO_SAMPLE_SIZE] = { sample->pressure & 0xFF, (sample->pressure >> 8) & 0xFF,
+			(sample->pressure >> 16) & 0xFF, sample->temperature & 0xFF, (sample->temperature >> 8) & 0xFF };
+	return bytes[index % LPS22HB_FIFO_SAMPLE_SIZE];
+}
+
+// In FIFO mode the output registers roll back from TEMP_OUT_H to PRESS_OUT_XL and every pass pops a sample
+static void read_lps_fifo(uint8_t* data, uint16_t length) {
+	uint8_t const popped = length / LPS22HB_FIFO_SAMPLE_SIZE < fifoLevel ? length / LPS22HB_FIFO_SAMPLE_SIZE : fifoLevel;
+	for (uint16_t i = 0; i < length; i++) {
+		data[i] = i / LPS22HB_FIFO_SAMPLE_SIZE < popped ? fifo_byte(i) : 0;
+	}
+	for (uint8_t i = popped; i < fifoLevel; i++) {
+		fifo[i - popped] = fifo[i];
+	}
+	fifoLevel -= popped;
+}
+
+static bool is_auto_increment(FakeDevice const* device, uint16_t reg) {
+	switch (device->address) {
+	case HTS221_ADDRESS:
+		return (reg & HTS221_AUTO_INCREMENT) != 0;
+	case LPS22HB_ADDRESS:
+		return (device->registers[LPS22HB_CTRL_REG2] & LPS22HB_IF_ADD_INC) != 0;
+	default:
+		return false;
+	}
+}
+
+int32_t i2c_bus_read_reg(uint16_t address, uint16_t reg, uint8_t* data, uint16_t length) {
+	FakeDevice* device = find_device(address);
+	if (device == NULL) {
+		return BSP_ERROR_BUS_ACKNOWLEDGE_FAILURE;
+	}
+	bool const autoIncrement = is_auto_increment(device, reg);
+	uint8_t const start = reg & (FAKE_REGISTERS - 1);
+	log_transaction(address, start, length, true);
+
+	if (address == LPS22HB_ADDRESS) {
+		device->registers[LPS22HB_FIFO_STATUS] = fifoLevel;
+		if ((device->registers[LPS22HB_CTRL_REG2] & LPS22HB_FIFO_EN) && start == LPS22HB_PRESS_OUT_XL && autoIncrement) {
+			read_lps_fifo(data, length);
+			return BSP_ERROR_NONE;
+		}
+	}
+	for (uint16_t i = 0; i < length; i++) {
+		data[i] = device->registers[(autoIncrement ? start + i : start) & (FAKE_REGISTERS - 1)];
+	}
+	return BSP_ERROR_NONE;
+}
+
+int32_t i2c_bus_write_reg(uint16_t address, uint16_t reg, uint8_t* data, uint16_t length) {
+	FakeDevice* device = find_device(address);
+	if (device == NULL) {
+		return BSP_ERROR_BUS_ACKNOWLEDGE_FAILURE;
+	}
+	bool const autoIncrement = is_auto_increment(device, reg);
+	uint8_t const start = reg & (FAKE_REGISTERS - 1);
+	log_transaction(address, start, length, false);
+
+	for (uint16_t i = 0; i < length; i++) {
+		device->registers[(autoIncrement ? start + i : start) & (FAKE_REGISTERS - 1)] = data[i];
+	}
+	return BSP_ERROR_NONE;
+}
+
+static void write_word(FakeDevice* device, uint8_t reg, int16_t value) {
+	device->registers[reg] = value & 0xFF;
+	device->registers[reg + 1] = (value >> 8) & 0xFF;
+}
+
+// 22.5 *C on every sensor, 1013.25 hPa and 50 % with the calibration below
+static void set_up_sensors() {
+	FakeDevice* hts = find_device(HTS221_ADDRESS);
+	hts->registers[HTS221_H0_RH_X2] = 40;
+	hts->registers[HTS221_H1_RH_X2] = 160;
+	hts->registers[HTS221_T0_DEGC_X8] = 80;
+	hts->registers[HTS221_T1_DEGC_X8] = 240;
+	write_word(hts, HTS221_H0_T0_OUT_L, 0);
+	write_word(hts, HTS221_H1_T0_OUT_L, 6000);
+	write_word(hts, HTS221_T0_OUT_L, 0);
+	write_word(hts, HTS221_T1_OUT_L, 2000);
+	write_word(hts, HTS221_HUMIDITY_OUT_L, 3000);
+	write_word(hts, HTS221_TEMP_OUT_L, 1250);
+	hts->registers[HTS221_STATUS_REG] = 0x03; // T_DA, H_DA
+
+	FakeDevice* lps = find_device(LPS22HB_ADDRESS);
+	lps->registers[LPS22HB_CTRL_REG2] = LPS22HB_IF_ADD_INC; // reset value
+	lps->registers[LPS22HB_STATUS] = 0x03; // P_DA, T_DA
+	int32_t const pressure = 101325 * 4096 / 100;
+	lps->registers[LPS22HB_PRESS_OUT_XL] = pressure & 0xFF;
+	lps->registers[LPS22HB_PRESS_OUT_XL + 1] = (pressure >> 8) & 0xFF;
+	lps->registers[LPS22HB_PRESS_OUT_XL + 2] = (pressure >> 16) & 0xFF;
+	write_word(lps, LPS22HB_TEMP_OUT_L, 2250);
+
+	FakeDevice* stts = find_device(STTS751_ADDRESS);
+	stts->registers[STTS751_TEMPERATURE_HIGH] = 0x16;
+	stts->registers[STTS751_TEMPERATURE_LOW] = 0x80;
+	stts->registers[STTS751_STATUS] = 0x00; // not busy
+}
+
+#if LPS22HB_FIFO_OVERSAMPLING
+static void push_fifo_sample(int32_t centi_hpa, int16_t centi_celsius) {
+	if (fifoLevel < FAKE_FIFO_DEPTH) {
+		fifo[fifoLevel++] = (FakeSample ) { (int32_t) ((int64_t) centi_hpa * 4096 / 100), centi_celsius };
+	}
+}
+#endif
+
+static void expect(bool condition, char const* description, long value, long expected) {
+	if (!condition) {
+		failures++;
+		printf("\tFAILED: %s is %ld, expected %ld\n", description, value, expected);
+	}
+}
+
+static void expect_equal(char const* description, long value, long expected) {
+	expect(value == expected, description, value, expected);
+}
+
+// Reads of the status and output registers, the transactions that decide how long polling takes
+static uint32_t count_data_reads(uint32_t first, uint16_t address, uint8_t low_reg, uint8_t high_reg) {
+	uint32_t count = 0;
+	for (uint32_t i = first; i < transactionCount && i < FAKE_LOG_LENGTH; i++) {
+		FakeTransaction const* transaction = &transactions[i];
+		if (transaction->isRead && transaction->address == address && transaction->reg >= low_reg
+				&& transaction->reg <= high_reg) {
+			count++;
+		}
+	}
+	return count;
+}
+
+static void test_init() {
+	uint32_t const first = transactionCount;
+	mems_init();
+
+	// Whole calibration block in a single read
+	expect_equal("HTS221 calibration reads", count_data_reads(first, HTS221_ADDRESS, HTS221_H0_RH_X2, 0x3F), 1);
+	expect_equal("HTS221 calibration valid", isHtsCalibrationValid, 1);
+	expect_equal("LPS22HB auto-increment", (find_device(LPS22HB_ADDRESS)->registers[LPS22HB_CTRL_REG2]
+			& LPS22HB_IF_ADD_INC) != 0, 1);
+}
+
+static void test_measurement() {
+#if LPS22HB_FIFO_OVERSAMPLING
+	for (uint8_t i = 0; i < LPS22HB_FIFO_WATERMARK; i++) {
+		push_fifo_sample(101325 + (i % 2 == 0 ? -8 : 8), 2250);
+	}
+#endif
+	MemsMeasurementStats const before = get_mems_measurement_stats();
+	uint32_t const first = transactionCount;
+	MemsMeasurement measurement = { 0 };
+	mems_measure(&measurement);
+
+	expect_equal("valid channels", measurement.validChannels, (1u << MEMS_CHANNELS) - 1);
+	expect_equal("temperature", measurement.values[MEMS_CHANNEL_TEMPERATURE], 2250);
+	expect_equal("pressure", measurement.values[MEMS_CHANNEL_PRESSURE], 101325);
+	expect_equal("humidity", measurement.values[MEMS_CHANNEL_HUMIDITY], 5000);
+	expect_equal("temperature spread", measurement.temperatureSpread, 0);
+
+	// Sensors are ready at the first poll: STATUS_REG..TEMP_OUT_H of HTS221 in one read,
+	// STTS751 has no auto-increment, so status and both temperature bytes are read one by one
+	expect_equal("HTS221 poll reads", count_data_reads(first, HTS221_ADDRESS, HTS221_STATUS_REG, HTS221_TEMP_OUT_H), 1);
+	expect_equal("STTS751 poll reads",
+			count_data_reads(first, STTS751_ADDRESS, STTS751_TEMPERATURE_HIGH, STTS751_TEMPERATURE_LOW), 3);
+#if LPS22HB_FIFO_OVERSAMPLING
+	// FIFO_STATUS, then all samples in one burst
+	expect_equal("LPS22HB FIFO reads", count_data_reads(first, LPS22HB_ADDRESS, LPS22HB_FIFO_STATUS, LPS22HB_TEMP_OUT_H),
+			2);
+	expect_equal("LPS22HB FIFO level after measurement", fifoLevel, 0);
+#else
+	// STATUS..TEMP_OUT_H in one read
+	expect_equal("LPS22HB poll reads", count_data_reads(first, LPS22HB_ADDRESS, LPS22HB_STATUS, LPS22HB_TEMP_OUT_H), 1);
+#endif
+
+	MemsMeasurementStats const after = get_mems_measurement_stats();
+	expect_equal("counted I2C transactions", after.i2cTransactions - before.i2cTransactions,
+			transactionCount - first);
+	printf("Measurement: %lu I2C transactions (%s)\n", (unsigned long) (transactionCount - first),
+			LPS22HB_FIFO_OVERSAMPLING ? "pressure from FIFO" : "one-shot pressure");
+}
+
+#if LPS22HB_FIFO_OVERSAMPLING
+static int32_t pressure_after(void (*measure)(MemsMeasurement*), uint8_t samples, int32_t centi_hpa) {
+	for (uint8_t i = 0; i < samples; i++) {
+		push_fifo_sample(centi_hpa, 2250);
+	}
+	MemsMeasurement measurement = { 0 };
+	measure(&measurement);
+	return measurement.values[MEMS_CHANNEL_PRESSURE];
+}
+
+// Samples taken for the filters between the stored measurements must not restart the pressure average
+static void test_pressure_average() {
+	uint32_t const decimations = get_mems_fifo_stats().decimations;
+	expect_equal("pressure of the intermediate sample", pressure_after(mems_sample, 8, 101000), 101000);
+	expect_equal("pressure averaged over the whole interval", pressure_after(mems_measure, 8, 101200), 101100);
+	expect_equal("pressure after the average was restarted", pressure_after(mems_measure, 4, 100500), 100500);
+	expect_equal("stored averages", get_mems_fifo_stats().decimations - decimations, 2);
+}
+
+// Right after a restart at 1 Hz ODR there's no sample yet, pressure is left out after a single FIFO_STATUS read
+static void test_empty_fifo() {
+	uint32_t const first = transactionCount;
+	uint32_t const startTick = tick;
+	MemsMeasurement measurement = { 0 };
+	mems_measure(&measurement);
+
+	expect_equal("valid channels with empty FIFO", measurement.validChannels,
+			((1u << MEMS_CHANNELS) - 1) & ~(1u << MEMS_CHANNEL_PRESSURE));
+	expect_equal("LPS22HB FIFO_STATUS reads with empty FIFO",
+			count_data_reads(first, LPS22HB_ADDRESS, LPS22HB_FIFO_STATUS, LPS22HB_FIFO_STATUS), 1);
+	expect_equal("pressure timeouts", channelStats[MEMS_CHANNEL_PRESSURE].timeouts, 0);
+	expect(tick - startTick < MEMS_DRDY_TIMEOUT_MS, "measurement time with empty FIFO [ms]", tick - startTick,
+			MEMS_DRDY_TIMEOUT_MS);
+	printf("Empty FIFO: %lu ms, %lu I2C transactions\n", (unsigned long) (tick - startTick),
+			(unsigned long) (transactionCount - first));
+}
+#endif
+
+int main() {
+	set_up_sensors();
+	test_init();
+	test_measurement();
+#if LPS22HB_FIFO_OVERSAMPLING
+	test_pressure_average();
+	test_empty_fifo();
+#endif
+
+	printf("MEMS sensors on fake bus: %lu transactions logged, %lu checks failed\n", (unsigned long) transactionCount,
+			(unsigned long) failures);
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,146 @@
+/*
+ * pressure_trend_test.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: steelph0enix
+ */
+
+// Running regression sums of pressure_trend.c against the regression summed again from the bucket
+// ring after every sample. The module is included to get to the ring. Samples come at random
+// intervals, some longer than the whole history, and the HAL tick wraps around during the run.
+
+#include "pressure_trend.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define RANDOM_SAMPLES 200000
+#define BENCHMARK_SAMPLES 10000000
+
+static unsigned long failures = 0;
+
+static void expect(bool condition, char const* description) {
+	if (!condition) {
+		failures++;
+		printf("\tFAILED: %s\n", description);
+	}
+}
+
+// Same rules as window_change(), sums built from scratch
+static bool brute_force_change(uint8_t length, int16_t* change) {
+	int64_t n = 0, sumX = 0, sumXX = 0, sumY = 0, sumXY = 0;
+	for (uint8_t age = 0; age < length; age++) {
+		PressureBucket const* bucket = bucket_at_age(age);
+		if (bucket->isValid) {
+			int64_t const x = length - 1 - age;
+			n++;
+			sumX += x;
+			sumXX += x * x;
+			sumY += bucket->pressure;
+			sumXY += x * bucket->pressure;
+		}
+	}
+
+	int64_t const denominator = n * sumXX - sumX * sumX;
+	if (n < MIN_WINDOW_SAMPLES || bucketsClosed < length / 2u || denominator <= 0) {
+		return false;
+	}
+	*change = clamp_16bit(divide_rounded((n * sumXY - sumX * sumY) * length, denominator));
+	return true;
+}
+
+static bool matches(bool isValid, int16_t change, uint8_t length) {
+	int16_t expected = 0;
+	bool const isExpectedValid = brute_force_change(length, &expected);
+	return isValid == isExpectedValid && (!isValid || change == expected);
+}
+
+static void test_random_history() {
+	srand(1);
+	unsigned long mismatches = 0;
+	// Wraps after about 17 minutes
+	uint32_t tick = 0xFFF00000u;
+	int32_t pressure = 101300;
+	pressure_trend_reset();
+
+	for (long i = 0; i < RANDOM_SAMPLES; i++) {
+		bool const isGap = rand() % 20 == 0;
+		tick += isGap ? (uint32_t) (rand() % (4 * 60 * 60 * 1000)) : 15000u * (1 + rand() % 40);
+		pressure += rand() % 21 - 10;
+		pressure_trend_add(pressure, tick);
+
+		PressureTrend const trend = pressure_trend_get(pressure);
+		if (!matches(trend.isValid1h, trend.change1h, BUCKETS_PER_HOUR)
+				|| !matches(trend.isValid3h, trend.change3h, HISTORY_BUCKETS)) {
+			if (mismatches++ < 5) {
+				printf("\tsample %ld: 1 h %d (%d), 3 h %d (%d)\n", i, trend.change1h, trend.isValid1h,
+						trend.change3h, trend.isValid3h);
+			}
+		}
+	}
+	printf("Random history: %ld samples, %lu differ from the brute-force regression\n", (long) RANDOM_SAMPLES,
+			mismatches);
+	expect(mismatches == 0, "running sums follow the brute-force regression");
+}
+
+// 2 hPa per hour down for 4 hours, a sample every 10 minutes
+static void test_falling() {
+	pressure_trend_reset();
+	uint32_t tick = 0;
+	for (int32_t minute = 0; minute <= 240; minute += 10) {
+		pressure_trend_add(101500 - 200 * minute / 60, tick);
+		tick += 10u * 60u * 1000u;
+	}
+
+	PressureTrend const trend = pressure_trend_get(101000);
+	printf("Falling 2 hPa/h: 1 h %d, 3 h %d, forecast %c\n", trend.change1h, trend.change3h, trend.forecast);
+	expect(trend.isValid1h && trend.change1h == -200, "1 hour change of a steady fall");
+	expect(trend.isValid3h && trend.change3h == -600, "3 hour change of a steady fall");
+	expect(trend.tendency == PRESSURE_TENDENCY_FALLING, "tendency of a steady fall");
+	// Z = 127 - 0.12 * 1010 = 5.8, 6th falling letter
+	expect(trend.forecast == 'R', "forecast of a steady fall at 1010 hPa");
+
+	// Nothing for longer than the history, only the new sample is left
+	pressure_trend_add(101000, tick + 4u * 60u * 60u * 1000u);
+	PressureTrend const afterGap = pressure_trend_get(101000);
+	expect(!afterGap.isValid1h && !afterGap.isValid3h, "trend is invalid after a gap longer than the history");
+	expect(afterGap.forecast == PRESSURE_FORECAST_UNKNOWN, "no forecast after a gap longer than the history");
+}
+
+static void test_start() {
+	pressure_trend_reset();
+	pressure_trend_add(101300, 123456);
+	PressureTrend const trend = pressure_trend_get(101300);
+	expect(!trend.isValid1h && !trend.isValid3h, "trend is invalid with a single sample");
+	expect(trend.tendency == PRESSURE_TENDENCY_UNKNOWN, "tendency is unknown with a single sample");
+}
+
+static double host_seconds() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Every sample closes a bucket, the most work pressure_trend_add() does
+static void benchmark() {
+	pressure_trend_reset();
+	uint32_t tick = 0;
+	double const start = host_seconds();
+	for (int i = 0; i < BENCHMARK_SAMPLES; i++) {
+		tick += BUCKET_MS;
+		pressure_trend_add(101300 + (i & 63), tick);
+	}
+	double const elapsed = host_seconds() - start;
+	printf("pressure_trend_add closing a bucket: %.1f ns/sample on host\n", elapsed * 1e9 / BENCHMARK_SAMPLES);
+}
+
+int main() {
+	test_start();
+	test_falling();
+	test_random_history();
+	benchmark();
+
+	printf("Pressure trend: %lu checks failed\n", failures);
+	return failures == 0 ? 0 : 1;
+}